@@ -0,0 +1,291 @@
+#include <benchmark/benchmark.h>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include "matrix_library.hpp"
+#include "batched_gemm.hpp"
+#include "matrix_decompositions.hpp"
+
+using namespace MatrixLibrary;
+
+/*
+ * Throughput benchmarks of the main Matrix operations. Every benchmark reports GFLOP/s and GB/s, the latter counting
+ * each operand read once and the result written once, i.e. the minimum traffic of the operation. Wall-clock time is
+ * used since the work runs on the thread pool rather than on the benchmark thread.
+ *
+ * Run the run_benchmarks target to write the results to bench/results.json in the build directory.
+ */
+
+namespace
+{
+    template <typename TData>
+    Matrix<TData> makeOperand(const size_t rows, const size_t cols)
+    {
+        Matrix<TData> mat(rows, cols);
+        for (size_t i = 0; i < rows; ++i)
+        {
+            for (size_t j = 0; j < cols; ++j)
+            {
+                mat(i, j) = (TData)((i * 7 + j * 3) % 11) - (TData)5;
+            }
+        }
+        return mat;
+    }
+
+    // Adds the rates GFLOP/s and GB/s given the work of one iteration, they are displayed as GFLOP=x/s and GB=y/s
+    void reportThroughput(benchmark::State &state, const double flops, const double bytes)
+    {
+        if (flops > 0.0)
+        {
+            state.counters["GFLOP"] = benchmark::Counter(flops / 1e9, benchmark::Counter::kIsIterationInvariantRate);
+        }
+        state.counters["GB"] = benchmark::Counter(bytes / 1e9, benchmark::Counter::kIsIterationInvariantRate);
+    }
+
+    std::vector<int64_t> threadCounts()
+    {
+        const int64_t hardware = std::max<int64_t>(std::thread::hardware_concurrency(), 1);
+        return hardware > 1 ? std::vector<int64_t> {1, hardware} : std::vector<int64_t> {1};
+    }
+}
+
+/**
+ * Product of an M x K by a K x N matrix, arguments are M, K, N and the number of threads.
+ */
+template <typename TData>
+void BM_Multiply(benchmark::State &state)
+{
+    const size_t M = state.range(0), K = state.range(1), N = state.range(2);
+    setNumThreads(state.range(3));
+    const Matrix<TData> lhs = makeOperand<TData>(M, K);
+    const Matrix<TData> rhs = makeOperand<TData>(K, N);
+    for (auto _ : state)
+    {
+        Matrix<TData> result = lhs * rhs;
+        benchmark::DoNotOptimize(result.data());
+    }
+    reportThroughput(state, 2.0 * M * N * K, (double)(M * K + K * N + M * N) * sizeof(TData));
+}
+
+/**
+ * In-place A * A^T of an M x K matrix into an existing M x M output with gemm, arguments are M, K, transposed (whether
+ * the transpose is read by the kernel, or formed with transpose() and multiplied as before) and the number of threads.
+ */
+template <typename TData>
+void BM_GemmTransposed(benchmark::State &state)
+{
+    const size_t M = state.range(0), K = state.range(1);
+    const bool transposed = state.range(2) != 0;
+    setNumThreads(state.range(3));
+    const Matrix<TData> mat = makeOperand<TData>(M, K);
+    Matrix<TData> result(M, M);
+    for (auto _ : state)
+    {
+        if (transposed)
+        {
+            gemm(TData(1), mat, Transpose::NoTrans, mat, Transpose::Trans, TData(0), result);
+        }
+        else
+        {
+            result = mat * mat.transpose();
+        }
+        benchmark::DoNotOptimize(result.data());
+    }
+    reportThroughput(state, 2.0 * M * M * K, (double)(M * K + M * M) * sizeof(TData));
+}
+
+/**
+ * Sum of two rows x cols matrices, arguments are rows, cols and the number of threads.
+ */
+template <typename TData>
+void BM_Add(benchmark::State &state)
+{
+    const size_t rows = state.range(0), cols = state.range(1);
+    setNumThreads(state.range(2));
+    const Matrix<TData> lhs = makeOperand<TData>(rows, cols);
+    const Matrix<TData> rhs = makeOperand<TData>(rows, cols);
+    Matrix<TData> result(rows, cols);
+    for (auto _ : state)
+    {
+        result = lhs + rhs;
+        benchmark::DoNotOptimize(result.data());
+    }
+    reportThroughput(state, (double)rows * cols, 3.0 * rows * cols * sizeof(TData));
+}
+
+/**
+ * Out-of-place transpose of a rows x cols matrix, arguments are rows, cols and the number of threads.
+ */
+template <typename TData>
+void BM_Transpose(benchmark::State &state)
+{
+    const size_t rows = state.range(0), cols = state.range(1);
+    setNumThreads(state.range(2));
+    const Matrix<TData> mat = makeOperand<TData>(rows, cols);
+    for (auto _ : state)
+    {
+        Matrix<TData> result = mat.transpose();
+        benchmark::DoNotOptimize(result.data());
+    }
+    reportThroughput(state, 0.0, 2.0 * rows * cols * sizeof(TData));
+}
+
+/**
+ * Strided batch of n x n products, arguments are the batch size, n and the number of threads.
+ */
+template <typename TData>
+void BM_MultiplyBatched(benchmark::State &state)
+{
+    const size_t batch = state.range(0), n = state.range(1);
+    setNumThreads(state.range(2));
+    const Matrix<TData> lhs = makeOperand<TData>(batch * n, n);
+    const Matrix<TData> rhs = makeOperand<TData>(batch * n, n);
+    Matrix<TData> result(batch * n, n);
+    for (auto _ : state)
+    {
+        multiplyBatched(batch, n, n, n, lhs.data(), n, n * n, rhs.data(), n, n * n, result.data(), n, n * n);
+        benchmark::DoNotOptimize(result.data());
+    }
+    reportThroughput(state, 2.0 * batch * n * n * n, 3.0 * batch * n * n * sizeof(TData));
+}
+
+/**
+ * LU factorization with partial pivoting of an n x n matrix, arguments are n and the number of threads.
+ */
+template <typename TData>
+void BM_LU(benchmark::State &state)
+{
+    const size_t n = state.range(0);
+    setNumThreads(state.range(1));
+    Matrix<TData> mat = makeOperand<TData>(n, n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        mat(i, i) += (TData)(8 * n);
+    }
+    for (auto _ : state)
+    {
+        LUDecomposition<TData> lu(mat);
+        benchmark::DoNotOptimize(lu.matrixLU().data());
+    }
+    reportThroughput(state, 2.0 / 3.0 * n * n * n, 2.0 * n * n * sizeof(TData));
+}
+
+/**
+ * Cholesky factorization of an n x n symmetric positive definite matrix, arguments are n and the number of threads.
+ */
+template <typename TData>
+void BM_Cholesky(benchmark::State &state)
+{
+    const size_t n = state.range(0);
+    setNumThreads(state.range(1));
+    Matrix<TData> mat = makeOperand<TData>(n, n);
+    mat = mat + mat.transpose();
+    for (size_t i = 0; i < n; ++i)
+    {
+        mat(i, i) += (TData)(16 * n);
+    }
+    for (auto _ : state)
+    {
+        CholeskyDecomposition<TData> cholesky(mat);
+        benchmark::DoNotOptimize(cholesky.matrixL().data());
+    }
+    reportThroughput(state, 1.0 / 3.0 * n * n * n, 2.0 * n * n * sizeof(TData));
+}
+
+// Square, tall (M >> N), wide (N >> M) and tiny shapes
+void multiplyShapes(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({"M", "K", "N", "threads"});
+    for (const int64_t threads : threadCounts())
+    {
+        for (const int64_t n : {128, 512, 1024})
+        {
+            b->Args({n, n, n, threads});
+        }
+        b->Args({8192, 256, 64, threads});
+        b->Args({64, 256, 8192, threads});
+        b->Args({4, 4, 4, threads});
+    }
+}
+
+void gemmTransposedShapes(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({"M", "K", "transposed", "threads"});
+    for (const int64_t threads : threadCounts())
+    {
+        for (const int64_t transposed : {0, 1})
+        {
+            b->Args({512, 512, transposed, threads});
+            b->Args({1024, 256, transposed, threads});
+        }
+    }
+}
+
+void elementwiseShapes(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({"rows", "cols", "threads"});
+    for (const int64_t threads : threadCounts())
+    {
+        b->Args({1024, 1024, threads});
+        b->Args({16384, 64, threads});
+        b->Args({64, 16384, threads});
+        b->Args({4, 4, threads});
+    }
+}
+
+void batchedShapes(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({"batch", "n", "threads"});
+    for (const int64_t threads : threadCounts())
+    {
+        for (const int64_t n : {4, 8, 16, 32})
+        {
+            b->Args({10000, n, threads});
+        }
+    }
+}
+
+void factorizationShapes(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({"n", "threads"});
+    for (const int64_t threads : threadCounts())
+    {
+        for (const int64_t n : {256, 1024})
+        {
+            b->Args({n, threads});
+        }
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_Multiply, float)->Apply(multiplyShapes)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Multiply, double)->Apply(multiplyShapes)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Multiply, int)->Apply(multiplyShapes)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Multiply, short)->Apply(multiplyShapes)->UseRealTime();
+
+BENCHMARK_TEMPLATE(BM_GemmTransposed, float)->Apply(gemmTransposedShapes)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_GemmTransposed, double)->Apply(gemmTransposedShapes)->UseRealTime();
+
+BENCHMARK_TEMPLATE(BM_Add, float)->Apply(elementwiseShapes)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Add, double)->Apply(elementwiseShapes)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Add, int)->Apply(elementwiseShapes)->UseRealTime();
+
+BENCHMARK_TEMPLATE(BM_Transpose, float)->Apply(elementwiseShapes)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Transpose, double)->Apply(elementwiseShapes)->UseRealTime();
+
+BENCHMARK_TEMPLATE(BM_MultiplyBatched, float)->Apply(batchedShapes)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_MultiplyBatched, double)->Apply(batchedShapes)->UseRealTime();
+
+BENCHMARK_TEMPLATE(BM_LU, double)->Apply(factorizationShapes)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Cholesky, double)->Apply(factorizationShapes)->UseRealTime();
+
+int main(int argc, char **argv)
+{
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
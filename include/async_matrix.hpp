@@ -0,0 +1,312 @@
+/**
+ * @file async_matrix.hpp
+ * @author Alex Liu (alex.liuyining@outlook.com)
+ * @brief Handles to Matrix results computed asynchronously on the thread pool, combined into a task graph
+ * @date 2021-12
+ */
+
+#ifndef ASYNC_MATRIX_HPP
+#define ASYNC_MATRIX_HPP
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <chrono>
+#include <utility>
+#include <type_traits>
+#include "instrumentation.hpp"
+#include "thread_pool.hpp"
+#include "matrix_expression.hpp"
+#include "matrix_library.hpp"
+
+namespace MatrixLibrary
+{
+    /**
+     * Shared state of an AsyncMatrix, completed once with either a result or an exception. Continuations registered
+     * before completion run on the completing thread, those registered afterwards run immediately.
+     *
+     * @tparam TData
+     */
+    template <typename TData>
+    class AsyncState
+    {
+    public:
+        void complete(std::shared_ptr<const Matrix<TData>> value, std::exception_ptr exception)
+        {
+            std::vector<std::function<void()>> continuations;
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                m_value = std::move(value);
+                m_exception = exception;
+                m_done = true;
+                continuations.swap(m_continuations);
+            }
+            m_cv.notify_all();
+            for (const std::function<void()> &continuation : continuations)
+            {
+                continuation();
+            }
+        }
+
+        void onComplete(std::function<void()> continuation)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                if (!m_done)
+                {
+                    m_continuations.push_back(std::move(continuation));
+                    return;
+                }
+            }
+            continuation();
+        }
+
+        bool done() const
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            return m_done;
+        }
+
+        // Blocks until complete, running pending pool tasks meanwhile so that waiting from a worker cannot deadlock
+        void wait() const
+        {
+            while (!done())
+            {
+                if (ThreadPool::instance().tryRunPendingTask())
+                {
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(m_mtx);
+                m_cv.wait_for(lock, std::chrono::microseconds(100), [this]() { return m_done; });
+            }
+        }
+
+        // Only valid once complete
+        const std::shared_ptr<const Matrix<TData>> &value() const
+        {
+            return m_value;
+        }
+
+        std::exception_ptr exception() const
+        {
+            return m_exception;
+        }
+
+    private:
+        mutable std::mutex m_mtx;
+        mutable std::condition_variable m_cv;
+        bool m_done = false;
+        std::shared_ptr<const Matrix<TData>> m_value;
+        std::exception_ptr m_exception;
+        std::vector<std::function<void()>> m_continuations;
+    };
+
+    template <typename TData>
+    class AsyncMatrix;
+
+    template <typename TFunc, typename... TInputs>
+    using AsyncResultType = typename std::decay<decltype(std::declval<TFunc &>()(std::declval<const Matrix<TInputs> &>()...))>::type::value_type;
+
+    /**
+     * Schedules func(inputs.get()...) on the thread pool once all inputs are complete and returns a handle to its
+     * result, without blocking. An exception thrown by func, or held by any of the inputs, is held by the result.
+     * The handles captured keep the inputs alive until func has run.
+     *
+     * @param func Callable taking a const Matrix & per input and returning a Matrix or Matrix expression
+     * @param inputs
+     */
+    template <typename TFunc, typename... TInputs>
+    AsyncMatrix<AsyncResultType<TFunc, TInputs...>> asyncCombine(TFunc func, const AsyncMatrix<TInputs> &... inputs)
+    {
+        using TResult = AsyncResultType<TFunc, TInputs...>;
+        auto state = std::make_shared<AsyncState<TResult>>();
+
+        auto run = [state, func, inputs...]()
+        {
+            // Workers for independent nodes to overlap, on top of the threads each node's own operation uses
+            ThreadPool::instance().ensureWorkers(std::max<size_t>(n_threads, 1));
+            ThreadPool::instance().submit([state, func, inputs...]()
+            {
+                std::exception_ptr exception;
+                for (const std::exception_ptr &input_exception : {std::exception_ptr(), inputs.exception()...})
+                {
+                    exception = exception ? exception : input_exception;
+                }
+                std::shared_ptr<const Matrix<TResult>> value;
+                if (!exception)
+                {
+                    try
+                    {
+                        MATRIX_LIBRARY_TRACE_SCOPE("async task");
+                        value = std::make_shared<const Matrix<TResult>>(func(inputs.get()...));
+                    }
+                    catch (...)
+                    {
+                        exception = std::current_exception();
+                    }
+                }
+                state->complete(std::move(value), exception);
+            });
+        };
+
+        if constexpr (sizeof...(TInputs) == 0)
+        {
+            run();
+        }
+        else
+        {
+            auto remaining = std::make_shared<std::atomic<size_t>>(sizeof...(TInputs));
+            std::function<void()> onInputComplete = [remaining, run]()
+            {
+                if (remaining->fetch_sub(1) == 1)
+                {
+                    run();
+                }
+            };
+            (void)std::initializer_list<int> {(inputs.state()->onComplete(onInputComplete), 0)...};
+        }
+        return AsyncMatrix<TResult>(state);
+    }
+
+    /**
+     * Handle to a Matrix which is computed asynchronously. Operators on handles do not block, they add a node to the
+     * task graph which runs on the thread pool once its operands are complete, so independent operations overlap
+     * with each other and with the calling thread. get() blocks until the result is available.
+     *
+     * Handles are cheap to copy, all copies refer to the same result.
+     *
+     * @tparam TData
+     */
+    template <typename TData>
+    class AsyncMatrix
+    {
+    public:
+        using value_type = TData;
+
+        explicit AsyncMatrix(std::shared_ptr<AsyncState<TData>> state): m_state(std::move(state)) {}
+
+        /**
+         * Whether the result is available, get() then returns without blocking.
+         */
+        bool ready() const
+        {
+            return m_state->done();
+        }
+
+        void wait() const
+        {
+            m_state->wait();
+        }
+
+        /**
+         * Blocks until the result is available. The reference is valid as long as a handle to the result exists.
+         *  @throw the exception thrown while computing the result or one of its operands
+         */
+        const Matrix<TData> &get() const
+        {
+            m_state->wait();
+            if (m_state->exception())
+            {
+                std::rethrow_exception(m_state->exception());
+            }
+            return *m_state->value();
+        }
+
+        std::exception_ptr exception() const
+        {
+            m_state->wait();
+            return m_state->exception();
+        }
+
+        const std::shared_ptr<AsyncState<TData>> &state() const
+        {
+            return m_state;
+        }
+
+        /**
+         * Schedules func(get()), which returns a Matrix, after this result.
+         */
+        template <typename TFunc>
+        AsyncMatrix<AsyncResultType<TFunc, TData>> then(TFunc func) const
+        {
+            return asyncCombine(std::move(func), *this);
+        }
+
+        AsyncMatrix operator*(const AsyncMatrix &rhs) const
+        {
+            return asyncCombine([](const Matrix<TData> &a, const Matrix<TData> &b) { return a * b; }, *this, rhs);
+        }
+
+        AsyncMatrix operator+(const AsyncMatrix &rhs) const
+        {
+            return asyncCombine([](const Matrix<TData> &a, const Matrix<TData> &b) { return Matrix<TData>(a + b); }, *this, rhs);
+        }
+
+        AsyncMatrix operator-(const AsyncMatrix &rhs) const
+        {
+            return asyncCombine([](const Matrix<TData> &a, const Matrix<TData> &b) { return Matrix<TData>(a - b); }, *this, rhs);
+        }
+
+        AsyncMatrix operator*(const TData scalar) const
+        {
+            return asyncCombine([scalar](const Matrix<TData> &a) { return Matrix<TData>(a * scalar); }, *this);
+        }
+
+        AsyncMatrix transpose() const
+        {
+            return asyncCombine([](const Matrix<TData> &a) { return a.transpose(); }, *this);
+        }
+
+    private:
+        std::shared_ptr<AsyncState<TData>> m_state;
+    };
+
+    /**
+     * Handle to an existing Matrix, which is referred to rather than copied and must outlive the operations using it.
+     */
+    template <typename TData>
+    AsyncMatrix<TData> async(const Matrix<TData> &mat)
+    {
+        auto state = std::make_shared<AsyncState<TData>>();
+        state->complete(std::shared_ptr<const Matrix<TData>>(std::shared_ptr<const Matrix<TData>>(), &mat), nullptr);
+        return AsyncMatrix<TData>(state);
+    }
+
+    /**
+     * Handle owning a temporary Matrix. Matrix products are not lazy, so in async(A * B) the product is computed on
+     * the calling thread before async is called and nothing overlaps with it: write async(A) * async(B) instead, which
+     * adds the product to the task graph.
+     */
+    template <typename TData>
+    AsyncMatrix<TData> async(Matrix<TData> &&mat)
+    {
+        auto state = std::make_shared<AsyncState<TData>>();
+        state->complete(std::make_shared<const Matrix<TData>>(std::move(mat)), nullptr);
+        return AsyncMatrix<TData>(state);
+    }
+
+    /**
+     * Evaluates an expression such as A + B on the pool. The expression refers to its operands, which must outlive it.
+     */
+    template <typename TDerived>
+    AsyncMatrix<typename TDerived::value_type> async(const MatrixExpr<TDerived> &expr)
+    {
+        using TData = typename TDerived::value_type;
+        return asyncCombine([expr = expr.derived()]() { return Matrix<TData>(expr); });
+    }
+
+    /**
+     * Runs a callable returning a Matrix on the pool.
+     */
+    template <typename TFunc, typename = typename std::enable_if<std::is_invocable<TFunc &>::value>::type>
+    AsyncMatrix<AsyncResultType<TFunc>> async(TFunc func)
+    {
+        return asyncCombine(std::move(func));
+    }
+} // end namespace MatrixLibrary
+
+#endif // #ifndef ASYNC_MATRIX_HPP
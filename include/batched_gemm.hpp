@@ -0,0 +1,253 @@
+/**
+ * @file batched_gemm.hpp
+ * @author Alex Liu (alex.liuyining@outlook.com)
+ * @brief Batched multiplication of many small independent matrix pairs into preallocated outputs
+ * @date 2021-12
+ */
+
+#ifndef BATCHED_GEMM_HPP
+#define BATCHED_GEMM_HPP
+
+#include <vector>
+#include <cassert>
+#include <algorithm>
+#include "simd_kernels.hpp"
+#include "gemm_kernel.hpp"
+#include "concurrency_utils.hpp"
+#include "matrix_library.hpp"
+
+namespace MatrixLibrary
+{
+    /**
+     * C = A * B for a small product, overwriting C. When NFixed is non-zero, N equals NFixed and each row of C is
+     * accumulated in a local array of compile-time length, which the compiler keeps in vector registers across the
+     * whole K loop and stores once. It is force inlined into the target specific wrappers below.
+     *
+     * @tparam NFixed Compile-time number of columns, or 0 if only known at runtime
+     */
+    template <size_t NFixed, typename TData>
+    MATRIX_LIBRARY_ALWAYS_INLINE inline void batchedSmallLoop(const size_t M, const size_t N, const size_t K, const TData *A, const size_t lda,
+        const TData *B, const size_t ldb, TData *C, const size_t ldc)
+    {
+        if constexpr (NFixed != 0)
+        {
+            for (size_t i = 0; i < M; ++i)
+            {
+                TData acc[NFixed] = {};
+                for (size_t k = 0; k < K; ++k)
+                {
+                    const TData a = A[i * lda + k];
+                    const TData *b_row = B + k * ldb;
+                    for (size_t j = 0; j < NFixed; ++j)
+                    {
+                        acc[j] += a * b_row[j];
+                    }
+                }
+                std::copy(acc, acc + NFixed, C + i * ldc);
+            }
+            return;
+        }
+
+        for (size_t i = 0; i < M; ++i)
+        {
+            TData *c_row = C + i * ldc;
+            std::fill(c_row, c_row + N, TData(0));
+            for (size_t k = 0; k < K; ++k)
+            {
+                const TData a = A[i * lda + k];
+                const TData *b_row = B + k * ldb;
+                for (size_t j = 0; j < N; ++j)
+                {
+                    c_row[j] += a * b_row[j];
+                }
+            }
+        }
+    }
+
+    template <typename TData>
+    using BatchedKernelFn = void (*)(size_t, size_t, size_t, const TData *, size_t, const TData *, size_t, TData *, size_t);
+
+    template <size_t NFixed, typename TData>
+    void batchedSmallKernel(const size_t M, const size_t N, const size_t K, const TData *A, const size_t lda,
+        const TData *B, const size_t ldb, TData *C, const size_t ldc)
+    {
+        batchedSmallLoop<NFixed>(M, N, K, A, lda, B, ldb, C, ldc);
+    }
+
+#if MATRIX_LIBRARY_X86_SIMD
+    template <size_t NFixed, typename TData>
+    MATRIX_LIBRARY_TARGET("avx2,fma")
+    void batchedSmallKernelAvx2(const size_t M, const size_t N, const size_t K, const TData *A, const size_t lda,
+        const TData *B, const size_t ldb, TData *C, const size_t ldc)
+    {
+        batchedSmallLoop<NFixed>(M, N, K, A, lda, B, ldb, C, ldc);
+    }
+
+    template <size_t NFixed, typename TData>
+    MATRIX_LIBRARY_TARGET("avx512f")
+    void batchedSmallKernelAvx512(const size_t M, const size_t N, const size_t K, const TData *A, const size_t lda,
+        const TData *B, const size_t ldb, TData *C, const size_t ldc)
+    {
+        batchedSmallLoop<NFixed>(M, N, K, A, lda, B, ldb, C, ldc);
+    }
+#endif
+
+    template <size_t NFixed, typename TData>
+    BatchedKernelFn<TData> selectBatchedKernelFor()
+    {
+#if MATRIX_LIBRARY_X86_SIMD
+        switch (simd_level)
+        {
+        case SimdLevel::AVX512:
+            return &batchedSmallKernelAvx512<NFixed, TData>;
+        case SimdLevel::AVX2:
+            return &batchedSmallKernelAvx2<NFixed, TData>;
+        default:
+            break;
+        }
+#endif
+        return &batchedSmallKernel<NFixed, TData>;
+    }
+
+    /**
+     * Kernel for an M x K by K x N product of a batch. Small products use the direct kernel, specialized on the common
+     * widths 4, 8, 16 and 32, and larger ones go through the packed blocked kernel.
+     *
+     * @return Function computing C = A * B
+     */
+    template <typename TData>
+    BatchedKernelFn<TData> selectBatchedKernel(const size_t M, const size_t N, const size_t K)
+    {
+        if (M * N * K > gemm_small_threshold)
+        {
+            return [](const size_t m, const size_t n, const size_t k, const TData *A, const size_t lda, const TData *B, const size_t ldb,
+                TData *C, const size_t ldc)
+            {
+                for (size_t i = 0; i < m; ++i)
+                {
+                    std::fill(C + i * ldc, C + i * ldc + n, TData(0));
+                }
+                gemmBlocked(m, n, k, TData(1), A, lda, B, ldb, C, ldc);
+            };
+        }
+        switch (N)
+        {
+        case 4:
+            return selectBatchedKernelFor<4, TData>();
+        case 8:
+            return selectBatchedKernelFor<8, TData>();
+        case 16:
+            return selectBatchedKernelFor<16, TData>();
+        case 32:
+            return selectBatchedKernelFor<32, TData>();
+        default:
+            return selectBatchedKernelFor<0, TData>();
+        }
+    }
+
+    // Products per task are grouped so that a task does at least this many multiply-adds
+    static constexpr size_t batched_min_task_work = 32 * 32 * 32;
+
+    /**
+     * Calls func(i) for every item of a batch of products of M * N * K multiply-adds each, spreading the batch across
+     * threads depending on the n_threads setting.
+     */
+    template <typename TFunc>
+    void forEachInBatch(const size_t batch_count, const size_t work_per_item, TFunc func)
+    {
+        const size_t items_per_task = std::max<size_t>(batched_min_task_work / std::max<size_t>(work_per_item, 1), 1);
+        const size_t n_tasks = (batch_count + items_per_task - 1) / items_per_task;
+        parallelFor(n_tasks, n_threads, [&](const size_t task)
+        {
+            const size_t end = std::min(batch_count, (task + 1) * items_per_task);
+            for (size_t i = task * items_per_task; i < end; ++i)
+            {
+                func(i);
+            }
+        });
+    }
+
+    /**
+     * Computes C_i = A_i * B_i for a strided batch, where operand i starts at A + i * stride_a, B + i * stride_b and
+     * C + i * stride_c. All products have the same shape, and C must be preallocated. Nothing is printed.
+     *
+     * @tparam TData
+     * @param batch_count Number of products
+     * @param M Rows of every A_i and C_i
+     * @param N Columns of every B_i and C_i
+     * @param K Columns of every A_i, rows of every B_i
+     * @param A
+     * @param lda Row stride within each A_i
+     * @param stride_a Distance between consecutive A_i, in elements
+     * @param B
+     * @param ldb Row stride within each B_i
+     * @param stride_b Distance between consecutive B_i, in elements
+     * @param C
+     * @param ldc Row stride within each C_i
+     * @param stride_c Distance between consecutive C_i, in elements
+     */
+    template <typename TData>
+    void multiplyBatched(const size_t batch_count, const size_t M, const size_t N, const size_t K,
+        const TData *A, const size_t lda, const size_t stride_a, const TData *B, const size_t ldb, const size_t stride_b,
+        TData *C, const size_t ldc, const size_t stride_c)
+    {
+        const BatchedKernelFn<TData> kernel = selectBatchedKernel<TData>(M, N, K);
+        forEachInBatch(batch_count, M * N * K, [&](const size_t i)
+        {
+            kernel(M, N, K, A + i * stride_a, lda, B + i * stride_b, ldb, C + i * stride_c, ldc);
+        });
+    }
+
+    /**
+     * Computes *C[i] = *A[i] * *B[i] for a batch given as arrays of pointers, all products have the same shape.
+     * C[i] must point to preallocated outputs. Nothing is printed.
+     *
+     * @tparam TData
+     * @param batch_count Number of products, the length of each pointer array
+     * @param M Rows of every A_i and C_i
+     * @param N Columns of every B_i and C_i
+     * @param K Columns of every A_i, rows of every B_i
+     * @param A
+     * @param lda Row stride within each A_i
+     * @param B
+     * @param ldb Row stride within each B_i
+     * @param C
+     * @param ldc Row stride within each C_i
+     */
+    template <typename TData>
+    void multiplyBatched(const size_t batch_count, const size_t M, const size_t N, const size_t K,
+        const TData *const *A, const size_t lda, const TData *const *B, const size_t ldb, TData *const *C, const size_t ldc)
+    {
+        const BatchedKernelFn<TData> kernel = selectBatchedKernel<TData>(M, N, K);
+        forEachInBatch(batch_count, M * N * K, [&](const size_t i)
+        {
+            kernel(M, N, K, A[i], lda, B[i], ldb, C[i], ldc);
+        });
+    }
+
+    /**
+     * Computes result[i] = lhs[i] * rhs[i] for batches of matrices, which may have different shapes. The results must
+     * be preallocated with the dimensions of each product and are overwritten in place. Nothing is printed.
+     *
+     * @tparam TData
+     * @param lhs
+     * @param rhs
+     * @param result
+     */
+    template <typename TData>
+    void multiplyBatched(const std::vector<Matrix<TData>> &lhs, const std::vector<Matrix<TData>> &rhs, std::vector<Matrix<TData>> &result)
+    {
+        assert(lhs.size() == rhs.size() && lhs.size() == result.size() && "Batches must have the same size");
+        const size_t work_per_item = lhs.empty() ? 1 : lhs[0].rows() * lhs[0].cols() * rhs[0].cols();
+        forEachInBatch(lhs.size(), work_per_item, [&](const size_t i)
+        {
+            const size_t M = lhs[i].rows(), K = lhs[i].cols(), N = rhs[i].cols();
+            assert(K == rhs[i].rows() && "First matrix's cols must match second matrix's rows");
+            assert(result[i].rows() == M && result[i].cols() == N && "Result must be preallocated with the product's dimensions");
+            selectBatchedKernel<TData>(M, N, K)(M, N, K, lhs[i].data(), lhs[i].stride(), rhs[i].data(), rhs[i].stride(),
+                result[i].data(), result[i].stride());
+        });
+    }
+} // end namespace MatrixLibrary
+
+#endif // #ifndef BATCHED_GEMM_HPP
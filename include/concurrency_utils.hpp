@@ -8,94 +8,210 @@
 #ifndef CONCURRENCY_UTILS_HPP
 #define CONCURRENCY_UTILS_HPP
 
-#include <thread>
-#include <future>
 #include <vector>
 #include <algorithm>
-#include <iostream>
-#include <mutex>
+#include <functional>
+#include <cmath>
+#include "gemm_kernel.hpp"
+#include "thread_pool.hpp"
+#include "instrumentation.hpp"
 
 namespace MatrixLibrary
 {
-    // Mutex used to protect cout for all threads started by multiplyMatricesAsync
-    static std::mutex mtx_static;
+    /**
+     * Calls func(i) for every i in [0, n_tasks) on the library thread pool, using at most n_threads threads
+     * including the calling one. Returns once all calls have completed.
+     *
+     * @param n_tasks
+     * @param n_threads
+     * @param func
+     */
+    inline void parallelFor(const size_t n_tasks, const size_t n_threads, const std::function<void(size_t)> &func)
+    {
+        ThreadPool::instance().parallelFor(n_tasks, n_threads, func);
+    }
 
     /**
-     * Compute certain elements of the multiplication result based on given parameters 
+     * Compute certain rows of the multiplication result using the cache-blocked kernel. All buffers are
+     * row-major, element (i, j) of a buffer with leading dimension ld is located at buffer[i * ld + j].
      * 
      * @tparam TData 
      * @param result 
+     * @param ld_result Row stride of result
      * @param starting_row 
      * @param rows_per_thread 
      * @param data1 
+     * @param ld1 Row stride of data1
      * @param data2
+     * @param ld2 Row stride of data2
      * @param cols1
      * @param cols2
      */
     template <typename TData>
-    void computeGivenRows(std::vector<std::vector<TData>> &result, const size_t starting_row, const size_t rows_per_thread, 
-        const std::vector<std::vector<TData>> &data1, const std::vector<std::vector<TData>> &data2, size_t cols1, size_t cols2)
+    void computeGivenRows(TData *result, const size_t ld_result, const size_t starting_row, const size_t rows_per_thread, 
+        const TData *data1, const size_t ld1, const TData *data2, const size_t ld2, size_t cols1, size_t cols2)
+    {
+        gemmBlocked(rows_per_thread, cols2, cols1, TData(1), data1 + starting_row * ld1, ld1, data2, ld2, 
+            result + starting_row * ld_result, ld_result);
+    }
+
+    /**
+     * Describes how the output of an M x K by K x N product is split into tasks: the result is divided into
+     * parts_m x parts_n tiles of tile_rows x tile_cols, and the inner dimension into parts_k chunks of tile_depth.
+     */
+    struct TilePartition
+    {
+        size_t tile_rows;
+        size_t tile_cols;
+        size_t tile_depth;
+        size_t parts_m;
+        size_t parts_n;
+        size_t parts_k;
+    };
+
+    // Minimum number of multiply-adds per task, below which scheduling overhead outweighs the parallelism gained
+    static constexpr size_t min_task_work = 64 * 64 * 64;
+
+    /**
+     * Chooses a 2D tiling of the result such that there are several tasks per thread to balance uneven progress,
+     * with tiles kept roughly square and aligned to the micro-kernel's register block. When the result is too small
+     * to give every thread a tile, e.g. for short-wide times tall-skinny products, the inner dimension is split as well
+     * and the partial products are reduced afterwards.
+     *
+     * @tparam TData
+     * @param M Rows of the result
+     * @param N Columns of the result
+     * @param K Inner dimension
+     * @param n_threads
+     * @return TilePartition
+     */
+    template <typename TData>
+    TilePartition partitionMultiplication(const size_t M, const size_t N, const size_t K, const size_t n_threads)
     {
-        std::unique_lock<std::mutex> uLock(mtx_static, std::defer_lock);
+        using Blocking = GemmBlocking<TData>;
+        const size_t max_tasks = std::max<size_t>(1, (M * N * K) / min_task_work);
+        const size_t target_tasks = std::min(4 * n_threads, max_tasks);
 
-        const size_t ending_row = starting_row + rows_per_thread;
-        for (size_t i = starting_row; i < ending_row; ++i)
+        // Split M and N proportionally to their lengths, but never below one register block per tile
+        const size_t max_parts_m = (M + Blocking::MR - 1) / Blocking::MR;
+        const size_t max_parts_n = (N + Blocking::NR - 1) / Blocking::NR;
+        const double ratio = std::sqrt((double)target_tasks * (double)M / (double)N);
+        const size_t parts_m = std::min(max_parts_m, std::max<size_t>(1, (size_t)std::lround(ratio)));
+        const size_t parts_n = std::min(max_parts_n, std::max<size_t>(1, (target_tasks + parts_m - 1) / parts_m));
+
+        TilePartition partition;
+        partition.tile_rows = (M + parts_m - 1) / parts_m;
+        partition.tile_rows = ((partition.tile_rows + Blocking::MR - 1) / Blocking::MR) * Blocking::MR;
+        partition.tile_cols = (N + parts_n - 1) / parts_n;
+        partition.tile_cols = ((partition.tile_cols + Blocking::NR - 1) / Blocking::NR) * Blocking::NR;
+        partition.parts_m = (M + partition.tile_rows - 1) / partition.tile_rows;
+        partition.parts_n = (N + partition.tile_cols - 1) / partition.tile_cols;
+
+        // Split K only if the output tiles cannot keep all threads busy, in chunks of at least one packed panel
+        size_t parts_k = 1;
+        const size_t output_tiles = partition.parts_m * partition.parts_n;
+        if (output_tiles < n_threads)
         {
-            for (size_t j = 0; j < cols2; ++j)
-            {
-                for (size_t k = 0; k < cols1; ++k)
-                {
-                    result[i][j] += data1[i][k] * data2[k][j];
-                }
-            }
+            parts_k = std::min((target_tasks + output_tiles - 1) / output_tiles, std::max<size_t>(1, K / Blocking::KC));
         }
-        uLock.lock();
-        // std::cout << "Row " << ending_row << " finished computing" << "\n";
+        partition.tile_depth = (K + parts_k - 1) / parts_k;
+        partition.parts_k = (K + partition.tile_depth - 1) / partition.tile_depth;
+        return partition;
     }
 
     /**
-     * Employs std::async to achieve multithreaded computation of matrix multiplication
+     * Employs the library thread pool to achieve multithreaded computation of matrix multiplication. The result
+     * is partitioned into 2D tiles, and along the inner dimension when needed, see partitionMultiplication.
+     * Partial products along the inner dimension are accumulated in separate buffers and reduced in parallel.
      * 
      * @tparam TData 
-     * @param result Vector of vectors holding the final computation result
-     * @param data1 Vector of vectors representing the first operand
-     * @param data2 Vector of vectors representing the second operand
+     * @param result Row-major buffer holding the final computation result
+     * @param ld_result Row stride of result
+     * @param data1 Row-major buffer representing the first operand
+     * @param ld1 Row stride of data1
+     * @param data2 Row-major buffer representing the second operand
+     * @param ld2 Row stride of data2
+     * @param final_rows Number of rows of data1 and result
+     * @param data1_cols Number of columns of data1, equal to the number of rows of data2
+     * @param final_cols Number of columns of data2 and result
      * @param n_threads The number of threads to use for the computation
+     * @param alpha Scaling factor applied to the product, which is added to result
+     * @param trans1 Whether data1 holds the transpose of the first operand, i.e. is data1_cols x final_rows
+     * @param trans2 Whether data2 holds the transpose of the second operand, i.e. is final_cols x data1_cols
      */
     template <typename TData>
-    void multiplyMatricesAsync(std::vector<std::vector<TData>> &result, const std::vector<std::vector<TData>>& data1, const std::vector<std::vector<TData>>& data2, size_t n_threads)
+    void multiplyMatricesAsync(TData *result, const size_t ld_result, const TData *data1, const size_t ld1, const TData *data2, const size_t ld2,
+        const size_t final_rows, const size_t data1_cols, const size_t final_cols, const size_t n_threads, const TData alpha = TData(1),
+        const bool trans1 = false, const bool trans2 = false)
     {
-        size_t final_rows = data1.size();
-        size_t final_cols = data2.front().size();
-        size_t data1_cols = data1.front().size();
+        // An empty product leaves the result unchanged, and would give a partition with empty tiles
+        if (final_rows == 0 || data1_cols == 0 || final_cols == 0)
+        {
+            return;
+        }
+        const TilePartition partition = partitionMultiplication<TData>(final_rows, final_cols, data1_cols, n_threads);
+        const size_t output_tiles = partition.parts_m * partition.parts_n;
+
+        // The first chunk along K accumulates directly into the result, the others into zero-initialized partial buffers
+        std::vector<std::vector<TData>> partials(partition.parts_k - 1, std::vector<TData>(final_rows * final_cols));
 
-        // If chosen n_threads is greater than number of rows available, create one thread per row
-        n_threads = (n_threads > final_rows) ? final_rows : n_threads;
+        // Measures the time each thread spends on tiles, when instrumentation is compiled in
+        LoadBalanceTracker tracker("multiply tile", std::min(output_tiles * partition.parts_k, n_threads));
+        parallelFor(output_tiles * partition.parts_k, n_threads, [&](const size_t task)
+        {
+            const size_t kp = task / output_tiles;
+            const size_t tile = task % output_tiles;
+            const size_t row = (tile / partition.parts_n) * partition.tile_rows;
+            const size_t col = (tile % partition.parts_n) * partition.tile_cols;
+            const size_t depth = kp * partition.tile_depth;
 
-        // Calculate the workload in terms of the number of rows in the final result's computation that is assigned to each thread
-        const size_t rows_per_thread = final_rows / n_threads;
-        const size_t remaining_rows = final_rows % n_threads;
-        size_t starting_row = 0;
+            const size_t rows = std::min(partition.tile_rows, final_rows - row);
+            const size_t cols = std::min(partition.tile_cols, final_cols - col);
+            const size_t inner = std::min(partition.tile_depth, data1_cols - depth);
+
+            TData *out = (kp == 0) ? result + row * ld_result + col : partials[kp - 1].data() + row * final_cols + col;
+            const size_t ld_out = (kp == 0) ? ld_result : final_cols;
+            tracker.run([&]()
+            {
+                gemmBlocked(rows, cols, inner, alpha, opElement(data1, ld1, row, depth, trans1), ld1,
+                    opElement(data2, ld2, depth, col, trans2), ld2, out, ld_out, trans1, trans2);
+            });
+        });
 
-        // Container for the threads used for computation
-        std::vector<std::future<void>> futures;
-        for (size_t i = 0; i < n_threads-1; ++i)
+        if (partials.empty())
         {
-            futures.emplace_back(
-                std::async(std::launch::async, computeGivenRows<TData>, std::ref(result), starting_row, rows_per_thread, std::ref(data1), std::ref(data2), data1_cols, final_cols));
-            starting_row += rows_per_thread;
+            return;
         }
-
-        // Compute the result for the last thread separately, as it may need to handle larger number of rows
-        futures.emplace_back(
-            std::async(std::launch::async, computeGivenRows<TData>, std::ref(result), starting_row, rows_per_thread + remaining_rows, std::ref(data1), std::ref(data2), data1_cols, final_cols));
-        
-        // Wait for all threads to finish work
-        std::for_each(futures.begin(), futures.end(), [](std::future<void> &ftr)
+        parallelFor(final_rows, n_threads, [&](const size_t i)
         {
-            ftr.wait();
+            TData *result_row = result + i * ld_result;
+            for (const std::vector<TData> &partial : partials)
+            {
+                elementwiseBinary(final_cols, result_row, partial.data() + i * final_cols, result_row, std::plus<TData>());
+            }
         });
     }
+
+    /**
+     * C += alpha * op(A) * op(B) for row-major buffers, on the calling thread for products below min_task_work
+     * multiply-adds and split by multiplyMatricesAsync otherwise. See gemmBlocked for the transpose flags.
+     */
+    template <typename TData>
+    void gemmUpdate(const size_t M, const size_t N, const size_t K, const TData alpha, const TData *A, const size_t lda,
+        const TData *B, const size_t ldb, TData *C, const size_t ldc, const size_t n_threads, const bool trans_a = false,
+        const bool trans_b = false)
+    {
+        if (M == 0 || N == 0 || K == 0)
+        {
+            return;
+        }
+        if (n_threads <= 1 || M * N * K < min_task_work)
+        {
+            gemmBlocked(M, N, K, alpha, A, lda, B, ldb, C, ldc, trans_a, trans_b);
+            return;
+        }
+        multiplyMatricesAsync(C, ldc, A, lda, B, ldb, M, K, N, n_threads, alpha, trans_a, trans_b);
+    }
 } // end namespace MatrixLibrary
 
 #endif // #ifndef CONCURRENCY_UTILS_HPP
@@ -0,0 +1,110 @@
+/**
+ * @file cpu_features.hpp
+ * @author Alex Liu (alex.liuyining@outlook.com)
+ * @brief Runtime detection of the SIMD instruction sets available on the host CPU
+ * @date 2021-12
+ */
+
+#ifndef CPU_FEATURES_HPP
+#define CPU_FEATURES_HPP
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define MATRIX_LIBRARY_X86_SIMD 1
+#else
+#define MATRIX_LIBRARY_X86_SIMD 0
+#endif
+
+namespace MatrixLibrary
+{
+    /**
+     * Instruction set levels that have dedicated kernels, ordered from least to most capable.
+     */
+    enum class SimdLevel
+    {
+        Scalar = 0,
+        SSE2 = 1,
+        AVX2 = 2,
+        AVX512 = 3
+    };
+
+    /**
+     * Queries the CPU for the most capable instruction set level supported by both the hardware and the OS.
+     * AVX2 is only reported together with FMA, since its kernels use fused multiply-add.
+     *
+     * @return SimdLevel
+     */
+    inline SimdLevel detectSimdLevel()
+    {
+#if MATRIX_LIBRARY_X86_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        {
+            return SimdLevel::AVX512;
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        {
+            return SimdLevel::AVX2;
+        }
+        if (__builtin_cpu_supports("sse2"))
+        {
+            return SimdLevel::SSE2;
+        }
+#endif
+        return SimdLevel::Scalar;
+    }
+
+    // Instruction set level used by the kernels, detected once at startup
+    inline SimdLevel simd_level = detectSimdLevel();
+
+    /**
+     * Queries the CPU for the AVX-512 byte/word and VNNI extensions used by the quantized kernels on top of the AVX512 level.
+     *
+     * @return true if both AVX512BW and AVX512-VNNI are supported
+     */
+    inline bool detectAvx512Vnni()
+    {
+#if MATRIX_LIBRARY_X86_SIMD
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vnni");
+#else
+        return false;
+#endif
+    }
+
+    inline bool detectAvx512Bw()
+    {
+#if MATRIX_LIBRARY_X86_SIMD
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512bw");
+#else
+        return false;
+#endif
+    }
+
+    static const bool has_avx512_bw = detectAvx512Bw();
+    static const bool has_avx512_vnni = detectAvx512Vnni();
+
+    /**
+     * Restricts the kernels to a given instruction set level, e.g. for testing the fallbacks.
+     * Requesting a level above what the CPU supports selects the highest supported level instead.
+     *
+     * @param simd_level_
+     */
+    inline void setSimdLevel(const SimdLevel simd_level_)
+    {
+        const SimdLevel detected = detectSimdLevel();
+        simd_level = (simd_level_ > detected) ? detected : simd_level_;
+    }
+
+    /**
+     * Getter for the instruction set level currently used by the kernels
+     *
+     * @return SimdLevel
+     */
+    inline SimdLevel getSimdLevel()
+    {
+        return simd_level;
+    }
+} // end namespace MatrixLibrary
+
+#endif // #ifndef CPU_FEATURES_HPP
@@ -0,0 +1,638 @@
+/**
+ * @file dense_vector.hpp
+ * @author Alex Liu (alex.liuyining@outlook.com)
+ * @brief Dense Vector type with matrix-vector, vector-matrix, dot, axpy and outer product kernels
+ * @date 2021-12
+ */
+
+#ifndef DENSE_VECTOR_HPP
+#define DENSE_VECTOR_HPP
+
+#include <vector>
+#include <cassert>
+#include <utility>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include "matrix_allocator.hpp"
+#include "simd_kernels.hpp"
+#include "concurrency_utils.hpp"
+#include "matrix_view.hpp"
+#include "matrix_library.hpp"
+
+namespace MatrixLibrary
+{
+    // Operations touching fewer elements than this run on the calling thread only, they are bound by memory bandwidth
+    // and too short to amortize waking other threads
+    static constexpr size_t vector_parallel_threshold = 1 << 16;
+
+    // Length of the column ranges of a vector-matrix product, small enough for the range of the result to stay in L1
+    static constexpr size_t vector_column_chunk = 1024;
+
+    /*
+     * Kernels shared by the SIMD wrappers below. Reductions keep one accumulator per vector lane in a local array, which
+     * the compiler maps to vector registers without having to reassociate floating point additions.
+     */
+
+    template <typename TData>
+    MATRIX_LIBRARY_ALWAYS_INLINE inline TData dotLoop(const size_t n, const TData *x, const TData *y)
+    {
+        constexpr size_t L = 128 / sizeof(TData);
+        TData acc[L] = {};
+        size_t i = 0;
+        for (; i + L <= n; i += L)
+        {
+            for (size_t l = 0; l < L; ++l)
+            {
+                acc[l] += x[i + l] * y[i + l];
+            }
+        }
+        TData sum = TData(0);
+        for (; i < n; ++i)
+        {
+            sum += x[i] * y[i];
+        }
+        for (size_t l = 0; l < L; ++l)
+        {
+            sum += acc[l];
+        }
+        return sum;
+    }
+
+    template <typename TData>
+    MATRIX_LIBRARY_ALWAYS_INLINE inline void axpyLoop(const size_t n, const TData alpha, const TData *x, TData *y)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            y[i] += alpha * x[i];
+        }
+    }
+
+    /**
+     * y[i] = alpha * dot(row i of A, x) + beta * y[i] for rows [row_begin, row_end). Four rows are processed at once so that
+     * every load of x is reused four times. When beta is zero, y is not read.
+     */
+    template <typename TData>
+    MATRIX_LIBRARY_ALWAYS_INLINE inline void gemvLoop(const size_t row_begin, const size_t row_end, const size_t cols, const TData alpha,
+        const TData *A, const size_t lda, const TData *x, const TData beta, TData *y)
+    {
+        constexpr size_t L = 64 / sizeof(TData);
+        auto store = [&](const size_t i, const TData sum)
+        {
+            y[i] = (beta == TData(0)) ? alpha * sum : alpha * sum + beta * y[i];
+        };
+
+        size_t i = row_begin;
+        for (; i + 4 <= row_end; i += 4)
+        {
+            const TData *a0 = A + i * lda, *a1 = a0 + lda, *a2 = a1 + lda, *a3 = a2 + lda;
+            TData acc0[L] = {}, acc1[L] = {}, acc2[L] = {}, acc3[L] = {};
+            size_t j = 0;
+            for (; j + L <= cols; j += L)
+            {
+                for (size_t l = 0; l < L; ++l)
+                {
+                    const TData xv = x[j + l];
+                    acc0[l] += a0[j + l] * xv;
+                    acc1[l] += a1[j + l] * xv;
+                    acc2[l] += a2[j + l] * xv;
+                    acc3[l] += a3[j + l] * xv;
+                }
+            }
+            TData s0 = TData(0), s1 = TData(0), s2 = TData(0), s3 = TData(0);
+            for (; j < cols; ++j)
+            {
+                s0 += a0[j] * x[j];
+                s1 += a1[j] * x[j];
+                s2 += a2[j] * x[j];
+                s3 += a3[j] * x[j];
+            }
+            for (size_t l = 0; l < L; ++l)
+            {
+                s0 += acc0[l];
+                s1 += acc1[l];
+                s2 += acc2[l];
+                s3 += acc3[l];
+            }
+            store(i, s0);
+            store(i + 1, s1);
+            store(i + 2, s2);
+            store(i + 3, s3);
+        }
+        for (; i < row_end; ++i)
+        {
+            store(i, dotLoop(cols, A + i * lda, x));
+        }
+    }
+
+    /**
+     * y[j] = alpha * sum_i x[i] * A(i, j) + beta * y[j] for columns [col_begin, col_end), streaming A row by row.
+     */
+    template <typename TData>
+    MATRIX_LIBRARY_ALWAYS_INLINE inline void gevmLoop(const size_t rows, const size_t col_begin, const size_t col_end, const TData alpha,
+        const TData *A, const size_t lda, const TData *x, const TData beta, TData *y)
+    {
+        TData *y_range = y + col_begin;
+        const size_t n = col_end - col_begin;
+        for (size_t j = 0; j < n; ++j)
+        {
+            y_range[j] = (beta == TData(0)) ? TData(0) : beta * y_range[j];
+        }
+        for (size_t i = 0; i < rows; ++i)
+        {
+            axpyLoop(n, alpha * x[i], A + i * lda + col_begin, y_range);
+        }
+    }
+
+#if MATRIX_LIBRARY_X86_SIMD
+    template <typename TData>
+    MATRIX_LIBRARY_TARGET("avx2,fma")
+    TData dotAvx2(const size_t n, const TData *x, const TData *y)
+    {
+        return dotLoop(n, x, y);
+    }
+
+    template <typename TData>
+    MATRIX_LIBRARY_TARGET("avx512f")
+    TData dotAvx512(const size_t n, const TData *x, const TData *y)
+    {
+        return dotLoop(n, x, y);
+    }
+
+    template <typename TData>
+    MATRIX_LIBRARY_TARGET("avx2,fma")
+    void axpyAvx2(const size_t n, const TData alpha, const TData *x, TData *y)
+    {
+        axpyLoop(n, alpha, x, y);
+    }
+
+    template <typename TData>
+    MATRIX_LIBRARY_TARGET("avx512f")
+    void axpyAvx512(const size_t n, const TData alpha, const TData *x, TData *y)
+    {
+        axpyLoop(n, alpha, x, y);
+    }
+
+    template <typename TData>
+    MATRIX_LIBRARY_TARGET("avx2,fma")
+    void gemvAvx2(const size_t row_begin, const size_t row_end, const size_t cols, const TData alpha, const TData *A, const size_t lda,
+        const TData *x, const TData beta, TData *y)
+    {
+        gemvLoop(row_begin, row_end, cols, alpha, A, lda, x, beta, y);
+    }
+
+    template <typename TData>
+    MATRIX_LIBRARY_TARGET("avx512f")
+    void gemvAvx512(const size_t row_begin, const size_t row_end, const size_t cols, const TData alpha, const TData *A, const size_t lda,
+        const TData *x, const TData beta, TData *y)
+    {
+        gemvLoop(row_begin, row_end, cols, alpha, A, lda, x, beta, y);
+    }
+
+    template <typename TData>
+    MATRIX_LIBRARY_TARGET("avx2,fma")
+    void gevmAvx2(const size_t rows, const size_t col_begin, const size_t col_end, const TData alpha, const TData *A, const size_t lda,
+        const TData *x, const TData beta, TData *y)
+    {
+        gevmLoop(rows, col_begin, col_end, alpha, A, lda, x, beta, y);
+    }
+
+    template <typename TData>
+    MATRIX_LIBRARY_TARGET("avx512f")
+    void gevmAvx512(const size_t rows, const size_t col_begin, const size_t col_end, const TData alpha, const TData *A, const size_t lda,
+        const TData *x, const TData beta, TData *y)
+    {
+        gevmLoop(rows, col_begin, col_end, alpha, A, lda, x, beta, y);
+    }
+#endif
+
+    /*
+     * Kernels dispatched on the instruction set level of the host, all on raw row-major buffers.
+     */
+
+    template <typename TData>
+    TData dotKernel(const size_t n, const TData *x, const TData *y)
+    {
+#if MATRIX_LIBRARY_X86_SIMD
+        switch (simd_level)
+        {
+        case SimdLevel::AVX512:
+            return dotAvx512(n, x, y);
+        case SimdLevel::AVX2:
+            return dotAvx2(n, x, y);
+        default:
+            break;
+        }
+#endif
+        return dotLoop(n, x, y);
+    }
+
+    template <typename TData>
+    void axpyKernel(const size_t n, const TData alpha, const TData *x, TData *y)
+    {
+#if MATRIX_LIBRARY_X86_SIMD
+        switch (simd_level)
+        {
+        case SimdLevel::AVX512:
+            axpyAvx512(n, alpha, x, y);
+            return;
+        case SimdLevel::AVX2:
+            axpyAvx2(n, alpha, x, y);
+            return;
+        default:
+            break;
+        }
+#endif
+        axpyLoop(n, alpha, x, y);
+    }
+
+    template <typename TData>
+    void gemvKernel(const size_t row_begin, const size_t row_end, const size_t cols, const TData alpha, const TData *A, const size_t lda,
+        const TData *x, const TData beta, TData *y)
+    {
+#if MATRIX_LIBRARY_X86_SIMD
+        switch (simd_level)
+        {
+        case SimdLevel::AVX512:
+            gemvAvx512(row_begin, row_end, cols, alpha, A, lda, x, beta, y);
+            return;
+        case SimdLevel::AVX2:
+            gemvAvx2(row_begin, row_end, cols, alpha, A, lda, x, beta, y);
+            return;
+        default:
+            break;
+        }
+#endif
+        gemvLoop(row_begin, row_end, cols, alpha, A, lda, x, beta, y);
+    }
+
+    template <typename TData>
+    void gevmKernel(const size_t rows, const size_t col_begin, const size_t col_end, const TData alpha, const TData *A, const size_t lda,
+        const TData *x, const TData beta, TData *y)
+    {
+#if MATRIX_LIBRARY_X86_SIMD
+        switch (simd_level)
+        {
+        case SimdLevel::AVX512:
+            gevmAvx512(rows, col_begin, col_end, alpha, A, lda, x, beta, y);
+            return;
+        case SimdLevel::AVX2:
+            gevmAvx2(rows, col_begin, col_end, alpha, A, lda, x, beta, y);
+            return;
+        default:
+            break;
+        }
+#endif
+        gevmLoop(rows, col_begin, col_end, alpha, A, lda, x, beta, y);
+    }
+
+    /**
+     * Number of chunks to split an operation touching n_elements into, one unless it is large enough to be multithreaded
+     * according to the n_threads setting.
+     */
+    inline size_t vectorParts(const size_t n_elements, const size_t max_parts)
+    {
+        if (n_threads <= 1 || n_elements < vector_parallel_threshold)
+        {
+            return 1;
+        }
+        return std::max<size_t>(std::min(n_threads, max_parts), 1);
+    }
+
+    /**
+     * Dense column vector of TData, stored in an aligned buffer like a Matrix.
+     *
+     * @tparam TData
+     */
+    template <typename TData>
+    class Vector
+    {
+        static_assert(std::is_arithmetic<TData>::value, "TData must be numeric");
+
+    public:
+        using value_type = TData;
+
+        Vector() = default;
+
+        /**
+         * Constructor for a vector of zeros.
+         *  @param size
+         */
+        explicit Vector(const size_t size): m_data(size, TData(0)) {}
+
+        /**
+         * Constructor copying the elements of a std::vector.
+         */
+        Vector(const std::vector<TData> &data): m_data(data.begin(), data.end()) {}
+
+        Vector(std::initializer_list<TData> data): m_data(data) {}
+
+        /**
+         * Constructor copying a single row or column of a matrix, e.g. Vector<double>(A.col(2)).
+         *  @throw std::invalid_argument if the view has more than one row and more than one column
+         */
+        explicit Vector(const ConstMatrixView<TData> &view)
+        {
+            if (view.rows() != 1 && view.cols() != 1)
+            {
+                throw std::invalid_argument("Only a single row or column can be converted to a Vector");
+            }
+            m_data.resize(view.rows() * view.cols());
+            for (size_t i = 0; i < view.rows(); ++i)
+            {
+                for (size_t j = 0; j < view.cols(); ++j)
+                {
+                    m_data[i * view.cols() + j] = view(i, j);
+                }
+            }
+        }
+
+        size_t size() const { return m_data.size(); }
+        TData *data() { return m_data.data(); }
+        const TData *data() const { return m_data.data(); }
+
+        TData &operator[](const size_t i) { return m_data[i]; }
+        const TData &operator[](const size_t i) const { return m_data[i]; }
+
+        /**
+         * Getter for the elements as a std::vector
+         *
+         * @return const std::vector<TData>
+         */
+        const std::vector<TData> getData() const
+        {
+            return std::vector<TData>(m_data.begin(), m_data.end());
+        }
+
+        /**
+         * Prints the elements of the vector on one line.
+         *
+         * @param p the number of decimals to display in case the data is floating point, default p = 2
+         */
+        void printData(int p = 2) const
+        {
+            for (const TData value : m_data)
+            {
+                std::cout << std::fixed << std::setprecision(p) << value << " ";
+            }
+            std::cout << std::endl;
+        }
+
+        /**
+         * View of the vector as a size x 1 matrix, for use in matrix expressions and products.
+         */
+        ConstMatrixView<TData> asColumn() const
+        {
+            return ConstMatrixView<TData>(m_data.data(), m_data.size(), 1, 1);
+        }
+
+        /**
+         * View of the vector as a 1 x size matrix.
+         */
+        ConstMatrixView<TData> asRow() const
+        {
+            return ConstMatrixView<TData>(m_data.data(), 1, m_data.size(), m_data.size());
+        }
+
+        Vector operator+(const Vector &rhs) const
+        {
+            Vector r(*this);
+            return r += rhs;
+        }
+
+        Vector operator-(const Vector &rhs) const
+        {
+            Vector r(*this);
+            return r -= rhs;
+        }
+
+        Vector &operator+=(const Vector &rhs)
+        {
+            assert(size() == rhs.size() && "Two vectors must have the same size");
+            elementwiseBinary(size(), data(), rhs.data(), data(), std::plus<TData>());
+            return *this;
+        }
+
+        Vector &operator-=(const Vector &rhs)
+        {
+            assert(size() == rhs.size() && "Two vectors must have the same size");
+            elementwiseBinary(size(), data(), rhs.data(), data(), std::minus<TData>());
+            return *this;
+        }
+
+        /**
+         * Product with a scalar, which promotes like those of Matrix, e.g. a Vector<int> times 0.5 gives doubles.
+         */
+        template <typename TScalar, typename = typename std::enable_if<std::is_arithmetic<TScalar>::value>::type>
+        Vector<PromotedType<TData, TScalar>> operator*(const TScalar scalar) const
+        {
+            using TResult = PromotedType<TData, TScalar>;
+            if constexpr (std::is_same<TResult, TData>::value)
+            {
+                Vector r(*this);
+                return r *= scalar;
+            }
+            else
+            {
+                Vector<TResult> r(size());
+                std::transform(m_data.begin(), m_data.end(), r.data(), [scalar](const TData value) { return (TResult)value * (TResult)scalar; });
+                return r;
+            }
+        }
+
+        Vector &operator*=(const TData scalar)
+        {
+            for (TData &value : m_data)
+            {
+                value *= scalar;
+            }
+            return *this;
+        }
+
+    private:
+        MatrixBuffer<TData> m_data;
+    };
+
+    // Keeps a parameter out of template argument deduction, so that e.g. a Matrix converts to the ConstMatrixView it binds to
+    template <typename T>
+    struct NonDeduced
+    {
+        using type = T;
+    };
+
+    /**
+     * Dot product of two vectors, multithreaded for long vectors.
+     */
+    template <typename TData>
+    TData dot(const Vector<TData> &x, const Vector<TData> &y)
+    {
+        assert(x.size() == y.size() && "Two vectors must have the same size");
+        const size_t n = x.size();
+        const size_t parts = vectorParts(n, n / 4096 + 1);
+        if (parts == 1)
+        {
+            return dotKernel(n, x.data(), y.data());
+        }
+
+        std::vector<TData> partials(parts);
+        const size_t chunk = (n + parts - 1) / parts;
+        parallelFor(parts, n_threads, [&](const size_t p)
+        {
+            const size_t begin = std::min(n, p * chunk);
+            partials[p] = dotKernel(std::min(n, begin + chunk) - begin, x.data() + begin, y.data() + begin);
+        });
+        TData sum = TData(0);
+        for (const TData partial : partials)
+        {
+            sum += partial;
+        }
+        return sum;
+    }
+
+    /**
+     * y += alpha * x, multithreaded for long vectors.
+     */
+    template <typename TData>
+    void axpy(const TData alpha, const Vector<TData> &x, Vector<TData> &y)
+    {
+        assert(x.size() == y.size() && "Two vectors must have the same size");
+        const size_t n = x.size();
+        const size_t parts = vectorParts(n, n / 4096 + 1);
+        const size_t chunk = (n + parts - 1) / parts;
+        parallelFor(parts, n_threads, [&](const size_t p)
+        {
+            const size_t begin = std::min(n, p * chunk);
+            axpyKernel(std::min(n, begin + chunk) - begin, alpha, x.data() + begin, y.data() + begin);
+        });
+    }
+
+    /**
+     * Matrix-vector product y = alpha * A * x + beta * y, with rows of A split across threads for large matrices.
+     * y is only read when beta is non-zero.
+     *
+     * @param alpha
+     * @param A rows x cols
+     * @param x Vector of size cols
+     * @param beta
+     * @param y Vector of size rows
+     */
+    template <typename TData>
+    void gemv(const TData alpha, const ConstMatrixView<typename NonDeduced<TData>::type> &A, const Vector<TData> &x, const TData beta, Vector<TData> &y)
+    {
+        assert(A.cols() == x.size() && A.rows() == y.size() && "Vector sizes must match the matrix dimensions");
+        const size_t rows = A.rows();
+        const size_t parts = vectorParts(rows * A.cols(), rows / 4 + 1);
+        const size_t chunk = ((rows + parts - 1) / parts + 3) / 4 * 4;
+        parallelFor(parts, n_threads, [&](const size_t p)
+        {
+            gemvKernel(std::min(rows, p * chunk), std::min(rows, (p + 1) * chunk), A.cols(), alpha, A.data(), A.stride(),
+                x.data(), beta, y.data());
+        });
+    }
+
+    /**
+     * Vector-matrix product y^T = alpha * x^T * A + beta * y^T, with columns of A split across threads for large matrices.
+     * y is only read when beta is non-zero.
+     *
+     * @param alpha
+     * @param x Vector of size rows
+     * @param A rows x cols
+     * @param beta
+     * @param y Vector of size cols
+     */
+    template <typename TData>
+    void gevm(const TData alpha, const Vector<TData> &x, const ConstMatrixView<typename NonDeduced<TData>::type> &A, const TData beta, Vector<TData> &y)
+    {
+        assert(A.rows() == x.size() && A.cols() == y.size() && "Vector sizes must match the matrix dimensions");
+        const size_t cols = A.cols();
+        const size_t n_chunks = (cols + vector_column_chunk - 1) / vector_column_chunk;
+        const size_t parts = vectorParts(A.rows() * cols, n_chunks);
+        parallelFor(n_chunks, parts, [&](const size_t c)
+        {
+            gevmKernel(A.rows(), c * vector_column_chunk, std::min(cols, (c + 1) * vector_column_chunk), alpha, A.data(), A.stride(),
+                x.data(), beta, y.data());
+        });
+    }
+
+    /**
+     * Rank-1 update A += alpha * x * y^T, with rows of A split across threads for large matrices.
+     */
+    template <typename TData>
+    void ger(const TData alpha, const Vector<TData> &x, const Vector<TData> &y, const MatrixView<typename NonDeduced<TData>::type> &A)
+    {
+        assert(A.rows() == x.size() && A.cols() == y.size() && "Vector sizes must match the matrix dimensions");
+        const size_t rows = A.rows();
+        const size_t parts = vectorParts(rows * A.cols(), rows);
+        const size_t chunk = (rows + parts - 1) / parts;
+        parallelFor(parts, n_threads, [&](const size_t p)
+        {
+            for (size_t i = p * chunk; i < std::min(rows, (p + 1) * chunk); ++i)
+            {
+                axpyKernel(A.cols(), alpha * x[i], y.data(), A.data() + i * A.stride());
+            }
+        });
+    }
+
+    /**
+     * Outer product x * y^T.
+     *
+     * @return x.size() x y.size() Matrix
+     */
+    template <typename TData>
+    Matrix<TData> outer(const Vector<TData> &x, const Vector<TData> &y)
+    {
+        Matrix<TData> r(x.size(), y.size());
+        ger(TData(1), x, y, MatrixView<TData>(r));
+        return r;
+    }
+
+    template <typename TData>
+    Vector<TData> operator*(const ConstMatrixView<TData> &A, const Vector<TData> &x)
+    {
+        Vector<TData> y(A.rows());
+        gemv(TData(1), A, x, TData(0), y);
+        return y;
+    }
+
+    template <typename TData>
+    Vector<TData> operator*(const MatrixView<TData> &A, const Vector<TData> &x)
+    {
+        return ConstMatrixView<TData>(A) * x;
+    }
+
+    template <typename TData>
+    Vector<TData> operator*(const Matrix<TData> &A, const Vector<TData> &x)
+    {
+        return ConstMatrixView<TData>(A) * x;
+    }
+
+    template <typename TData>
+    Vector<TData> operator*(const Vector<TData> &x, const ConstMatrixView<TData> &A)
+    {
+        Vector<TData> y(A.cols());
+        gevm(TData(1), x, A, TData(0), y);
+        return y;
+    }
+
+    template <typename TData>
+    Vector<TData> operator*(const Vector<TData> &x, const MatrixView<TData> &A)
+    {
+        return x * ConstMatrixView<TData>(A);
+    }
+
+    template <typename TData>
+    Vector<TData> operator*(const Vector<TData> &x, const Matrix<TData> &A)
+    {
+        return x * ConstMatrixView<TData>(A);
+    }
+
+    template <typename TData, typename TScalar, typename = typename std::enable_if<std::is_arithmetic<TScalar>::value>::type>
+    Vector<PromotedType<TData, TScalar>> operator*(const TScalar scalar, const Vector<TData> &x)
+    {
+        return x * scalar;
+    }
+} // end namespace MatrixLibrary
+
+#endif // #ifndef DENSE_VECTOR_HPP
@@ -0,0 +1,317 @@
+/**
+ * @file fixed_matrix.hpp
+ * @author Alex Liu (alex.liuyining@outlook.com)
+ * @brief Matrix with dimensions known at compile time and inline storage, for small matrices such as 3x3 and 4x4 transforms
+ * @date 2021-12
+ */
+
+#ifndef FIXED_MATRIX_HPP
+#define FIXED_MATRIX_HPP
+
+#include <array>
+#include <vector>
+#include <utility>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <type_traits>
+#include "matrix_library.hpp"
+
+namespace MatrixLibrary
+{
+    /**
+     * Matrix of TData with R rows and C columns stored inline in row-major order. There are no heap allocations and no
+     * virtual functions, and all operations are constexpr. Dimension mismatches are compile errors since the dimensions
+     * are part of the type. Multiplication and transpose are expanded over index sequences, so every element is computed
+     * by straight-line code that the compiler can keep in registers and vectorize.
+     *
+     * @tparam TData
+     * @tparam R Number of rows
+     * @tparam C Number of columns
+     */
+    template <typename TData, size_t R, size_t C>
+    class FixedMatrix
+    {
+        static_assert(std::is_arithmetic<TData>::value, "TData must be numeric");
+        static_assert(R > 0 && C > 0, "Matrix dimensions must be positive");
+
+    public:
+        using value_type = TData;
+
+        static constexpr size_t rows_v = R;
+        static constexpr size_t cols_v = C;
+
+        /**
+         * Default constructor, all elements are zero.
+         */
+        constexpr FixedMatrix(): m_data{} {}
+
+        /**
+         * Constructor from the R * C elements in row-major order, e.g. FixedMatrix<int, 2, 2>(1, 2, 3, 4).
+         */
+        template <typename... TValues, typename = typename std::enable_if<sizeof...(TValues) == R * C &&
+            (std::is_arithmetic<TValues>::value && ...)>::type>
+        constexpr FixedMatrix(const TValues... values): m_data{{static_cast<TData>(values)...}} {}
+
+        /**
+         * Constructor from the elements in row-major order.
+         */
+        constexpr explicit FixedMatrix(const std::array<TData, R * C> &data): m_data(data) {}
+
+        /**
+         * Constructor from a Matrix of the same dimensions.
+         *  @throw std::invalid_argument if the dimensions of mat are not R x C
+         */
+        explicit FixedMatrix(const Matrix<TData> &mat): m_data{}
+        {
+            if (mat.rows() != R || mat.cols() != C)
+            {
+                throw std::invalid_argument("Matrix dimensions do not match the FixedMatrix dimensions");
+            }
+            for (size_t i = 0; i < R; ++i)
+            {
+                for (size_t j = 0; j < C; ++j)
+                {
+                    m_data[i * C + j] = mat(i, j);
+                }
+            }
+        }
+
+        /**
+         * Identity matrix, only available for square matrices.
+         */
+        template <size_t N = R, typename = typename std::enable_if<N == C>::type>
+        static constexpr FixedMatrix identity()
+        {
+            FixedMatrix r;
+            for (size_t i = 0; i < R; ++i)
+            {
+                r.m_data[i * C + i] = TData(1);
+            }
+            return r;
+        }
+
+        /**
+         * Converts into a dynamically sized Matrix holding a copy of the elements.
+         */
+        Matrix<TData> toMatrix() const
+        {
+            return Matrix<TData>(R, C, MatrixBuffer<TData>(m_data.begin(), m_data.end()));
+        }
+
+        operator Matrix<TData>() const
+        {
+            return toMatrix();
+        }
+
+        static constexpr size_t rows() { return R; }
+        static constexpr size_t cols() { return C; }
+
+        /**
+         * Getter for the dimensions of the matrix, returned as a pair in the form of rows, cols
+         *
+         * @return std::pair <size_t, size_t>
+         */
+        static constexpr std::pair<size_t, size_t> getDimensions()
+        {
+            return std::make_pair(R, C);
+        }
+
+        constexpr TData &operator()(const size_t i, const size_t j)
+        {
+            return m_data[i * C + j];
+        }
+
+        constexpr const TData &operator()(const size_t i, const size_t j) const
+        {
+            return m_data[i * C + j];
+        }
+
+        constexpr TData *data() { return m_data.data(); }
+        constexpr const TData *data() const { return m_data.data(); }
+
+        /**
+         * Getter for the data as a vector of vectors, for comparison with Matrix::getData().
+         */
+        const std::vector<std::vector<TData>> getData() const
+        {
+            std::vector<std::vector<TData>> r(R, std::vector<TData>(C));
+            for (size_t i = 0; i < R; ++i)
+            {
+                for (size_t j = 0; j < C; ++j)
+                {
+                    r[i][j] = m_data[i * C + j];
+                }
+            }
+            return r;
+        }
+
+        /**
+         * Prints the data of the matrix.
+         *
+         * @param p the number of decimals to display in case the data is floating point, default p = 2
+         */
+        void printData(int p = 2) const
+        {
+            for (size_t i = 0; i < R; ++i)
+            {
+                for (size_t j = 0; j < C; ++j)
+                {
+                    std::cout << std::fixed << std::setprecision(p) << m_data[i * C + j] << " ";
+                }
+                std::cout << "\n";
+            }
+            std::cout << std::endl;
+        }
+
+        /**
+         * Product with a C x K matrix, the inner dimensions are checked by the type of the operand.
+         *
+         * @return R x K FixedMatrix
+         */
+        template <size_t K>
+        constexpr FixedMatrix<TData, R, K> operator*(const FixedMatrix<TData, C, K> &rhs) const
+        {
+            return multiplyElements(rhs, std::make_index_sequence<R * K>());
+        }
+
+        /**
+         * Transposed copy of the matrix.
+         *
+         * @return C x R FixedMatrix
+         */
+        constexpr FixedMatrix<TData, C, R> transpose() const
+        {
+            return transposeElements(std::make_index_sequence<R * C>());
+        }
+
+        constexpr FixedMatrix operator+(const FixedMatrix &rhs) const
+        {
+            return zipElements(rhs, [](const TData a, const TData b) { return a + b; }, std::make_index_sequence<R * C>());
+        }
+
+        constexpr FixedMatrix operator-(const FixedMatrix &rhs) const
+        {
+            return zipElements(rhs, [](const TData a, const TData b) { return a - b; }, std::make_index_sequence<R * C>());
+        }
+
+        constexpr FixedMatrix operator-() const
+        {
+            return zipElements(*this, [](const TData a, const TData) { return -a; }, std::make_index_sequence<R * C>());
+        }
+
+        /**
+         * Operations with a scalar promote like those of Matrix, e.g. a FixedMatrix<int> times 2.5 gives doubles.
+         */
+        template <typename TScalar, typename = typename std::enable_if<std::is_arithmetic<TScalar>::value>::type>
+        constexpr FixedMatrix<PromotedType<TData, TScalar>, R, C> operator*(const TScalar scalar) const
+        {
+            using TResult = PromotedType<TData, TScalar>;
+            return mapElements<TResult>([scalar](const TData a) { return (TResult)a * (TResult)scalar; }, std::make_index_sequence<R * C>());
+        }
+
+        template <typename TScalar, typename = typename std::enable_if<std::is_arithmetic<TScalar>::value>::type>
+        constexpr FixedMatrix<PromotedType<TData, TScalar>, R, C> operator/(const TScalar scalar) const
+        {
+            using TResult = PromotedType<TData, TScalar>;
+            return mapElements<TResult>([scalar](const TData a) { return (TResult)a / (TResult)scalar; }, std::make_index_sequence<R * C>());
+        }
+
+        constexpr FixedMatrix &operator+=(const FixedMatrix &rhs)
+        {
+            return *this = *this + rhs;
+        }
+
+        constexpr FixedMatrix &operator-=(const FixedMatrix &rhs)
+        {
+            return *this = *this - rhs;
+        }
+
+        constexpr FixedMatrix &operator*=(const FixedMatrix<TData, C, C> &rhs)
+        {
+            return *this = *this * rhs;
+        }
+
+        constexpr FixedMatrix &operator*=(const TData scalar)
+        {
+            return *this = *this * scalar;
+        }
+
+        constexpr FixedMatrix &operator/=(const TData scalar)
+        {
+            return *this = *this / scalar;
+        }
+
+        constexpr bool operator==(const FixedMatrix &rhs) const
+        {
+            for (size_t i = 0; i < R * C; ++i)
+            {
+                if (m_data[i] != rhs.m_data[i])
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        constexpr bool operator!=(const FixedMatrix &rhs) const
+        {
+            return !(*this == rhs);
+        }
+
+    private:
+        template <typename, size_t, size_t>
+        friend class FixedMatrix;
+
+        // Dot product of row i of this matrix with column j of rhs, expanded over the inner dimension
+        template <size_t K, size_t... Ks>
+        constexpr TData dotRowCol(const size_t i, const size_t j, const FixedMatrix<TData, C, K> &rhs, std::index_sequence<Ks...>) const
+        {
+            return ((m_data[i * C + Ks] * rhs.m_data[Ks * K + j]) + ...);
+        }
+
+        template <size_t K, size_t... Is>
+        constexpr FixedMatrix<TData, R, K> multiplyElements(const FixedMatrix<TData, C, K> &rhs, std::index_sequence<Is...>) const
+        {
+            return FixedMatrix<TData, R, K>(std::array<TData, R * K>{{dotRowCol(Is / K, Is % K, rhs, std::make_index_sequence<C>())...}});
+        }
+
+        // Element Is of the C x R result is element (Is % R, Is / R) of this matrix
+        template <size_t... Is>
+        constexpr FixedMatrix<TData, C, R> transposeElements(std::index_sequence<Is...>) const
+        {
+            return FixedMatrix<TData, C, R>(std::array<TData, R * C>{{m_data[(Is % R) * C + Is / R]...}});
+        }
+
+        template <typename TResult, typename TOp, size_t... Is>
+        constexpr FixedMatrix<TResult, R, C> mapElements(TOp op, std::index_sequence<Is...>) const
+        {
+            return FixedMatrix<TResult, R, C>(std::array<TResult, R * C>{{static_cast<TResult>(op(m_data[Is]))...}});
+        }
+
+        template <typename TOp, size_t... Is>
+        constexpr FixedMatrix zipElements(const FixedMatrix &rhs, TOp op, std::index_sequence<Is...>) const
+        {
+            return FixedMatrix(std::array<TData, R * C>{{static_cast<TData>(op(m_data[Is], rhs.m_data[Is]))...}});
+        }
+
+        std::array<TData, R * C> m_data;
+    };
+
+    template <typename TData, size_t R, size_t C, typename TScalar, typename = typename std::enable_if<std::is_arithmetic<TScalar>::value>::type>
+    constexpr FixedMatrix<PromotedType<TData, TScalar>, R, C> operator*(const TScalar scalar, const FixedMatrix<TData, R, C> &mat)
+    {
+        return mat * scalar;
+    }
+
+    template <typename TData>
+    using Matrix2 = FixedMatrix<TData, 2, 2>;
+
+    template <typename TData>
+    using Matrix3 = FixedMatrix<TData, 3, 3>;
+
+    template <typename TData>
+    using Matrix4 = FixedMatrix<TData, 4, 4>;
+} // end namespace MatrixLibrary
+
+#endif // #ifndef FIXED_MATRIX_HPP
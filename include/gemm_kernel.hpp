@@ -0,0 +1,394 @@
+/**
+ * @file gemm_kernel.hpp
+ * @author Alex Liu (alex.liuyining@outlook.com)
+ * @brief Cache-blocked matrix multiplication kernel with packed operands, following the GotoBLAS loop structure
+ * @date 2021-12
+ */
+
+#ifndef GEMM_KERNEL_HPP
+#define GEMM_KERNEL_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include "simd_kernels.hpp"
+
+namespace MatrixLibrary
+{
+    /**
+     * Blocking parameters of the multiplication kernel for a given datatype.
+     * MR x NR is the register block computed by the micro-kernel, KC is the depth of a packed panel
+     * (a KC x NR sliver of B should stay in L1), MC x KC is the packed block of A kept in L2 and
+     * KC x NC is the packed panel of B kept in L3.
+     *
+     * @tparam TData
+     */
+    template <typename TData>
+    struct GemmBlocking
+    {
+        static constexpr size_t MR = 4;
+        static constexpr size_t NR = 8;
+        static constexpr size_t KC = 256;
+        static constexpr size_t MC = 96;
+        static constexpr size_t NC = 4096;
+    };
+
+    template <>
+    struct GemmBlocking<float>
+    {
+        static constexpr size_t MR = 4;
+        static constexpr size_t NR = 16;
+        static constexpr size_t KC = 256;
+        static constexpr size_t MC = 128;
+        static constexpr size_t NC = 4096;
+    };
+
+    template <>
+    struct GemmBlocking<int>
+    {
+        static constexpr size_t MR = 4;
+        static constexpr size_t NR = 16;
+        static constexpr size_t KC = 256;
+        static constexpr size_t MC = 128;
+        static constexpr size_t NC = 4096;
+    };
+
+    template <>
+    struct GemmBlocking<short>
+    {
+        static constexpr size_t MR = 4;
+        static constexpr size_t NR = 16;
+        static constexpr size_t KC = 512;
+        static constexpr size_t MC = 128;
+        static constexpr size_t NC = 4096;
+    };
+
+    // Problems with fewer multiply-adds than this are computed directly, since packing would dominate
+    static constexpr size_t gemm_small_threshold = 32 * 32 * 32;
+
+    /**
+     * Pointer to element (row, col) of op(X), where op(X) is X, or its transpose when trans is set, and X is row-major
+     * with row stride ld. The transpose is never formed, the kernels read X in transposed order instead.
+     */
+    template <typename TData>
+    const TData *opElement(const TData *X, const size_t ld, const size_t row, const size_t col, const bool trans)
+    {
+        return trans ? X + col * ld + row : X + row * ld + col;
+    }
+
+    /**
+     * Packs an mc x kc block of A into row panels of height MR. Within a panel the MR elements of each
+     * column are contiguous, and rows beyond mc are zero padded. The block is scaled by alpha while packing.
+     * When trans is set the block is read from a kc x mc block of A instead, each column of the packed panel then
+     * comes from contiguous elements of a row of A.
+     *
+     * @tparam TData
+     * @param mc Number of rows to pack
+     * @param kc Number of columns to pack
+     * @param A Pointer to the top left element of the block
+     * @param lda Row stride of A
+     * @param alpha Scaling factor
+     * @param packed Destination buffer of size at least roundUp(mc, MR) * kc
+     * @param trans Whether to pack the transpose of A
+     */
+    template <typename TData>
+    void packBlockA(const size_t mc, const size_t kc, const TData *A, const size_t lda, const TData alpha, TData *packed,
+        const bool trans = false)
+    {
+        constexpr size_t MR = GemmBlocking<TData>::MR;
+        const size_t row_step = trans ? 1 : lda;
+        const size_t col_step = trans ? lda : 1;
+        for (size_t ir = 0; ir < mc; ir += MR)
+        {
+            const size_t mr = std::min(MR, mc - ir);
+            for (size_t p = 0; p < kc; ++p)
+            {
+                for (size_t i = 0; i < mr; ++i)
+                {
+                    packed[i] = alpha * A[(ir + i) * row_step + p * col_step];
+                }
+                for (size_t i = mr; i < MR; ++i)
+                {
+                    packed[i] = TData(0);
+                }
+                packed += MR;
+            }
+        }
+    }
+
+    /**
+     * Packs a kc x nc panel of B into column panels of width NR. Within a panel the NR elements of each
+     * row are contiguous, and columns beyond nc are zero padded. When trans is set the panel is read from an nc x kc
+     * block of B instead, one row of B per column of the panel so that B is still read contiguously.
+     *
+     * @tparam TData
+     * @param kc Number of rows to pack
+     * @param nc Number of columns to pack
+     * @param B Pointer to the top left element of the panel
+     * @param ldb Row stride of B
+     * @param packed Destination buffer of size at least kc * roundUp(nc, NR)
+     * @param trans Whether to pack the transpose of B
+     */
+    template <typename TData>
+    void packPanelB(const size_t kc, const size_t nc, const TData *B, const size_t ldb, TData *packed, const bool trans = false)
+    {
+        constexpr size_t NR = GemmBlocking<TData>::NR;
+        for (size_t jr = 0; jr < nc; jr += NR)
+        {
+            const size_t nr = std::min(NR, nc - jr);
+            if (trans)
+            {
+                for (size_t j = 0; j < NR; ++j)
+                {
+                    const TData *b_row = B + (jr + j) * ldb;
+                    for (size_t p = 0; p < kc; ++p)
+                    {
+                        packed[p * NR + j] = (j < nr) ? b_row[p] : TData(0);
+                    }
+                }
+                packed += kc * NR;
+                continue;
+            }
+            for (size_t p = 0; p < kc; ++p)
+            {
+                const TData *b_row = B + p * ldb + jr;
+                for (size_t j = 0; j < nr; ++j)
+                {
+                    packed[j] = b_row[j];
+                }
+                for (size_t j = nr; j < NR; ++j)
+                {
+                    packed[j] = TData(0);
+                }
+                packed += NR;
+            }
+        }
+    }
+
+    /**
+     * Computes an MR x NR block of C from a packed sliver of A and a packed sliver of B,
+     * only the top left mr x nr elements are written back to C.
+     *
+     * @tparam TData
+     * @param kc Depth of the packed slivers
+     * @param a_packed MR x kc sliver of A
+     * @param b_packed kc x NR sliver of B
+     * @param C Pointer to the top left element of the block of C
+     * @param ldc Row stride of C
+     * @param mr Number of valid rows
+     * @param nr Number of valid columns
+     */
+    template <typename TData>
+    void microKernel(const size_t kc, const TData *a_packed, const TData *b_packed, TData *C, const size_t ldc, const size_t mr, const size_t nr)
+    {
+        constexpr size_t MR = GemmBlocking<TData>::MR;
+        constexpr size_t NR = GemmBlocking<TData>::NR;
+
+        TData acc[MR][NR] = {};
+        for (size_t p = 0; p < kc; ++p)
+        {
+            for (size_t i = 0; i < MR; ++i)
+            {
+                const TData a = a_packed[i];
+                for (size_t j = 0; j < NR; ++j)
+                {
+                    acc[i][j] += a * b_packed[j];
+                }
+            }
+            a_packed += MR;
+            b_packed += NR;
+        }
+
+        for (size_t i = 0; i < mr; ++i)
+        {
+            for (size_t j = 0; j < nr; ++j)
+            {
+                C[i * ldc + j] += acc[i][j];
+            }
+        }
+    }
+
+    template <typename TData>
+    using MicroKernelFn = void (*)(size_t, const TData *, const TData *, TData *, size_t, size_t, size_t);
+
+    /**
+     * Selects the micro-kernel for the instruction set level currently in use. Types without
+     * a vectorized kernel use the scalar one, which the compiler vectorizes for the baseline instruction set.
+     *
+     * @tparam TData
+     * @return MicroKernelFn<TData>
+     */
+    template <typename TData>
+    MicroKernelFn<TData> selectMicroKernel()
+    {
+        return &microKernel<TData>;
+    }
+
+#if MATRIX_LIBRARY_X86_SIMD
+    static_assert(GemmBlocking<double>::MR == 4 && GemmBlocking<double>::NR == 8, "SIMD kernels for double compute 4 x 8 blocks");
+    static_assert(GemmBlocking<float>::MR == 4 && GemmBlocking<float>::NR == 16, "SIMD kernels for float compute 4 x 16 blocks");
+    static_assert(GemmBlocking<int>::MR == 4 && GemmBlocking<int>::NR == 16, "SIMD kernels for int compute 4 x 16 blocks");
+
+    template <>
+    inline MicroKernelFn<double> selectMicroKernel<double>()
+    {
+        switch (simd_level)
+        {
+        case SimdLevel::AVX512:
+            return &microKernelAvx512;
+        case SimdLevel::AVX2:
+            return &microKernelAvx2;
+        case SimdLevel::SSE2:
+            return &microKernelSse2;
+        default:
+            return &microKernel<double>;
+        }
+    }
+
+    template <>
+    inline MicroKernelFn<float> selectMicroKernel<float>()
+    {
+        switch (simd_level)
+        {
+        case SimdLevel::AVX512:
+            return &microKernelAvx512;
+        case SimdLevel::AVX2:
+            return &microKernelAvx2;
+        case SimdLevel::SSE2:
+            return &microKernelSse2;
+        default:
+            return &microKernel<float>;
+        }
+    }
+
+    template <>
+    inline MicroKernelFn<int> selectMicroKernel<int>()
+    {
+        switch (simd_level)
+        {
+        case SimdLevel::AVX512:
+            return &microKernelAvx512;
+        case SimdLevel::AVX2:
+            return &microKernelAvx2;
+        default:
+            return &microKernel<int>;
+        }
+    }
+#endif // #if MATRIX_LIBRARY_X86_SIMD
+
+    /**
+     * Direct computation for small problems where packing is not worth it, uses i-k-j order so that
+     * the inner loop walks rows of B and C contiguously. With a transposed B each element of C is instead
+     * a dot product of a row of op(A) and a row of B.
+     */
+    template <typename TData>
+    void gemmSmall(const size_t M, const size_t N, const size_t K, const TData alpha, const TData *A, const size_t lda,
+        const TData *B, const size_t ldb, TData *C, const size_t ldc, const bool trans_a = false, const bool trans_b = false)
+    {
+        if (trans_a || trans_b)
+        {
+            for (size_t i = 0; i < M; ++i)
+            {
+                TData *c_row = C + i * ldc;
+                for (size_t j = 0; j < N; ++j)
+                {
+                    TData sum = TData(0);
+                    for (size_t k = 0; k < K; ++k)
+                    {
+                        sum += *opElement(A, lda, i, k, trans_a) * *opElement(B, ldb, k, j, trans_b);
+                    }
+                    c_row[j] += alpha * sum;
+                }
+            }
+            return;
+        }
+        for (size_t i = 0; i < M; ++i)
+        {
+            TData *c_row = C + i * ldc;
+            for (size_t k = 0; k < K; ++k)
+            {
+                const TData a = alpha * A[i * lda + k];
+                const TData *b_row = B + k * ldb;
+                for (size_t j = 0; j < N; ++j)
+                {
+                    c_row[j] += a * b_row[j];
+                }
+            }
+        }
+    }
+
+    /**
+     * Cache-blocked multiplication C += alpha * op(A) * op(B), where op(A) is M x K, op(B) is K x N and C is M x N,
+     * all row-major. B is packed one KC x NC panel at a time, A one MC x KC block at a time, and the micro-kernel
+     * computes MR x NR blocks of C out of the packed buffers. Packing buffers are thread local and reused across calls.
+     * The micro-kernel is selected at runtime based on the instruction sets supported by the host CPU.
+     * Transposed operands are only read in transposed order while packing, the micro-kernel is the same.
+     *
+     * @tparam TData
+     * @param M Rows of op(A) and C
+     * @param N Columns of op(B) and C
+     * @param K Columns of op(A), rows of op(B)
+     * @param alpha Scaling factor applied to the product
+     * @param A
+     * @param lda Row stride of A
+     * @param B
+     * @param ldb Row stride of B
+     * @param C
+     * @param ldc Row stride of C
+     * @param trans_a Whether op(A) is the transpose of A, which is then K x M
+     * @param trans_b Whether op(B) is the transpose of B, which is then N x K
+     */
+    template <typename TData>
+    void gemmBlocked(const size_t M, const size_t N, const size_t K, const TData alpha, const TData *A, const size_t lda,
+        const TData *B, const size_t ldb, TData *C, const size_t ldc, const bool trans_a = false, const bool trans_b = false)
+    {
+        using Blocking = GemmBlocking<TData>;
+        constexpr size_t MR = Blocking::MR;
+        constexpr size_t NR = Blocking::NR;
+
+        if (M == 0 || N == 0 || K == 0)
+        {
+            return;
+        }
+        if (M * N * K <= gemm_small_threshold)
+        {
+            gemmSmall(M, N, K, alpha, A, lda, B, ldb, C, ldc, trans_a, trans_b);
+            return;
+        }
+
+        const MicroKernelFn<TData> kernel = selectMicroKernel<TData>();
+        thread_local std::vector<TData> a_buffer;
+        thread_local std::vector<TData> b_buffer;
+        a_buffer.resize(((Blocking::MC + MR - 1) / MR) * MR * Blocking::KC);
+        b_buffer.resize(Blocking::KC * ((Blocking::NC + NR - 1) / NR) * NR);
+
+        for (size_t jc = 0; jc < N; jc += Blocking::NC)
+        {
+            const size_t nc = std::min(Blocking::NC, N - jc);
+            for (size_t pc = 0; pc < K; pc += Blocking::KC)
+            {
+                const size_t kc = std::min(Blocking::KC, K - pc);
+                packPanelB(kc, nc, opElement(B, ldb, pc, jc, trans_b), ldb, b_buffer.data(), trans_b);
+
+                for (size_t ic = 0; ic < M; ic += Blocking::MC)
+                {
+                    const size_t mc = std::min(Blocking::MC, M - ic);
+                    packBlockA(mc, kc, opElement(A, lda, ic, pc, trans_a), lda, alpha, a_buffer.data(), trans_a);
+
+                    for (size_t jr = 0; jr < nc; jr += NR)
+                    {
+                        const size_t nr = std::min(NR, nc - jr);
+                        for (size_t ir = 0; ir < mc; ir += MR)
+                        {
+                            const size_t mr = std::min(MR, mc - ir);
+                            kernel(kc, a_buffer.data() + ir * kc, b_buffer.data() + jr * kc,
+                                C + (ic + ir) * ldc + jc + jr, ldc, mr, nr);
+                        }
+                    }
+                }
+            }
+        }
+    }
+} // end namespace MatrixLibrary
+
+#endif // #ifndef GEMM_KERNEL_HPP
@@ -1,58 +1,102 @@
 /**
  * @file identity_matrix.hpp
  * @author Alex Liu (alex.liuyining@outlook.com)
- * @brief Identity matrix class, derived from Matrix class
+ * @brief Identity matrix class, a structured matrix which only stores its size
  * @date 2021-12
  */
 
 #ifndef IDENTITY_MATRIX_HPP
 #define IDENTITY_MATRIX_HPP
 
+#include <cassert>
 #include <stdexcept>
-#include <iostream>
+#include <vector>
 #include "matrix_library.hpp"
+#include "structured_matrix.hpp"
 
 namespace MatrixLibrary
 {
     template <typename TData>
-    class IdentityMatrix : public Matrix<TData>
+    class IdentityMatrix : public StructuredMatrix<IdentityMatrix<TData>, TData>
     {
+        using Base = StructuredMatrix<IdentityMatrix<TData>, TData>;
+
     public:
+        using Base::operator*;
+        using Base::operator+;
+
         /**
          * The only constructor, takes a single dimensional number
          *  @param size
          */
-        IdentityMatrix (const size_t size) : Matrix<TData> (size, size)
+        explicit IdentityMatrix(const size_t size): m_size(size)
         {
             if (size <= 0)
             {
                 throw std::invalid_argument("Dimension must be positive integer");
             }
+        }
 
-            for (size_t i = 0; i < size; ++i)
-            {
-                this->m_data[i][i] = (TData) 1.0;
-            }
+        size_t size() const { return m_size; }
+        size_t rowBegin(const size_t i) const { return i; }
+        size_t rowEnd(const size_t i) const { return i + 1; }
+        const TData *rowData(const size_t) const { return &m_one; }
+        size_t storedSize() const { return m_size; }
 
-            if (printMemoryInfo)
-            {
-                std::cout << "Identity Dimensions-only Constructor called" << std::endl;
-            }
+        TData coeff(const size_t i, const size_t j) const
+        {
+            return (i == j) ? TData(1) : TData(0);
         }
 
-        Matrix<TData> operator*(const Matrix<TData> &mat) const override
+        TData operator()(const size_t i, const size_t j) const
         {
-            std::cout << "Overriden function * called!" << "\n";
-            Matrix<TData> r(mat);
-            return r;
+            return coeff(i, j);
         }
 
-        Matrix<TData> transpose() const override
+        /**
+         * Product with the identity, a copy of mat. The dimensions are not checked, an identity of any size
+         * acts as the neutral element.
+         */
+        Matrix<TData> multiplyDense(const Matrix<TData> &mat) const
         {
-            std::cout << "Overriden function transpose called!" << "\n";
-            Matrix<TData> r(*this);
-            return r;
+            return Matrix<TData>(mat);
         }
+
+        Matrix<TData> denseMultiply(const Matrix<TData> &mat) const
+        {
+            return Matrix<TData>(mat);
+        }
+
+        IdentityMatrix operator*(const IdentityMatrix &rhs) const
+        {
+            assert(m_size == rhs.m_size && "Two matrices must have the same dimensions");
+            return *this;
+        }
+
+        DiagonalMatrix<TData> operator+(const IdentityMatrix &rhs) const
+        {
+            assert(m_size == rhs.m_size && "Two matrices must have the same dimensions");
+            return DiagonalMatrix<TData>(std::vector<TData>(m_size, TData(2)));
+        }
+
+        IdentityMatrix transpose() const
+        {
+            return *this;
+        }
+
+        /**
+         * Solves this * x = b, i.e. returns a copy of b.
+         */
+        Matrix<TData> solve(const Matrix<TData> &b) const
+        {
+            assert(b.rows() == m_size && "Right-hand side must have as many rows as the matrix");
+            return Matrix<TData>(b);
+        }
+
+    private:
+        static constexpr TData m_one = TData(1);
+
+        size_t m_size;
     };
 } // end namespace MatrixLibrary
 
@@ -0,0 +1,411 @@
+/**
+ * @file instrumentation.hpp
+ * @author Alex Liu (alex.liuyining@outlook.com)
+ * @brief Opt-in counters, timers and trace events describing the work done by the library
+ * @date 2021-12
+ */
+
+#ifndef INSTRUMENTATION_HPP
+#define INSTRUMENTATION_HPP
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+
+/*
+ * Instrumentation is compiled in by defining MATRIX_LIBRARY_ENABLE_STATS=1 before including the library, e.g. with
+ * -DMATRIX_LIBRARY_ENABLE_STATS=1. Otherwise the hooks expand to nothing and the query functions return empty stats.
+ */
+#ifndef MATRIX_LIBRARY_ENABLE_STATS
+#define MATRIX_LIBRARY_ENABLE_STATS 0
+#endif
+
+namespace MatrixLibrary
+{
+    /**
+     * Snapshot of the counters collected since the last resetStats().
+     */
+    struct MatrixStats
+    {
+        // Matrix buffers obtained from and returned to MatrixAllocator, and the bytes obtained
+        uint64_t allocations = 0;
+        uint64_t deallocations = 0;
+        uint64_t bytes_allocated = 0;
+
+        // Copies and moves of Matrix objects, by construction or assignment
+        uint64_t copies = 0;
+        uint64_t moves = 0;
+
+        // Matrix products and their floating point operations, 2 * M * N * K per product
+        uint64_t multiplications = 0;
+        uint64_t flops = 0;
+
+        // Time spent by each thread in the tasks of multi-threaded products, indexed by the thread ids used in traces
+        std::vector<double> thread_compute_seconds;
+
+        // Multi-threaded products, and their load imbalance: the busiest thread's time over the mean time of the threads
+        uint64_t parallel_multiplications = 0;
+        double last_load_imbalance = 0.0;
+        double max_load_imbalance = 0.0;
+    };
+
+    /**
+     * Whether the instrumentation is compiled in.
+     */
+    constexpr bool statsEnabled()
+    {
+        return MATRIX_LIBRARY_ENABLE_STATS != 0;
+    }
+
+#if MATRIX_LIBRARY_ENABLE_STATS
+    /**
+     * Complete event of the Chrome trace-event format, a named span of time on one thread.
+     */
+    struct TraceEvent
+    {
+        const char *name;
+        size_t thread;
+        double begin_us;
+        double duration_us;
+    };
+
+    /**
+     * Process-wide storage of the counters. Counters are relaxed atomics, while per-thread times, load imbalance and
+     * trace events, which are recorded once per task or product rather than per element, are guarded by a mutex.
+     */
+    class StatsRegistry
+    {
+    public:
+        static StatsRegistry &instance()
+        {
+            static StatsRegistry registry;
+            return registry;
+        }
+
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> deallocations{0};
+        std::atomic<uint64_t> bytes_allocated{0};
+        std::atomic<uint64_t> copies{0};
+        std::atomic<uint64_t> moves{0};
+        std::atomic<uint64_t> multiplications{0};
+        std::atomic<uint64_t> flops{0};
+        std::atomic<bool> tracing{false};
+
+        // Small sequential id of the calling thread, used to index per-thread times and as tid in traces
+        static size_t threadId()
+        {
+            static std::atomic<size_t> next_id{0};
+            thread_local const size_t id = next_id.fetch_add(1);
+            return id;
+        }
+
+        // Microseconds since the registry was created, the time base of trace events
+        double now() const
+        {
+            return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_origin).count();
+        }
+
+        void addComputeTime(const size_t thread, const double seconds)
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            if (m_thread_compute_seconds.size() <= thread)
+            {
+                m_thread_compute_seconds.resize(thread + 1, 0.0);
+            }
+            m_thread_compute_seconds[thread] += seconds;
+        }
+
+        void addParallelRegion(const double imbalance)
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            ++m_parallel_multiplications;
+            m_last_load_imbalance = imbalance;
+            m_max_load_imbalance = std::max(m_max_load_imbalance, imbalance);
+        }
+
+        void addTraceEvent(const TraceEvent &event)
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_events.push_back(event);
+        }
+
+        MatrixStats snapshot()
+        {
+            MatrixStats stats;
+            stats.allocations = allocations.load();
+            stats.deallocations = deallocations.load();
+            stats.bytes_allocated = bytes_allocated.load();
+            stats.copies = copies.load();
+            stats.moves = moves.load();
+            stats.multiplications = multiplications.load();
+            stats.flops = flops.load();
+
+            std::lock_guard<std::mutex> lock(m_mtx);
+            stats.thread_compute_seconds = m_thread_compute_seconds;
+            stats.parallel_multiplications = m_parallel_multiplications;
+            stats.last_load_imbalance = m_last_load_imbalance;
+            stats.max_load_imbalance = m_max_load_imbalance;
+            return stats;
+        }
+
+        void reset()
+        {
+            for (std::atomic<uint64_t> *counter : {&allocations, &deallocations, &bytes_allocated, &copies, &moves, &multiplications, &flops})
+            {
+                counter->store(0);
+            }
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_thread_compute_seconds.clear();
+            m_parallel_multiplications = 0;
+            m_last_load_imbalance = 0.0;
+            m_max_load_imbalance = 0.0;
+        }
+
+        std::vector<TraceEvent> events()
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            return m_events;
+        }
+
+        void clearEvents()
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_events.clear();
+        }
+
+    private:
+        StatsRegistry() : m_origin(std::chrono::steady_clock::now()) {}
+
+        const std::chrono::steady_clock::time_point m_origin;
+        std::mutex m_mtx;
+        std::vector<double> m_thread_compute_seconds;
+        uint64_t m_parallel_multiplications = 0;
+        double m_last_load_imbalance = 0.0;
+        double m_max_load_imbalance = 0.0;
+        std::vector<TraceEvent> m_events;
+    };
+
+    /**
+     * Records a trace event spanning the lifetime of the object while tracing is active.
+     * The name must be a string literal or otherwise outlive the trace.
+     */
+    class ScopedTraceEvent
+    {
+    public:
+        explicit ScopedTraceEvent(const char *name) :
+            m_name(name), m_begin(StatsRegistry::instance().tracing ? StatsRegistry::instance().now() : -1.0)
+        {
+        }
+
+        ScopedTraceEvent(const ScopedTraceEvent &) = delete;
+        ScopedTraceEvent &operator=(const ScopedTraceEvent &) = delete;
+
+        ~ScopedTraceEvent()
+        {
+            if (m_begin >= 0.0)
+            {
+                StatsRegistry &registry = StatsRegistry::instance();
+                registry.addTraceEvent(TraceEvent{m_name, StatsRegistry::threadId(), m_begin, registry.now() - m_begin});
+            }
+        }
+
+    private:
+        const char *m_name;
+        const double m_begin;
+    };
+
+#define MATRIX_LIBRARY_STATS_CONCAT_(a, b) a##b
+#define MATRIX_LIBRARY_STATS_CONCAT(a, b) MATRIX_LIBRARY_STATS_CONCAT_(a, b)
+
+    // Adds n to one of the counters of StatsRegistry
+#define MATRIX_LIBRARY_COUNT(counter, n) \
+    ::MatrixLibrary::StatsRegistry::instance().counter.fetch_add((uint64_t)(n), std::memory_order_relaxed)
+
+    // Records the enclosing scope as a trace event
+#define MATRIX_LIBRARY_TRACE_SCOPE(name) \
+    const ::MatrixLibrary::ScopedTraceEvent MATRIX_LIBRARY_STATS_CONCAT(matrix_library_trace_, __LINE__)(name)
+#else
+#define MATRIX_LIBRARY_COUNT(counter, n) ((void)0)
+#define MATRIX_LIBRARY_TRACE_SCOPE(name) ((void)0)
+#endif
+
+    /**
+     * Measures the compute time of each thread taking part in a parallel region, and records the region's load
+     * imbalance when it ends. Without instrumentation, run() only calls the function.
+     */
+    class LoadBalanceTracker
+    {
+    public:
+        /**
+         * @param name Name of the trace events of the timed calls
+         * @param n_runners Number of threads the region may use, threads that get no work count as idle
+         */
+        LoadBalanceTracker(const char *name, const size_t n_runners)
+#if MATRIX_LIBRARY_ENABLE_STATS
+            : m_name(name), m_n_runners(std::max<size_t>(n_runners, 1))
+#endif
+        {
+            (void)name;
+            (void)n_runners;
+        }
+
+        LoadBalanceTracker(const LoadBalanceTracker &) = delete;
+        LoadBalanceTracker &operator=(const LoadBalanceTracker &) = delete;
+
+        /**
+         * Calls func() and adds its duration to the busy time of the calling thread.
+         */
+        template <typename TFunc>
+        void run(TFunc &&func)
+        {
+#if MATRIX_LIBRARY_ENABLE_STATS
+            StatsRegistry &registry = StatsRegistry::instance();
+            const double begin = registry.now();
+            func();
+            const double duration = registry.now() - begin;
+
+            const size_t thread = StatsRegistry::threadId();
+            registry.addComputeTime(thread, duration * 1e-6);
+            if (registry.tracing)
+            {
+                registry.addTraceEvent(TraceEvent{m_name, thread, begin, duration});
+            }
+            std::lock_guard<std::mutex> lock(m_mtx);
+            auto it = std::find_if(m_busy.begin(), m_busy.end(), [thread](const std::pair<size_t, double> &busy) { return busy.first == thread; });
+            if (it == m_busy.end())
+            {
+                m_busy.emplace_back(thread, duration);
+            }
+            else
+            {
+                it->second += duration;
+            }
+#else
+            func();
+#endif
+        }
+
+#if MATRIX_LIBRARY_ENABLE_STATS
+        ~LoadBalanceTracker()
+        {
+            double total = 0.0, busiest = 0.0;
+            for (const std::pair<size_t, double> &busy : m_busy)
+            {
+                total += busy.second;
+                busiest = std::max(busiest, busy.second);
+            }
+            const double mean = total / (double)std::max(m_n_runners, m_busy.size());
+            StatsRegistry::instance().addParallelRegion(mean > 0.0 ? busiest / mean : 1.0);
+        }
+
+    private:
+        const char *m_name;
+        const size_t m_n_runners;
+        std::mutex m_mtx;
+        std::vector<std::pair<size_t, double>> m_busy;
+#endif
+    };
+
+    /**
+     * Getter for the counters collected since the start of the program or the last resetStats().
+     * All fields are zero when the instrumentation is compiled out.
+     *
+     * @return MatrixStats
+     */
+    inline MatrixStats getStats()
+    {
+#if MATRIX_LIBRARY_ENABLE_STATS
+        return StatsRegistry::instance().snapshot();
+#else
+        return MatrixStats();
+#endif
+    }
+
+    /**
+     * Sets all counters back to zero, recorded trace events are kept.
+     */
+    inline void resetStats()
+    {
+#if MATRIX_LIBRARY_ENABLE_STATS
+        StatsRegistry::instance().reset();
+#endif
+    }
+
+    /**
+     * Starts recording trace events, discarding those of a previous trace.
+     */
+    inline void startTrace()
+    {
+#if MATRIX_LIBRARY_ENABLE_STATS
+        StatsRegistry::instance().clearEvents();
+        StatsRegistry::instance().tracing = true;
+#endif
+    }
+
+    /**
+     * Stops recording trace events, the recorded ones are kept until the next startTrace().
+     */
+    inline void stopTrace()
+    {
+#if MATRIX_LIBRARY_ENABLE_STATS
+        StatsRegistry::instance().tracing = false;
+#endif
+    }
+
+    /**
+     * Writes the recorded trace events in the Chrome trace-event JSON format, which can be opened with
+     * chrome://tracing or Perfetto. The counters are included as metadata.
+     *
+     * @param out
+     */
+    inline void writeTrace(std::ostream &out)
+    {
+        const MatrixStats stats = getStats();
+        const std::ios::fmtflags flags = out.flags();
+        const std::streamsize precision = out.precision();
+        out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+#if MATRIX_LIBRARY_ENABLE_STATS
+        bool first = true;
+        for (const TraceEvent &event : StatsRegistry::instance().events())
+        {
+            out << (first ? "" : ",") << "\n{\"name\":\"" << event.name << "\",\"cat\":\"matrix\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+                << event.thread << ",\"ts\":" << event.begin_us << ",\"dur\":" << event.duration_us << "}";
+            first = false;
+        }
+#endif
+        out << "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{"
+            << "\"allocations\":" << stats.allocations << ",\"deallocations\":" << stats.deallocations
+            << ",\"bytes_allocated\":" << stats.bytes_allocated << ",\"copies\":" << stats.copies << ",\"moves\":" << stats.moves
+            << ",\"multiplications\":" << stats.multiplications << ",\"flops\":" << stats.flops
+            << ",\"parallel_multiplications\":" << stats.parallel_multiplications
+            << ",\"max_load_imbalance\":" << stats.max_load_imbalance << "}}\n";
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+    /**
+     * Writes the recorded trace events to a file, see writeTrace(std::ostream &).
+     *
+     * @param path
+     * @throw std::runtime_error if the file cannot be written
+     */
+    inline void writeTrace(const std::string &path)
+    {
+        std::ofstream file(path);
+        writeTrace(file);
+        if (!file)
+        {
+            throw std::runtime_error("Could not write " + path);
+        }
+    }
+} // end namespace MatrixLibrary
+
+#endif // #ifndef INSTRUMENTATION_HPP
@@ -0,0 +1,205 @@
+/**
+ * @file matrix_allocator.hpp
+ * @author Alex Liu (alex.liuyining@outlook.com)
+ * @brief Aligned allocator for Matrix storage backed by a polymorphic memory resource, and a resettable arena
+ * @date 2021-12
+ */
+
+#ifndef MATRIX_ALLOCATOR_HPP
+#define MATRIX_ALLOCATOR_HPP
+
+#include <new>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include <memory_resource>
+#include "instrumentation.hpp"
+
+namespace MatrixLibrary
+{
+    // Alignment of every Matrix buffer, a cache line and the width of an AVX-512 register
+    static constexpr size_t matrix_alignment = 64;
+
+    // Resource used for new Matrix buffers on the calling thread
+    inline std::pmr::memory_resource *&currentMatrixResource()
+    {
+        thread_local std::pmr::memory_resource *resource = std::pmr::new_delete_resource();
+        return resource;
+    }
+
+    /**
+     * Getter for the memory resource new matrices allocate from on the calling thread, the global heap by default.
+     *
+     * @return std::pmr::memory_resource*
+     */
+    inline std::pmr::memory_resource *getMatrixResource()
+    {
+        return currentMatrixResource();
+    }
+
+    /**
+     * Sets the memory resource new matrices allocate from on the calling thread. Prefer ScopedMatrixResource,
+     * which restores the previous resource automatically.
+     *
+     * @param resource
+     * @return The previous resource
+     */
+    inline std::pmr::memory_resource *setMatrixResource(std::pmr::memory_resource *resource)
+    {
+        std::pmr::memory_resource *previous = currentMatrixResource();
+        currentMatrixResource() = resource ? resource : std::pmr::new_delete_resource();
+        return previous;
+    }
+
+    /**
+     * Allocator of Matrix buffers. Memory comes from a polymorphic memory resource, by default the one set for the
+     * calling thread when the allocator is created, and is always aligned to matrix_alignment bytes.
+     * Elements constructed without a value are default-initialized rather than zeroed, so that a buffer which is fully
+     * overwritten right away, e.g. by an expression, is not written twice.
+     *
+     * Copies of a Matrix allocate from the current resource of the copying thread, while moves take the buffer along
+     * with the resource it came from.
+     *
+     * @tparam TData
+     */
+    template <typename TData>
+    class MatrixAllocator
+    {
+    public:
+        using value_type = TData;
+        using propagate_on_container_copy_assignment = std::false_type;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+
+        MatrixAllocator() noexcept : m_resource(getMatrixResource()) {}
+
+        MatrixAllocator(std::pmr::memory_resource *resource) noexcept : m_resource(resource) {}
+
+        template <typename TOther>
+        MatrixAllocator(const MatrixAllocator<TOther> &other) noexcept : m_resource(other.resource()) {}
+
+        TData *allocate(const size_t n)
+        {
+            MATRIX_LIBRARY_COUNT(allocations, 1);
+            MATRIX_LIBRARY_COUNT(bytes_allocated, n * sizeof(TData));
+            return static_cast<TData *>(m_resource->allocate(n * sizeof(TData), alignment()));
+        }
+
+        void deallocate(TData *p, const size_t n)
+        {
+            MATRIX_LIBRARY_COUNT(deallocations, 1);
+            m_resource->deallocate(p, n * sizeof(TData), alignment());
+        }
+
+        template <typename TObject>
+        void construct(TObject *p) noexcept(std::is_nothrow_default_constructible<TObject>::value)
+        {
+            ::new ((void *)p) TObject;
+        }
+
+        template <typename TObject, typename... TArgs>
+        void construct(TObject *p, TArgs &&...args)
+        {
+            ::new ((void *)p) TObject(std::forward<TArgs>(args)...);
+        }
+
+        MatrixAllocator select_on_container_copy_construction() const
+        {
+            return MatrixAllocator();
+        }
+
+        std::pmr::memory_resource *resource() const
+        {
+            return m_resource;
+        }
+
+        template <typename TOther>
+        bool operator==(const MatrixAllocator<TOther> &other) const
+        {
+            return m_resource == other.resource() || m_resource->is_equal(*other.resource());
+        }
+
+        template <typename TOther>
+        bool operator!=(const MatrixAllocator<TOther> &other) const
+        {
+            return !(*this == other);
+        }
+
+    private:
+        static constexpr size_t alignment()
+        {
+            return std::max(matrix_alignment, alignof(TData));
+        }
+
+        std::pmr::memory_resource *m_resource;
+    };
+
+    template <typename TData>
+    using MatrixBuffer = std::vector<TData, MatrixAllocator<TData>>;
+
+    /**
+     * Bump allocator for Matrix temporaries. Allocation only advances a pointer within large blocks obtained from the
+     * upstream resource, freeing individual buffers does nothing, and reset() releases everything at once. Typical use
+     * is one reset per iteration of a loop whose temporaries are all dead by the end of the iteration.
+     *
+     * Matrices allocated from the arena must not be used after reset() or after the arena is destroyed. The arena is
+     * not thread-safe, it should only be made current on one thread at a time.
+     */
+    class MatrixArena
+    {
+    public:
+        /**
+         * @param initial_size Size in bytes of the first block, later blocks grow geometrically
+         * @param upstream Resource the blocks are obtained from
+         */
+        explicit MatrixArena(const size_t initial_size = size_t(1) << 20, std::pmr::memory_resource *upstream = std::pmr::new_delete_resource()):
+            m_resource(initial_size, upstream)
+        {
+        }
+
+        MatrixArena(const MatrixArena &) = delete;
+        MatrixArena &operator=(const MatrixArena &) = delete;
+
+        std::pmr::memory_resource *resource()
+        {
+            return &m_resource;
+        }
+
+        /**
+         * Releases all memory allocated from the arena.
+         */
+        void reset()
+        {
+            m_resource.release();
+        }
+
+    private:
+        std::pmr::monotonic_buffer_resource m_resource;
+    };
+
+    /**
+     * Makes a memory resource current for new matrices on the calling thread for the lifetime of the object,
+     * e.g. ScopedMatrixResource scope(arena); inside a loop body.
+     */
+    class ScopedMatrixResource
+    {
+    public:
+        explicit ScopedMatrixResource(std::pmr::memory_resource *resource) : m_previous(setMatrixResource(resource)) {}
+
+        explicit ScopedMatrixResource(MatrixArena &arena) : ScopedMatrixResource(arena.resource()) {}
+
+        ScopedMatrixResource(const ScopedMatrixResource &) = delete;
+        ScopedMatrixResource &operator=(const ScopedMatrixResource &) = delete;
+
+        ~ScopedMatrixResource()
+        {
+            setMatrixResource(m_previous);
+        }
+
+    private:
+        std::pmr::memory_resource *m_previous;
+    };
+} // end namespace MatrixLibrary
+
+#endif // #ifndef MATRIX_ALLOCATOR_HPP
@@ -0,0 +1,259 @@
+/**
+ * @file matrix_chain.hpp
+ * @author Alex Liu (alex.liuyining@outlook.com)
+ * @brief Products of chains of matrices evaluated in the cheapest order found by dynamic programming
+ * @date 2021-12
+ */
+
+#ifndef MATRIX_CHAIN_HPP
+#define MATRIX_CHAIN_HPP
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <limits>
+#include <mutex>
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include "instrumentation.hpp"
+#include "matrix_allocator.hpp"
+#include "concurrency_utils.hpp"
+#include "matrix_library.hpp"
+
+namespace MatrixLibrary
+{
+    /**
+     * Cheapest order of evaluation of the product of a chain of matrices, found with the classic O(n^3) dynamic
+     * programme over the dimensions. The product of matrices [i, j] is split as [i, k] * [k + 1, j] with k = split(i, j).
+     */
+    class MatrixChainPlan
+    {
+    public:
+        /**
+         * @param dims (rows, cols) of each matrix of the chain, the cols of each must match the rows of the next
+         */
+        explicit MatrixChainPlan(const std::vector<std::pair<size_t, size_t>> &dims):
+            m_n(dims.size()), m_cost(dims.size() * dims.size(), 0), m_split(dims.size() * dims.size(), 0)
+        {
+            if (dims.empty())
+            {
+                throw std::invalid_argument("Chain must contain at least one matrix");
+            }
+            for (size_t i = 0; i + 1 < m_n; ++i)
+            {
+                if (dims[i].second != dims[i + 1].first)
+                {
+                    throw std::invalid_argument("Cols of each matrix of the chain must match the rows of the next");
+                }
+            }
+
+            for (size_t length = 2; length <= m_n; ++length)
+            {
+                for (size_t i = 0; i + length <= m_n; ++i)
+                {
+                    const size_t j = i + length - 1;
+                    double best = std::numeric_limits<double>::max();
+                    for (size_t k = i; k < j; ++k)
+                    {
+                        const double cost = m_cost[i * m_n + k] + m_cost[(k + 1) * m_n + j]
+                            + (double)dims[i].first * (double)dims[k].second * (double)dims[j].second;
+                        if (cost < best)
+                        {
+                            best = cost;
+                            m_split[i * m_n + j] = k;
+                        }
+                    }
+                    m_cost[i * m_n + j] = best;
+                }
+            }
+        }
+
+        size_t size() const
+        {
+            return m_n;
+        }
+
+        size_t split(const size_t i, const size_t j) const
+        {
+            return m_split[i * m_n + j];
+        }
+
+        /**
+         * Number of multiply-adds of the product of matrices [i, j] in the planned order.
+         */
+        double cost(const size_t i, const size_t j) const
+        {
+            return m_cost[i * m_n + j];
+        }
+
+        double cost() const
+        {
+            return cost(0, m_n - 1);
+        }
+
+        /**
+         * The planned order written out, e.g. "((A0 A1) A2)".
+         */
+        std::string parenthesization() const
+        {
+            return parenthesization(0, m_n - 1);
+        }
+
+        std::string parenthesization(const size_t i, const size_t j) const
+        {
+            if (i == j)
+            {
+                return "A" + std::to_string(i);
+            }
+            const size_t k = split(i, j);
+            return "(" + parenthesization(i, k) + " " + parenthesization(k + 1, j) + ")";
+        }
+
+    private:
+        size_t m_n;
+        std::vector<double> m_cost;
+        std::vector<size_t> m_split;
+    };
+
+    /**
+     * Evaluates a chain following a MatrixChainPlan. Intermediate results live in buffers recycled through a free
+     * list once consumed, so a chain of n matrices allocates far fewer than n - 1 buffers. The two sides of a split
+     * which are both products are evaluated concurrently.
+     *
+     * @tparam TData
+     */
+    template <typename TData>
+    class MatrixChainEvaluator
+    {
+    public:
+        MatrixChainEvaluator(const std::vector<const Matrix<TData> *> &chain, const MatrixChainPlan &plan): m_chain(chain), m_plan(plan) {}
+
+        Matrix<TData> evaluate()
+        {
+            if (m_chain.size() == 1)
+            {
+                return *m_chain[0];
+            }
+            Operand result = evaluate(0, m_chain.size() - 1);
+            result.buffer.resize(result.rows * result.cols);
+            return Matrix<TData>(result.rows, result.cols, std::move(result.buffer));
+        }
+
+    private:
+        // A matrix of the chain, referred to, or an intermediate product owning its buffer
+        struct Operand
+        {
+            MatrixBuffer<TData> buffer;
+            const TData *data;
+            size_t rows;
+            size_t cols;
+            size_t stride;
+        };
+
+        Operand evaluate(const size_t i, const size_t j)
+        {
+            if (i == j)
+            {
+                const Matrix<TData> &mat = *m_chain[i];
+                return Operand {MatrixBuffer<TData>(), mat.data(), mat.rows(), mat.cols(), mat.stride()};
+            }
+
+            const size_t k = m_plan.split(i, j);
+            Operand lhs, rhs;
+            if (n_threads > 1 && k > i && j > k + 1)
+            {
+                parallelFor(2, 2, [&](const size_t side)
+                {
+                    (side == 0 ? lhs : rhs) = (side == 0) ? evaluate(i, k) : evaluate(k + 1, j);
+                });
+            }
+            else
+            {
+                lhs = evaluate(i, k);
+                rhs = evaluate(k + 1, j);
+            }
+
+            MATRIX_LIBRARY_TRACE_SCOPE("multiply");
+            MATRIX_LIBRARY_COUNT(multiplications, 1);
+            MATRIX_LIBRARY_COUNT(flops, 2 * lhs.rows * lhs.cols * rhs.cols);
+            Operand r {acquire(lhs.rows * rhs.cols), nullptr, lhs.rows, rhs.cols, rhs.cols};
+            r.data = r.buffer.data();
+            gemmUpdate(lhs.rows, rhs.cols, lhs.cols, TData(1), lhs.data, lhs.stride, rhs.data, rhs.stride, r.buffer.data(), r.stride,
+                n_threads);
+            release(std::move(lhs.buffer));
+            release(std::move(rhs.buffer));
+            return r;
+        }
+
+        // Zeroed buffer of n elements, reusing the smallest free buffer with enough capacity
+        MatrixBuffer<TData> acquire(const size_t n)
+        {
+            MatrixBuffer<TData> buffer;
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                auto best = m_free.end();
+                for (auto it = m_free.begin(); it != m_free.end(); ++it)
+                {
+                    if (it->capacity() >= n && (best == m_free.end() || it->capacity() < best->capacity()))
+                    {
+                        best = it;
+                    }
+                }
+                if (best != m_free.end())
+                {
+                    buffer = std::move(*best);
+                    m_free.erase(best);
+                }
+            }
+            buffer.assign(n, TData(0));
+            return buffer;
+        }
+
+        void release(MatrixBuffer<TData> buffer)
+        {
+            if (buffer.capacity() == 0)
+            {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_free.push_back(std::move(buffer));
+        }
+
+        const std::vector<const Matrix<TData> *> &m_chain;
+        const MatrixChainPlan &m_plan;
+        std::mutex m_mtx;
+        std::vector<MatrixBuffer<TData>> m_free;
+    };
+
+    /**
+     * Product of a chain of matrices of the same datatype, in the order minimizing the number of multiply-adds
+     * according to their getDimensions(), rather than left to right.
+     *
+     * @param chain Pointers to the matrices, which must be non-null
+     * @throw std::invalid_argument if the chain is empty or its dimensions do not match
+     */
+    template <typename TData>
+    Matrix<TData> multiplyChain(const std::vector<const Matrix<TData> *> &chain)
+    {
+        std::vector<std::pair<size_t, size_t>> dims;
+        dims.reserve(chain.size());
+        for (const Matrix<TData> *mat : chain)
+        {
+            dims.push_back(mat->getDimensions());
+        }
+        const MatrixChainPlan plan(dims);
+        return MatrixChainEvaluator<TData>(chain, plan).evaluate();
+    }
+
+    /**
+     * Product of the matrices given, e.g. multiplyChain(A, B, C, D), see above.
+     */
+    template <typename TData, typename... TRest>
+    Matrix<TData> multiplyChain(const Matrix<TData> &first, const TRest &... rest)
+    {
+        return multiplyChain(std::vector<const Matrix<TData> *> {&first, &rest...});
+    }
+} // end namespace MatrixLibrary
+
+#endif // #ifndef MATRIX_CHAIN_HPP
@@ -0,0 +1,622 @@
+/**
+ * @file matrix_decompositions.hpp
+ * @author Alex Liu (alex.liuyining@outlook.com)
+ * @brief Blocked multithreaded LU, Cholesky and QR factorizations with solve, inverse, determinant and least squares
+ * @date 2021-12
+ */
+
+#ifndef MATRIX_DECOMPOSITIONS_HPP
+#define MATRIX_DECOMPOSITIONS_HPP
+
+#include <vector>
+#include <cmath>
+#include <utility>
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <type_traits>
+#include "instrumentation.hpp"
+#include "gemm_kernel.hpp"
+#include "concurrency_utils.hpp"
+#include "transpose_kernel.hpp"
+#include "matrix_library.hpp"
+#include "dense_vector.hpp"
+#include "structured_matrix.hpp"
+
+namespace MatrixLibrary
+{
+    /*
+     * The factorizations are right-looking and blocked: a panel of factorization_block cols is factored with
+     * vector kernels, then the trailing matrix is updated with a single product computed by gemmBlocked on the
+     * thread pool. Nearly all of the O(n^3) work is in those products.
+     */
+
+    // Width of the panels, large enough for the trailing updates to run near the speed of a square product
+    static constexpr size_t factorization_block = 64;
+
+    /**
+     * Solves T * x = b in place of x for the leading x.rows() x x.rows() triangle of t, by forward or back
+     * substitution on whole rows of x. The cols of x are split across threads.
+     *
+     * @param t Matrix whose given triangle holds the triangular factor, the other triangle is not read
+     * @param triangle
+     * @param unit_diagonal Whether the diagonal is taken to be one instead of read from t
+     * @param transposed Solve with the transpose of the triangle instead
+     * @param x Right-hand side, overwritten with the solution
+     * @throw std::runtime_error if an element of the diagonal is zero
+     */
+    template <typename TData>
+    void triangularSolveInPlace(const Matrix<TData> &t, const Triangle triangle, const bool unit_diagonal, const bool transposed,
+        Matrix<TData> &x)
+    {
+        const size_t n = x.rows();
+        assert(t.rows() >= n && t.cols() >= n && "Triangular factor must have at least as many rows and cols as the right-hand side has rows");
+        if (!unit_diagonal)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                if (t(i, i) == TData(0))
+                {
+                    throw std::runtime_error("Matrix is singular");
+                }
+            }
+        }
+
+        // Solving with the transpose of a lower triangle is a backward solve reading the rows of t, and vice versa
+        const bool forward = (triangle == Triangle::Lower) != transposed;
+        parallelRanges(x.cols(), n * n * x.cols() / 2, [&](const size_t begin, const size_t end)
+        {
+            const size_t width = end - begin;
+            auto x_row = [&](const size_t i) { return x.data() + i * x.stride() + begin; };
+            auto divide = [&](const size_t i)
+            {
+                if (!unit_diagonal)
+                {
+                    const TData inverse_diag = TData(1) / t(i, i);
+                    TData *row = x_row(i);
+                    for (size_t j = 0; j < width; ++j)
+                    {
+                        row[j] *= inverse_diag;
+                    }
+                }
+            };
+
+            for (size_t step = 0; step < n; ++step)
+            {
+                const size_t i = forward ? step : n - 1 - step;
+                if (!transposed)
+                {
+                    // x_i = (b_i - sum over the other stored cols k of row i of t(i, k) * x_k) / t(i, i)
+                    const size_t k_begin = forward ? 0 : i + 1, k_end = forward ? i : n;
+                    for (size_t k = k_begin; k < k_end; ++k)
+                    {
+                        axpyKernel(width, -t(i, k), x_row(k), x_row(i));
+                    }
+                    divide(i);
+                }
+                else
+                {
+                    // x_i is final once the earlier steps are done, row i of t then updates the remaining x_k
+                    divide(i);
+                    const size_t k_begin = forward ? i + 1 : 0, k_end = forward ? n : i;
+                    for (size_t k = k_begin; k < k_end; ++k)
+                    {
+                        axpyKernel(width, -t(i, k), x_row(i), x_row(k));
+                    }
+                }
+            }
+        });
+    }
+
+    template <typename TData>
+    Matrix<TData> identityDense(const size_t n)
+    {
+        Matrix<TData> r(n, n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            r(i, i) = TData(1);
+        }
+        return r;
+    }
+
+    /**
+     * LU factorization with partial pivoting P * A = L * U of a square matrix. L is unit lower triangular and
+     * stored below the diagonal of U. A singular matrix is factored without error, solve and inverse then throw
+     * and the determinant is zero.
+     *
+     * @tparam TData float or double
+     */
+    template <typename TData>
+    class LUDecomposition
+    {
+        static_assert(std::is_floating_point<TData>::value, "Factorizations require a floating point datatype");
+
+    public:
+        explicit LUDecomposition(const Matrix<TData> &mat): m_lu(mat), m_pivots(mat.rows()), m_sign(1)
+        {
+            assert(mat.rows() == mat.cols() && "Matrix must be square");
+            MATRIX_LIBRARY_TRACE_SCOPE("lu");
+            const size_t n = m_lu.rows(), ld = m_lu.stride();
+            TData *a = m_lu.data();
+
+            for (size_t kb = 0; kb < n; kb += factorization_block)
+            {
+                const size_t panel_end = std::min(n, kb + factorization_block);
+
+                // Factor the panel of cols [kb, panel_end), whole rows are swapped so that the pivots apply to L and A12
+                for (size_t j = kb; j < panel_end; ++j)
+                {
+                    size_t pivot = j;
+                    for (size_t i = j + 1; i < n; ++i)
+                    {
+                        if (std::abs(a[i * ld + j]) > std::abs(a[pivot * ld + j]))
+                        {
+                            pivot = i;
+                        }
+                    }
+                    m_pivots[j] = pivot;
+                    if (pivot != j)
+                    {
+                        std::swap_ranges(a + j * ld, a + j * ld + n, a + pivot * ld);
+                        m_sign = -m_sign;
+                    }
+                    const TData diag = a[j * ld + j];
+                    if (diag == TData(0))
+                    {
+                        continue;
+                    }
+                    for (size_t i = j + 1; i < n; ++i)
+                    {
+                        TData *row = a + i * ld;
+                        row[j] /= diag;
+                        axpyKernel(panel_end - j - 1, -row[j], a + j * ld + j + 1, row + j + 1);
+                    }
+                }
+
+                const size_t trailing = n - panel_end;
+                if (trailing == 0)
+                {
+                    break;
+                }
+
+                // A12 = L11^-1 * A12, then A22 -= L21 * A12
+                const size_t width = panel_end - kb;
+                parallelRanges(trailing, width * width * trailing / 2, [&](const size_t begin, const size_t end)
+                {
+                    for (size_t i = kb + 1; i < panel_end; ++i)
+                    {
+                        for (size_t k = kb; k < i; ++k)
+                        {
+                            axpyKernel(end - begin, -a[i * ld + k], a + k * ld + panel_end + begin, a + i * ld + panel_end + begin);
+                        }
+                    }
+                });
+                gemmUpdate(trailing, trailing, width, TData(-1), a + panel_end * ld + kb, ld, a + kb * ld + panel_end, ld,
+                    a + panel_end * ld + panel_end, ld, n_threads);
+            }
+        }
+
+        /**
+         * Solves A * x = b.
+         *  @throw std::runtime_error if the matrix is singular
+         */
+        Matrix<TData> solve(const Matrix<TData> &b) const
+        {
+            assert(b.rows() == m_lu.rows() && "Right-hand side must have as many rows as the matrix");
+            Matrix<TData> x(b);
+            for (size_t j = 0; j < m_pivots.size(); ++j)
+            {
+                if (m_pivots[j] != j)
+                {
+                    std::swap_ranges(x.data() + j * x.stride(), x.data() + j * x.stride() + x.cols(), x.data() + m_pivots[j] * x.stride());
+                }
+            }
+            triangularSolveInPlace(m_lu, Triangle::Lower, true, false, x);
+            triangularSolveInPlace(m_lu, Triangle::Upper, false, false, x);
+            return x;
+        }
+
+        /**
+         * @throw std::runtime_error if the matrix is singular
+         */
+        Matrix<TData> inverse() const
+        {
+            return solve(identityDense<TData>(m_lu.rows()));
+        }
+
+        TData determinant() const
+        {
+            TData det = TData(m_sign);
+            for (size_t i = 0; i < m_lu.rows(); ++i)
+            {
+                det *= m_lu(i, i);
+            }
+            return det;
+        }
+
+        /**
+         * The factors, L strictly below the diagonal and U on and above it.
+         */
+        const Matrix<TData> &matrixLU() const
+        {
+            return m_lu;
+        }
+
+        /**
+         * Row i was swapped with row pivots()[i] at step i of the factorization.
+         */
+        const std::vector<size_t> &pivots() const
+        {
+            return m_pivots;
+        }
+
+    private:
+        Matrix<TData> m_lu;
+        std::vector<size_t> m_pivots;
+        int m_sign;
+    };
+
+    /**
+     * Cholesky factorization A = L * L^T of a symmetric positive definite matrix, only the lower triangle of A is read.
+     *
+     * @tparam TData float or double
+     */
+    template <typename TData>
+    class CholeskyDecomposition
+    {
+        static_assert(std::is_floating_point<TData>::value, "Factorizations require a floating point datatype");
+
+    public:
+        /**
+         * @throw std::runtime_error if the matrix is not positive definite
+         */
+        explicit CholeskyDecomposition(const Matrix<TData> &mat): m_l(mat)
+        {
+            assert(mat.rows() == mat.cols() && "Matrix must be square");
+            MATRIX_LIBRARY_TRACE_SCOPE("cholesky");
+            const size_t n = m_l.rows(), ld = m_l.stride();
+            TData *a = m_l.data();
+
+            for (size_t kb = 0; kb < n; kb += factorization_block)
+            {
+                const size_t panel_end = std::min(n, kb + factorization_block);
+                const size_t width = panel_end - kb;
+
+                // L11 by the unblocked algorithm
+                for (size_t j = kb; j < panel_end; ++j)
+                {
+                    TData *row_j = a + j * ld;
+                    const TData d = row_j[j] - dotKernel(j - kb, row_j + kb, row_j + kb);
+                    if (!(d > TData(0)))
+                    {
+                        throw std::runtime_error("Matrix is not positive definite");
+                    }
+                    row_j[j] = std::sqrt(d);
+                    for (size_t i = j + 1; i < panel_end; ++i)
+                    {
+                        TData *row_i = a + i * ld;
+                        row_i[j] = (row_i[j] - dotKernel(j - kb, row_i + kb, row_j + kb)) / row_j[j];
+                    }
+                }
+                const size_t trailing = n - panel_end;
+                if (trailing == 0)
+                {
+                    break;
+                }
+
+                // L21 = A21 * L11^-T, solved as L11 * L21^T = A21^T so that the substitution runs along rows of length trailing
+                Matrix<TData> l21_t(width, trailing);
+                transposeMatrix(trailing, width, a + panel_end * ld + kb, ld, l21_t.data(), l21_t.stride(), n_threads);
+                parallelRanges(trailing, trailing * width * width / 2, [&](const size_t begin, const size_t end)
+                {
+                    for (size_t j = 0; j < width; ++j)
+                    {
+                        TData *row_j = l21_t.data() + j * l21_t.stride() + begin;
+                        const TData *l_row = a + (kb + j) * ld + kb;
+                        for (size_t k = 0; k < j; ++k)
+                        {
+                            axpyKernel(end - begin, -l_row[k], l21_t.data() + k * l21_t.stride() + begin, row_j);
+                        }
+                        const TData inverse_diag = TData(1) / l_row[j];
+                        for (size_t i = 0; i < end - begin; ++i)
+                        {
+                            row_j[i] *= inverse_diag;
+                        }
+                    }
+                });
+                transposeMatrix(width, trailing, l21_t.data(), l21_t.stride(), a + panel_end * ld + kb, ld, n_threads);
+
+                // A22 -= L21 * L21^T on the lower triangle only, by blocks of rows which each end at the diagonal
+                const size_t row_blocks = (trailing + factorization_block - 1) / factorization_block;
+                const size_t threads = (trailing * trailing * width < 2 * min_task_work) ? 1 : n_threads;
+                parallelFor(row_blocks, threads, [&](const size_t rb)
+                {
+                    const size_t row = rb * factorization_block;
+                    const size_t rows = std::min(factorization_block, trailing - row);
+                    gemmBlocked(rows, row + rows, width, TData(-1), a + (panel_end + row) * ld + kb, ld, l21_t.data(), l21_t.stride(),
+                        a + (panel_end + row) * ld + panel_end, ld);
+                });
+            }
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                std::fill(a + i * ld + i + 1, a + i * ld + n, TData(0));
+            }
+        }
+
+        Matrix<TData> solve(const Matrix<TData> &b) const
+        {
+            assert(b.rows() == m_l.rows() && "Right-hand side must have as many rows as the matrix");
+            Matrix<TData> x(b);
+            triangularSolveInPlace(m_l, Triangle::Lower, false, false, x);
+            triangularSolveInPlace(m_l, Triangle::Lower, false, true, x);
+            return x;
+        }
+
+        Matrix<TData> inverse() const
+        {
+            return solve(identityDense<TData>(m_l.rows()));
+        }
+
+        TData determinant() const
+        {
+            TData det = TData(1);
+            for (size_t i = 0; i < m_l.rows(); ++i)
+            {
+                det *= m_l(i, i) * m_l(i, i);
+            }
+            return det;
+        }
+
+        /**
+         * The lower triangular factor L, zero above the diagonal.
+         */
+        const Matrix<TData> &matrixL() const
+        {
+            return m_l;
+        }
+
+    private:
+        Matrix<TData> m_l;
+    };
+
+    /**
+     * Householder QR factorization A = Q * R of a rows x cols matrix with rows >= cols. The Householder vectors are
+     * stored below the diagonal of R. Each panel of reflectors is applied to the trailing matrix at once as
+     * I - V * T * V^T, which takes two products.
+     *
+     * @tparam TData float or double
+     */
+    template <typename TData>
+    class QRDecomposition
+    {
+        static_assert(std::is_floating_point<TData>::value, "Factorizations require a floating point datatype");
+
+    public:
+        explicit QRDecomposition(const Matrix<TData> &mat): m_qr(mat), m_tau(mat.cols(), TData(0))
+        {
+            assert(mat.rows() >= mat.cols() && "Matrix must have at least as many rows as cols");
+            MATRIX_LIBRARY_TRACE_SCOPE("qr");
+            const size_t m = m_qr.rows(), n = m_qr.cols(), ld = m_qr.stride();
+            TData *a = m_qr.data();
+            std::vector<TData> w(factorization_block);
+
+            for (size_t kb = 0; kb < n; kb += factorization_block)
+            {
+                const size_t panel_end = std::min(n, kb + factorization_block);
+                const size_t width = panel_end - kb;
+
+                for (size_t j = kb; j < panel_end; ++j)
+                {
+                    makeReflector(j);
+                    const TData tau = m_tau[j];
+                    const size_t length = panel_end - j - 1;
+                    if (tau == TData(0) || length == 0)
+                    {
+                        continue;
+                    }
+
+                    // Apply H_j = I - tau * v * v^T to the rest of the panel, w = v^T * A with v_j = 1
+                    std::copy(a + j * ld + j + 1, a + j * ld + panel_end, w.begin());
+                    for (size_t i = j + 1; i < m; ++i)
+                    {
+                        axpyKernel(length, a[i * ld + j], a + i * ld + j + 1, w.data());
+                    }
+                    axpyKernel(length, -tau, w.data(), a + j * ld + j + 1);
+                    for (size_t i = j + 1; i < m; ++i)
+                    {
+                        axpyKernel(length, -tau * a[i * ld + j], w.data(), a + i * ld + j + 1);
+                    }
+                }
+
+                const size_t trailing = n - panel_end;
+                if (trailing == 0)
+                {
+                    break;
+                }
+
+                // V is unit lower trapezoidal, the triangular T is built column by column as in LAPACK's larft
+                const size_t panel_rows = m - kb;
+                Matrix<TData> v(panel_rows, width), v_t(width, panel_rows), t(width, width);
+                for (size_t r = 0; r < panel_rows; ++r)
+                {
+                    for (size_t c = 0; c < std::min(width, r + 1); ++c)
+                    {
+                        v(r, c) = (r == c) ? TData(1) : a[(kb + r) * ld + kb + c];
+                    }
+                }
+                transposeMatrix(panel_rows, width, v.data(), v.stride(), v_t.data(), v_t.stride(), 1);
+                for (size_t i = 0; i < width; ++i)
+                {
+                    const TData tau = m_tau[kb + i];
+                    t(i, i) = tau;
+                    std::vector<TData> column(i);
+                    for (size_t c = 0; c < i; ++c)
+                    {
+                        column[c] = -tau * dotKernel(panel_rows, v_t.data() + c * v_t.stride(), v_t.data() + i * v_t.stride());
+                    }
+                    for (size_t r = 0; r < i; ++r)
+                    {
+                        t(r, i) = dotKernel(i - r, &t(r, r), column.data() + r);
+                    }
+                }
+
+                // A2 -= V * (T^T * (V^T * A2))
+                Matrix<TData> vt_a(width, trailing), update(width, trailing);
+                gemmUpdate(width, trailing, panel_rows, TData(1), v_t.data(), v_t.stride(), a + kb * ld + panel_end, ld,
+                    vt_a.data(), vt_a.stride(), n_threads);
+                for (size_t i = 0; i < width; ++i)
+                {
+                    for (size_t c = 0; c <= i; ++c)
+                    {
+                        axpyKernel(trailing, t(c, i), vt_a.data() + c * vt_a.stride(), update.data() + i * update.stride());
+                    }
+                }
+                gemmUpdate(panel_rows, trailing, width, TData(-1), v.data(), v.stride(), update.data(), update.stride(),
+                    a + kb * ld + panel_end, ld, n_threads);
+            }
+        }
+
+        /**
+         * Least squares solution x minimizing ||A * x - b||, the solution of A * x = b for a square matrix.
+         *  @throw std::runtime_error if the matrix is rank deficient
+         */
+        Matrix<TData> solve(const Matrix<TData> &b) const
+        {
+            assert(b.rows() == m_qr.rows() && "Right-hand side must have as many rows as the matrix");
+            Matrix<TData> y(b);
+            for (size_t j = 0; j < m_qr.cols(); ++j)
+            {
+                applyReflector(j, y);
+            }
+            Matrix<TData> x(m_qr.cols(), y.cols());
+            for (size_t i = 0; i < x.rows(); ++i)
+            {
+                std::copy(y.data() + i * y.stride(), y.data() + i * y.stride() + y.cols(), x.data() + i * x.stride());
+            }
+            triangularSolveInPlace(m_qr, Triangle::Upper, false, false, x);
+            return x;
+        }
+
+        /**
+         * The cols x cols upper triangular factor R.
+         */
+        Matrix<TData> matrixR() const
+        {
+            Matrix<TData> r(m_qr.cols(), m_qr.cols());
+            for (size_t i = 0; i < r.rows(); ++i)
+            {
+                std::copy(&m_qr(i, i), &m_qr(i, 0) + r.cols(), &r(i, i));
+            }
+            return r;
+        }
+
+        /**
+         * The rows x cols factor Q with orthonormal cols, formed by applying the reflectors to the leading cols of
+         * the identity.
+         */
+        Matrix<TData> matrixQ() const
+        {
+            Matrix<TData> q(m_qr.rows(), m_qr.cols());
+            for (size_t i = 0; i < q.cols(); ++i)
+            {
+                q(i, i) = TData(1);
+            }
+            for (size_t j = m_qr.cols(); j-- > 0;)
+            {
+                applyReflector(j, q);
+            }
+            return q;
+        }
+
+    private:
+        // Householder reflector zeroing col j below the diagonal, LAPACK's larfg
+        void makeReflector(const size_t j)
+        {
+            const size_t m = m_qr.rows(), ld = m_qr.stride();
+            TData *a = m_qr.data();
+            TData sigma = TData(0);
+            for (size_t i = j + 1; i < m; ++i)
+            {
+                sigma += a[i * ld + j] * a[i * ld + j];
+            }
+            const TData x0 = a[j * ld + j];
+            if (sigma == TData(0))
+            {
+                m_tau[j] = TData(0);
+                return;
+            }
+            const TData norm = std::sqrt(x0 * x0 + sigma);
+            const TData beta = (x0 >= TData(0)) ? -norm : norm;
+            m_tau[j] = (beta - x0) / beta;
+            const TData scale = TData(1) / (x0 - beta);
+            for (size_t i = j + 1; i < m; ++i)
+            {
+                a[i * ld + j] *= scale;
+            }
+            a[j * ld + j] = beta;
+        }
+
+        // y = H_j * y, on rows [j, rows) of y
+        void applyReflector(const size_t j, Matrix<TData> &y) const
+        {
+            const TData tau = m_tau[j];
+            if (tau == TData(0))
+            {
+                return;
+            }
+            const size_t cols = y.cols();
+            std::vector<TData> w(y.data() + j * y.stride(), y.data() + j * y.stride() + cols);
+            for (size_t i = j + 1; i < m_qr.rows(); ++i)
+            {
+                axpyKernel(cols, m_qr(i, j), y.data() + i * y.stride(), w.data());
+            }
+            axpyKernel(cols, -tau, w.data(), y.data() + j * y.stride());
+            for (size_t i = j + 1; i < m_qr.rows(); ++i)
+            {
+                axpyKernel(cols, -tau * m_qr(i, j), w.data(), y.data() + i * y.stride());
+            }
+        }
+
+        Matrix<TData> m_qr;
+        std::vector<TData> m_tau;
+    };
+
+    /**
+     * Solves the square system A * x = b with an LU factorization.
+     *  @throw std::runtime_error if A is singular
+     */
+    template <typename TData>
+    Matrix<TData> solve(const Matrix<TData> &A, const Matrix<TData> &b)
+    {
+        return LUDecomposition<TData>(A).solve(b);
+    }
+
+    /**
+     * Inverse of a square matrix computed with an LU factorization. Prefer solve when the inverse is only multiplied with.
+     *  @throw std::runtime_error if A is singular
+     */
+    template <typename TData>
+    Matrix<TData> inverse(const Matrix<TData> &A)
+    {
+        return LUDecomposition<TData>(A).inverse();
+    }
+
+    template <typename TData>
+    TData determinant(const Matrix<TData> &A)
+    {
+        return LUDecomposition<TData>(A).determinant();
+    }
+
+    /**
+     * Least squares solution x minimizing ||A * x - b|| for A with at least as many rows as cols, with a QR factorization.
+     *  @throw std::runtime_error if A is rank deficient
+     */
+    template <typename TData>
+    Matrix<TData> leastSquares(const Matrix<TData> &A, const Matrix<TData> &b)
+    {
+        return QRDecomposition<TData>(A).solve(b);
+    }
+} // end namespace MatrixLibrary
+
+#endif // #ifndef MATRIX_DECOMPOSITIONS_HPP
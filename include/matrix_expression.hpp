@@ -0,0 +1,570 @@
+/**
+ * @file matrix_expression.hpp
+ * @author Alex Liu (alex.liuyining@outlook.com)
+ * @brief Expression templates for lazy, fused evaluation of element-wise Matrix arithmetic
+ * @date 2021-12
+ */
+
+#ifndef MATRIX_EXPRESSION_HPP
+#define MATRIX_EXPRESSION_HPP
+
+#include <cassert>
+#include <utility>
+#include <functional>
+#include <type_traits>
+#include <memory>
+#include "simd_kernels.hpp"
+
+namespace MatrixLibrary
+{
+    template <typename TData>
+    class Matrix;
+
+    /**
+     * Base class of everything that can appear in a Matrix expression, using the curiously recurring template pattern.
+     * A derived expression provides rows(), cols(), coeff(i, j) and the aliasing queries used on assignment.
+     * Expressions are evaluated once they are assigned to a Matrix, or explicitly through eval().
+     *
+     * @tparam TDerived The concrete expression type
+     */
+    template <typename TDerived>
+    class MatrixExpr
+    {
+    public:
+        const TDerived &derived() const
+        {
+            return static_cast<const TDerived &>(*this);
+        }
+
+        /**
+         * Evaluates the expression into a new Matrix.
+         *
+         * @return Matrix holding the result
+         */
+        auto eval() const
+        {
+            return Matrix<typename TDerived::value_type>(derived());
+        }
+
+        /**
+         * Getter for the dimensions of the expression, returned as a pair in the form of rows, cols
+         *
+         * @return std::pair <size_t, size_t>
+         */
+        std::pair<size_t, size_t> getDimensions() const
+        {
+            return std::make_pair(derived().rows(), derived().cols());
+        }
+
+        /**
+         * Evaluates the expression and returns its data as a vector of vectors.
+         */
+        const auto getData() const
+        {
+            return eval().getData();
+        }
+
+        /**
+         * Evaluates the expression and prints the result.
+         *
+         * @param p the number of decimals to display in case the data is floating point, default p = 2
+         */
+        void printData(int p = 2) const
+        {
+            eval().printData(p);
+        }
+
+        /**
+         * Lazy transpose of the expression, no data is moved until the result is assigned.
+         * Use Matrix::transpose() to compute a transposed copy directly.
+         */
+        auto transposed() const &;
+        auto transposed() &&;
+
+        /**
+         * Lazy conversion of every element to another datatype, e.g. to combine an integer Matrix with a narrower one
+         * into a narrower result, which implicit promotion does not allow.
+         *
+         * @tparam TTarget
+         */
+        template <typename TTarget>
+        auto cast() const &;
+        template <typename TTarget>
+        auto cast() &&;
+
+    protected:
+        MatrixExpr() = default;
+    };
+
+    /**
+     * How an operand is held inside an expression node: temporaries of expression nodes are small and held by value,
+     * while Matrix operands are held by reference and must outlive the expression. Temporary Matrix operands, e.g.
+     * the product in (A * B) + C, are moved into an OwnedMatrix instead, see below.
+     */
+    template <typename TExpr>
+    struct ExprNested
+    {
+        using type = const TExpr;
+    };
+
+    template <typename TData>
+    struct ExprNested<Matrix<TData>>
+    {
+        using type = const Matrix<TData> &;
+    };
+
+    /**
+     * Datatype of the result of an operation between expressions of datatypes TLhs and TRhs, following the usual
+     * arithmetic conversions except that operands of the same type keep it, e.g. int and double give double while
+     * short and short give short.
+     */
+    template <typename TLhs, typename TRhs>
+    using PromotedType = typename std::common_type<TLhs, TRhs>::type;
+
+    // Whether values of TFrom can be stored into TTo implicitly, i.e. TTo is what the two promote to
+    template <typename TFrom, typename TTo>
+    struct IsPromotable : std::is_same<PromotedType<TFrom, TTo>, TTo>
+    {
+    };
+
+    /**
+     * Element-wise binary operation between two expressions of the same dimensions. Operands of different datatypes
+     * are promoted to their PromotedType.
+     */
+    template <typename TLhs, typename TRhs, typename TOp>
+    class BinaryExpr : public MatrixExpr<BinaryExpr<TLhs, TRhs, TOp>>
+    {
+    public:
+        using value_type = PromotedType<typename TLhs::value_type, typename TRhs::value_type>;
+
+        BinaryExpr(const TLhs &lhs, const TRhs &rhs, TOp op = TOp()) : m_lhs(lhs), m_rhs(rhs), m_op(op)
+        {
+            assert(lhs.rows() == rhs.rows() && lhs.cols() == rhs.cols() && "Two matrices must have the same dimensions");
+        }
+
+        size_t rows() const { return m_lhs.rows(); }
+        size_t cols() const { return m_lhs.cols(); }
+
+        value_type coeff(const size_t i, const size_t j) const
+        {
+            return m_op(m_lhs.coeff(i, j), m_rhs.coeff(i, j));
+        }
+
+        bool aliases(const void *begin, const void *end) const
+        {
+            return m_lhs.aliases(begin, end) || m_rhs.aliases(begin, end);
+        }
+
+        bool transposeAliases(const void *begin, const void *end) const
+        {
+            return m_lhs.transposeAliases(begin, end) || m_rhs.transposeAliases(begin, end);
+        }
+
+    private:
+        typename ExprNested<TLhs>::type m_lhs;
+        typename ExprNested<TRhs>::type m_rhs;
+        TOp m_op;
+    };
+
+    /**
+     * Element-wise unary operation, e.g. negation or an operation with a scalar bound to one side.
+     */
+    template <typename TExpr, typename TOp>
+    class UnaryExpr : public MatrixExpr<UnaryExpr<TExpr, TOp>>
+    {
+    public:
+        using value_type = typename std::decay<decltype(std::declval<const TOp &>()(std::declval<typename TExpr::value_type>()))>::type;
+
+        UnaryExpr(const TExpr &expr, TOp op) : m_expr(expr), m_op(op) {}
+
+        size_t rows() const { return m_expr.rows(); }
+        size_t cols() const { return m_expr.cols(); }
+
+        value_type coeff(const size_t i, const size_t j) const
+        {
+            return m_op(m_expr.coeff(i, j));
+        }
+
+        bool aliases(const void *begin, const void *end) const
+        {
+            return m_expr.aliases(begin, end);
+        }
+
+        bool transposeAliases(const void *begin, const void *end) const
+        {
+            return m_expr.transposeAliases(begin, end);
+        }
+
+    private:
+        typename ExprNested<TExpr>::type m_expr;
+        TOp m_op;
+    };
+
+    /**
+     * Lazy transpose, element (i, j) reads element (j, i) of the operand.
+     */
+    template <typename TExpr>
+    class TransposeExpr : public MatrixExpr<TransposeExpr<TExpr>>
+    {
+    public:
+        using value_type = typename TExpr::value_type;
+
+        explicit TransposeExpr(const TExpr &expr) : m_expr(expr) {}
+
+        size_t rows() const { return m_expr.cols(); }
+        size_t cols() const { return m_expr.rows(); }
+
+        value_type coeff(const size_t i, const size_t j) const
+        {
+            return m_expr.coeff(j, i);
+        }
+
+        bool aliases(const void *begin, const void *end) const
+        {
+            return m_expr.aliases(begin, end);
+        }
+
+        // Element (i, j) depends on element (j, i) of the operand, so writing into an operand in place is unsafe
+        bool transposeAliases(const void *begin, const void *end) const
+        {
+            return m_expr.aliases(begin, end);
+        }
+
+    private:
+        typename ExprNested<TExpr>::type m_expr;
+    };
+
+
+    /**
+     * Lazy conversion, element (i, j) is element (i, j) of the operand converted to TTarget.
+     */
+    template <typename TExpr, typename TTarget>
+    class CastExpr : public MatrixExpr<CastExpr<TExpr, TTarget>>
+    {
+    public:
+        using value_type = TTarget;
+
+        explicit CastExpr(const TExpr &expr) : m_expr(expr) {}
+
+        size_t rows() const { return m_expr.rows(); }
+        size_t cols() const { return m_expr.cols(); }
+
+        value_type coeff(const size_t i, const size_t j) const
+        {
+            return static_cast<TTarget>(m_expr.coeff(i, j));
+        }
+
+        bool aliases(const void *begin, const void *end) const
+        {
+            return m_expr.aliases(begin, end);
+        }
+
+        bool transposeAliases(const void *begin, const void *end) const
+        {
+            return m_expr.transposeAliases(begin, end);
+        }
+
+    private:
+        typename ExprNested<TExpr>::type m_expr;
+    };
+
+    /**
+     * Operand of an expression owning a Matrix which was a temporary, so that the expression stays valid once the
+     * full-expression creating it has ended, e.g. in auto e = (A * B) + C. The Matrix is moved, not copied, and is
+     * shared between the copies of the expression.
+     */
+    template <typename TData>
+    class OwnedMatrix : public MatrixExpr<OwnedMatrix<TData>>
+    {
+    public:
+        using value_type = TData;
+
+        explicit OwnedMatrix(Matrix<TData> &&mat) : m_mat(std::make_shared<const Matrix<TData>>(std::move(mat))),
+            m_data(m_mat->data()), m_rows(m_mat->rows()), m_cols(m_mat->cols()), m_stride(m_mat->stride())
+        {
+        }
+
+        size_t rows() const { return m_rows; }
+        size_t cols() const { return m_cols; }
+
+        TData coeff(const size_t i, const size_t j) const
+        {
+            return m_data[i * m_stride + j];
+        }
+
+        bool aliases(const void *begin, const void *end) const
+        {
+            return m_mat->aliases(begin, end);
+        }
+
+        bool transposeAliases(const void *, const void *) const
+        {
+            return false;
+        }
+
+    private:
+        std::shared_ptr<const Matrix<TData>> m_mat;
+        const TData *m_data;
+        size_t m_rows;
+        size_t m_cols;
+        size_t m_stride;
+    };
+
+    // Operand of a node built from an expression which is about to be destroyed, temporary matrices are moved into an OwnedMatrix
+    template <typename TExpr>
+    const TExpr &ownedOperand(const TExpr &expr)
+    {
+        return expr;
+    }
+
+    template <typename TData>
+    OwnedMatrix<TData> ownedOperand(Matrix<TData> &&mat)
+    {
+        return OwnedMatrix<TData>(std::move(mat));
+    }
+
+    template <typename TExpr>
+    using OwnedOperandType = typename std::decay<decltype(ownedOperand(std::declval<TExpr>()))>::type;
+
+    template <typename TDerived>
+    auto MatrixExpr<TDerived>::transposed() const &
+    {
+        return TransposeExpr<TDerived>(derived());
+    }
+
+    template <typename TDerived>
+    auto MatrixExpr<TDerived>::transposed() &&
+    {
+        return TransposeExpr<OwnedOperandType<TDerived>>(ownedOperand(std::move(static_cast<TDerived &>(*this))));
+    }
+
+    template <typename TDerived>
+    template <typename TTarget>
+    auto MatrixExpr<TDerived>::cast() const &
+    {
+        return CastExpr<TDerived, TTarget>(derived());
+    }
+
+    template <typename TDerived>
+    template <typename TTarget>
+    auto MatrixExpr<TDerived>::cast() &&
+    {
+        return CastExpr<OwnedOperandType<TDerived>, TTarget>(ownedOperand(std::move(static_cast<TDerived &>(*this))));
+    }
+
+    template <typename TData>
+    struct ScaleOp
+    {
+        TData scalar;
+        TData operator()(const TData value) const { return value * scalar; }
+    };
+
+    template <typename TData>
+    struct DivideOp
+    {
+        TData scalar;
+        TData operator()(const TData value) const { return value / scalar; }
+    };
+
+    /*
+     * Assignment policies used when evaluating an expression into a destination buffer.
+     */
+
+    struct AssignOp
+    {
+        template <typename TData, typename TValue>
+        void operator()(TData &dst, const TValue value) const { dst = static_cast<TData>(value); }
+    };
+
+    struct AddAssignOp
+    {
+        template <typename TData, typename TValue>
+        void operator()(TData &dst, const TValue value) const { dst += static_cast<TData>(value); }
+    };
+
+    struct SubtractAssignOp
+    {
+        template <typename TData, typename TValue>
+        void operator()(TData &dst, const TValue value) const { dst -= static_cast<TData>(value); }
+    };
+
+    /**
+     * Single fused loop over a range of rows of the destination. It is force inlined into the target specific wrappers
+     * below, so that the compiler vectorizes the whole expression with the instruction set of each wrapper.
+     */
+    template <typename TExpr, typename TData, typename TAssign>
+    MATRIX_LIBRARY_ALWAYS_INLINE inline void evaluateRowsLoop(const TExpr &expr, TData *dst, const size_t ld, const size_t row_begin,
+        const size_t row_end, TAssign assign)
+    {
+        const size_t cols = expr.cols();
+        for (size_t i = row_begin; i < row_end; ++i)
+        {
+            TData *dst_row = dst + i * ld;
+            for (size_t j = 0; j < cols; ++j)
+            {
+                assign(dst_row[j], expr.coeff(i, j));
+            }
+        }
+    }
+
+#if MATRIX_LIBRARY_X86_SIMD
+    template <typename TExpr, typename TData, typename TAssign>
+    MATRIX_LIBRARY_TARGET("avx2")
+    void evaluateRowsAvx2(const TExpr &expr, TData *dst, const size_t ld, const size_t row_begin, const size_t row_end, TAssign assign)
+    {
+        evaluateRowsLoop(expr, dst, ld, row_begin, row_end, assign);
+    }
+
+    template <typename TExpr, typename TData, typename TAssign>
+    MATRIX_LIBRARY_TARGET("avx512f")
+    void evaluateRowsAvx512(const TExpr &expr, TData *dst, const size_t ld, const size_t row_begin, const size_t row_end, TAssign assign)
+    {
+        evaluateRowsLoop(expr, dst, ld, row_begin, row_end, assign);
+    }
+#endif
+
+    /**
+     * Evaluates rows [row_begin, row_end) of an expression into a row-major destination buffer in one pass,
+     * dispatched on the instruction set level of the host. The caller is responsible for aliasing checks.
+     *
+     * @param expr
+     * @param dst
+     * @param ld Row stride of dst
+     * @param row_begin
+     * @param row_end
+     * @param assign Assignment policy, e.g. AssignOp or AddAssignOp
+     */
+    template <typename TExpr, typename TData, typename TAssign>
+    void evaluateRows(const TExpr &expr, TData *dst, const size_t ld, const size_t row_begin, const size_t row_end, TAssign assign)
+    {
+#if MATRIX_LIBRARY_X86_SIMD
+        switch (simd_level)
+        {
+        case SimdLevel::AVX512:
+            evaluateRowsAvx512(expr, dst, ld, row_begin, row_end, assign);
+            return;
+        case SimdLevel::AVX2:
+            evaluateRowsAvx2(expr, dst, ld, row_begin, row_end, assign);
+            return;
+        default:
+            break;
+        }
+#endif
+        evaluateRowsLoop(expr, dst, ld, row_begin, row_end, assign);
+    }
+
+    /*
+     * Arithmetic operators building expressions. Operands of different datatypes are promoted to their PromotedType.
+     */
+
+    template <typename TLhs, typename TRhs>
+    using PromotedExprType = PromotedType<typename TLhs::value_type, typename TRhs::value_type>;
+
+    template <typename TLhs, typename TRhs>
+    BinaryExpr<TLhs, TRhs, std::plus<PromotedExprType<TLhs, TRhs>>> operator+(const MatrixExpr<TLhs> &lhs, const MatrixExpr<TRhs> &rhs)
+    {
+        return BinaryExpr<TLhs, TRhs, std::plus<PromotedExprType<TLhs, TRhs>>>(lhs.derived(), rhs.derived());
+    }
+
+    template <typename TLhs, typename TRhs>
+    BinaryExpr<TLhs, TRhs, std::minus<PromotedExprType<TLhs, TRhs>>> operator-(const MatrixExpr<TLhs> &lhs, const MatrixExpr<TRhs> &rhs)
+    {
+        return BinaryExpr<TLhs, TRhs, std::minus<PromotedExprType<TLhs, TRhs>>>(lhs.derived(), rhs.derived());
+    }
+
+    template <typename TExpr>
+    UnaryExpr<TExpr, std::negate<typename TExpr::value_type>> operator-(const MatrixExpr<TExpr> &expr)
+    {
+        return UnaryExpr<TExpr, std::negate<typename TExpr::value_type>>(expr.derived(), std::negate<typename TExpr::value_type>());
+    }
+
+    // Operations with a scalar promote like those between matrices, e.g. a Matrix<int> times 2.5 gives doubles
+    template <typename TExpr, typename TScalar>
+    using PromotedScalarType = PromotedType<typename TExpr::value_type, TScalar>;
+
+    template <typename TExpr, typename TScalar, typename = typename std::enable_if<std::is_arithmetic<TScalar>::value>::type>
+    UnaryExpr<TExpr, ScaleOp<PromotedScalarType<TExpr, TScalar>>> operator*(const MatrixExpr<TExpr> &expr, const TScalar scalar)
+    {
+        using TResult = PromotedScalarType<TExpr, TScalar>;
+        return UnaryExpr<TExpr, ScaleOp<TResult>>(expr.derived(), ScaleOp<TResult>{(TResult)scalar});
+    }
+
+    template <typename TExpr, typename TScalar, typename = typename std::enable_if<std::is_arithmetic<TScalar>::value>::type>
+    UnaryExpr<TExpr, ScaleOp<PromotedScalarType<TExpr, TScalar>>> operator*(const TScalar scalar, const MatrixExpr<TExpr> &expr)
+    {
+        return expr * scalar;
+    }
+
+    template <typename TExpr, typename TScalar, typename = typename std::enable_if<std::is_arithmetic<TScalar>::value>::type>
+    UnaryExpr<TExpr, DivideOp<PromotedScalarType<TExpr, TScalar>>> operator/(const MatrixExpr<TExpr> &expr, const TScalar scalar)
+    {
+        using TResult = PromotedScalarType<TExpr, TScalar>;
+        return UnaryExpr<TExpr, DivideOp<TResult>>(expr.derived(), DivideOp<TResult>{(TResult)scalar});
+    }
+
+    /*
+     * Overloads for temporary Matrix operands, which are moved into the expression rather than referred to.
+     */
+
+    template <typename TData, typename TRhs>
+    auto operator+(Matrix<TData> &&lhs, const MatrixExpr<TRhs> &rhs)
+    {
+        return OwnedMatrix<TData>(std::move(lhs)) + rhs;
+    }
+
+    template <typename TLhs, typename TData>
+    auto operator+(const MatrixExpr<TLhs> &lhs, Matrix<TData> &&rhs)
+    {
+        return lhs + OwnedMatrix<TData>(std::move(rhs));
+    }
+
+    template <typename TLhsData, typename TRhsData>
+    auto operator+(Matrix<TLhsData> &&lhs, Matrix<TRhsData> &&rhs)
+    {
+        return OwnedMatrix<TLhsData>(std::move(lhs)) + OwnedMatrix<TRhsData>(std::move(rhs));
+    }
+
+    template <typename TData, typename TRhs>
+    auto operator-(Matrix<TData> &&lhs, const MatrixExpr<TRhs> &rhs)
+    {
+        return OwnedMatrix<TData>(std::move(lhs)) - rhs;
+    }
+
+    template <typename TLhs, typename TData>
+    auto operator-(const MatrixExpr<TLhs> &lhs, Matrix<TData> &&rhs)
+    {
+        return lhs - OwnedMatrix<TData>(std::move(rhs));
+    }
+
+    template <typename TLhsData, typename TRhsData>
+    auto operator-(Matrix<TLhsData> &&lhs, Matrix<TRhsData> &&rhs)
+    {
+        return OwnedMatrix<TLhsData>(std::move(lhs)) - OwnedMatrix<TRhsData>(std::move(rhs));
+    }
+
+    template <typename TData>
+    auto operator-(Matrix<TData> &&mat)
+    {
+        return -OwnedMatrix<TData>(std::move(mat));
+    }
+
+    template <typename TData, typename TScalar, typename = typename std::enable_if<std::is_arithmetic<TScalar>::value>::type>
+    auto operator*(Matrix<TData> &&mat, const TScalar scalar)
+    {
+        return OwnedMatrix<TData>(std::move(mat)) * scalar;
+    }
+
+    template <typename TData, typename TScalar, typename = typename std::enable_if<std::is_arithmetic<TScalar>::value>::type>
+    auto operator*(const TScalar scalar, Matrix<TData> &&mat)
+    {
+        return OwnedMatrix<TData>(std::move(mat)) * scalar;
+    }
+
+    template <typename TData, typename TScalar, typename = typename std::enable_if<std::is_arithmetic<TScalar>::value>::type>
+    auto operator/(Matrix<TData> &&mat, const TScalar scalar)
+    {
+        return OwnedMatrix<TData>(std::move(mat)) / scalar;
+    }
+} // end namespace MatrixLibrary
+
+#endif // #ifndef MATRIX_EXPRESSION_HPP
@@ -0,0 +1,439 @@
+/**
+ * @file matrix_io.hpp
+ * @author Alex Liu (alex.liuyining@outlook.com)
+ * @brief Binary on-disk matrix format, with streaming saves and zero-copy memory-mapped loading
+ * @date 2021-12
+ */
+
+#ifndef MATRIX_IO_HPP
+#define MATRIX_IO_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include "matrix_library.hpp"
+#include "matrix_view.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MATRIX_LIBRARY_HAS_MMAP 1
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#define MATRIX_LIBRARY_HAS_MMAP 0
+#endif
+
+namespace MatrixLibrary
+{
+    /*
+     * File layout: a 64 byte header followed by rows * stride elements in row-major order, starting at data_offset.
+     * The header fields are stored in the byte order given by its endianness field. The data offset is a multiple of 64
+     * so that mapped data is aligned for SIMD loads.
+     */
+
+    enum class DataType : uint8_t
+    {
+        Int16 = 1,
+        Int32 = 2,
+        Int64 = 3,
+        Float32 = 4,
+        Float64 = 5
+    };
+
+    enum class Endianness : uint8_t
+    {
+        Little = 1,
+        Big = 2
+    };
+
+    template <typename TData>
+    struct DataTypeOf;
+
+    template <> struct DataTypeOf<short> { static constexpr DataType value = DataType::Int16; };
+    template <> struct DataTypeOf<int> { static constexpr DataType value = DataType::Int32; };
+    template <> struct DataTypeOf<long> { static constexpr DataType value = sizeof(long) == 8 ? DataType::Int64 : DataType::Int32; };
+    template <> struct DataTypeOf<float> { static constexpr DataType value = DataType::Float32; };
+    template <> struct DataTypeOf<double> { static constexpr DataType value = DataType::Float64; };
+
+    inline Endianness hostEndianness()
+    {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        return Endianness::Big;
+#else
+        return Endianness::Little;
+#endif
+    }
+
+    struct MatrixFileHeader
+    {
+        char magic[4];
+        uint8_t version;
+        Endianness endianness;
+        DataType dtype;
+        uint8_t element_size;
+        uint64_t rows;
+        uint64_t cols;
+        uint64_t stride;
+        uint64_t data_offset;
+        uint8_t reserved[24];
+    };
+    static_assert(sizeof(MatrixFileHeader) == 64, "The file header must be 64 bytes");
+
+    static constexpr char matrix_file_magic[4] = {'M', 'T', 'X', 'L'};
+    static constexpr uint8_t matrix_file_version = 1;
+
+    template <typename TValue>
+    TValue byteSwap(TValue value)
+    {
+        unsigned char bytes[sizeof(TValue)];
+        std::memcpy(bytes, &value, sizeof(TValue));
+        std::reverse(bytes, bytes + sizeof(TValue));
+        std::memcpy(&value, bytes, sizeof(TValue));
+        return value;
+    }
+
+    /**
+     * Reads and validates the header of a matrix file, converting its fields to the host byte order.
+     *
+     * @param path
+     * @return MatrixFileHeader
+     * @throw std::runtime_error if the file cannot be read or is not a matrix file
+     */
+    inline MatrixFileHeader readMatrixHeader(const std::string &path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        MatrixFileHeader header;
+        if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)))
+        {
+            throw std::runtime_error("Could not read the header of " + path);
+        }
+        if (std::memcmp(header.magic, matrix_file_magic, sizeof(matrix_file_magic)) != 0 || header.version != matrix_file_version
+            || (header.endianness != Endianness::Little && header.endianness != Endianness::Big))
+        {
+            throw std::runtime_error(path + " is not a matrix file");
+        }
+        if (header.endianness != hostEndianness())
+        {
+            header.rows = byteSwap(header.rows);
+            header.cols = byteSwap(header.cols);
+            header.stride = byteSwap(header.stride);
+            header.data_offset = byteSwap(header.data_offset);
+        }
+        if (header.stride < header.cols || header.data_offset < sizeof(MatrixFileHeader))
+        {
+            throw std::runtime_error(path + " has an invalid header");
+        }
+        return header;
+    }
+
+    // a * b, or false if it does not fit in a size_t
+    inline bool checkedMultiply(const uint64_t a, const uint64_t b, size_t &result)
+    {
+        if (a != 0 && b > SIZE_MAX / a)
+        {
+            return false;
+        }
+        result = (size_t)(a * b);
+        return true;
+    }
+
+    // a + b, or false if it does not fit in a size_t
+    inline bool checkedAdd(const uint64_t a, const uint64_t b, size_t &result)
+    {
+        if (a > SIZE_MAX || b > SIZE_MAX - a)
+        {
+            return false;
+        }
+        result = (size_t)(a + b);
+        return true;
+    }
+
+    /**
+     * Checks that a header holds TData, that its data is aligned for TData and that the size of the file it
+     * describes can be represented, so that a corrupt or crafted header cannot lead to reads past the data.
+     *
+     * @return The size in bytes of the file described by the header, data_offset included
+     * @throw std::runtime_error if the datatype does not match or the header is invalid
+     */
+    template <typename TData>
+    size_t checkHeaderType(const MatrixFileHeader &header, const std::string &path)
+    {
+        if (header.dtype != DataTypeOf<TData>::value || header.element_size != sizeof(TData))
+        {
+            throw std::runtime_error("The datatype stored in " + path + " does not match the requested datatype");
+        }
+
+        // (rows - 1) * stride + cols elements, after data_offset bytes
+        size_t elements = 0, data_bytes = 0, file_bytes = 0;
+        const bool valid = header.data_offset % alignof(TData) == 0
+            && (header.rows == 0 || (checkedMultiply(header.rows - 1, header.stride, elements)
+                && checkedAdd(elements, header.cols, elements)))
+            && checkedMultiply(elements, sizeof(TData), data_bytes)
+            && checkedAdd(header.data_offset, data_bytes, file_bytes);
+        if (!valid)
+        {
+            throw std::runtime_error(path + " has an invalid header");
+        }
+        return file_bytes;
+    }
+
+    /**
+     * Header of a file holding a compact rows x cols matrix of TData in the byte order of the host.
+     */
+    template <typename TData>
+    MatrixFileHeader makeMatrixHeader(const size_t rows, const size_t cols)
+    {
+        MatrixFileHeader header{};
+        std::memcpy(header.magic, matrix_file_magic, sizeof(matrix_file_magic));
+        header.version = matrix_file_version;
+        header.endianness = hostEndianness();
+        header.dtype = DataTypeOf<TData>::value;
+        header.element_size = sizeof(TData);
+        header.rows = rows;
+        header.cols = cols;
+        header.stride = cols;
+        header.data_offset = sizeof(MatrixFileHeader);
+        return header;
+    }
+
+    /**
+     * Saves a matrix or a view to a binary file, streaming it row by row without building a copy in memory.
+     * The file is written in the byte order of the host with a stride equal to the number of columns.
+     *
+     * @tparam TData
+     * @param path
+     * @param mat
+     * @throw std::runtime_error if the file cannot be written
+     */
+    template <typename TData>
+    void saveMatrix(const std::string &path, const ConstMatrixView<TData> &mat)
+    {
+        const MatrixFileHeader header = makeMatrixHeader<TData>(mat.rows(), mat.cols());
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (size_t i = 0; i < mat.rows() && file; ++i)
+        {
+            file.write(reinterpret_cast<const char *>(mat.data() + i * mat.stride()), mat.cols() * sizeof(TData));
+        }
+        file.flush();
+        if (!file)
+        {
+            throw std::runtime_error("Could not write " + path);
+        }
+    }
+
+    template <typename TData>
+    void saveMatrix(const std::string &path, const Matrix<TData> &mat)
+    {
+        saveMatrix(path, ConstMatrixView<TData>(mat));
+    }
+
+    template <typename TData>
+    void saveMatrix(const std::string &path, const MatrixView<TData> &view)
+    {
+        saveMatrix(path, ConstMatrixView<TData>(view));
+    }
+
+    /**
+     * Loads a matrix file into a new Matrix, converting the byte order if the file was written on a host of the other
+     * endianness. Use MappedMatrix to access the data without copying it.
+     *
+     * @tparam TData
+     * @param path
+     * @return Matrix<TData>
+     * @throw std::runtime_error if the file cannot be read or holds another datatype
+     */
+    template <typename TData>
+    Matrix<TData> loadMatrix(const std::string &path)
+    {
+        const MatrixFileHeader header = readMatrixHeader(path);
+        const size_t file_bytes = checkHeaderType<TData>(header, path);
+
+        // Check the size of the file before allocating, so that a truncated or crafted header cannot request more memory
+        // than the file holds
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        const std::streamoff size = file.tellg();
+        if (!file || size < 0 || (uint64_t)size < file_bytes)
+        {
+            throw std::runtime_error(path + " is truncated");
+        }
+
+        Matrix<TData> r(header.rows, header.cols);
+        for (size_t i = 0; i < header.rows; ++i)
+        {
+            file.seekg(header.data_offset + i * header.stride * sizeof(TData));
+            if (!file.read(reinterpret_cast<char *>(r.data() + i * r.stride()), header.cols * sizeof(TData)))
+            {
+                throw std::runtime_error(path + " is truncated");
+            }
+        }
+        if (header.endianness != hostEndianness())
+        {
+            for (size_t i = 0; i < header.rows; ++i)
+            {
+                for (size_t j = 0; j < header.cols; ++j)
+                {
+                    r(i, j) = byteSwap(r(i, j));
+                }
+            }
+        }
+        return r;
+    }
+
+    /**
+     * Read-only matrix backed by a memory-mapped file. Loading only maps the file, pages are read from the page cache
+     * when they are first accessed, so no copy of the data is made. The data is exposed through view(), which can be
+     * used in expressions and products like any other ConstMatrixView. The mapping is released on destruction.
+     *
+     * Without mmap support, the data is read into memory instead.
+     *
+     * @tparam TData
+     */
+    template <typename TData>
+    class MappedMatrix
+    {
+    public:
+        using value_type = TData;
+
+        /**
+         * Maps a matrix file for reading.
+         *  @param path
+         *  @throw std::runtime_error if the file cannot be mapped, holds another datatype or is of the other endianness
+         */
+        explicit MappedMatrix(const std::string &path)
+        {
+            m_header = readMatrixHeader(path);
+            const size_t file_bytes = checkHeaderType<TData>(m_header, path);
+            if (m_header.endianness != hostEndianness())
+            {
+                throw std::runtime_error(path + " was written with a different byte order, use loadMatrix to convert it");
+            }
+
+#if MATRIX_LIBRARY_HAS_MMAP
+            const int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+            {
+                throw std::runtime_error("Could not open " + path);
+            }
+            struct stat st;
+            if (::fstat(fd, &st) != 0 || (size_t)st.st_size < file_bytes)
+            {
+                ::close(fd);
+                throw std::runtime_error(path + " is truncated");
+            }
+            void *mapping = ::mmap(nullptr, file_bytes, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (mapping == MAP_FAILED)
+            {
+                throw std::runtime_error("Could not map " + path);
+            }
+            // Data is mostly read front to back, let the kernel read ahead aggressively
+            ::madvise(mapping, file_bytes, MADV_SEQUENTIAL);
+            m_mapping = mapping;
+            m_mapping_bytes = file_bytes;
+            m_data = reinterpret_cast<const TData *>(static_cast<const char *>(mapping) + m_header.data_offset);
+#else
+            const size_t data_bytes = file_bytes - m_header.data_offset;
+            std::ifstream file(path, std::ios::binary);
+            m_buffer.resize((data_bytes + sizeof(TData) - 1) / sizeof(TData));
+            file.seekg(m_header.data_offset);
+            if (!file.read(reinterpret_cast<char *>(m_buffer.data()), data_bytes))
+            {
+                throw std::runtime_error(path + " is truncated");
+            }
+            m_data = m_buffer.data();
+#endif
+        }
+
+        MappedMatrix(const MappedMatrix &) = delete;
+        MappedMatrix &operator=(const MappedMatrix &) = delete;
+
+        MappedMatrix(MappedMatrix &&source) noexcept
+        {
+            *this = std::move(source);
+        }
+
+        MappedMatrix &operator=(MappedMatrix &&source) noexcept
+        {
+            if (this != &source)
+            {
+                release();
+                m_header = source.m_header;
+                m_data = source.m_data;
+                m_mapping = source.m_mapping;
+                m_mapping_bytes = source.m_mapping_bytes;
+                m_buffer = std::move(source.m_buffer);
+                source.m_data = nullptr;
+                source.m_mapping = nullptr;
+                source.m_mapping_bytes = 0;
+            }
+            return *this;
+        }
+
+        ~MappedMatrix()
+        {
+            release();
+        }
+
+        size_t rows() const { return m_header.rows; }
+        size_t cols() const { return m_header.cols; }
+        size_t stride() const { return m_header.stride; }
+        const TData *data() const { return m_data; }
+
+        const TData &operator()(const size_t i, const size_t j) const
+        {
+            return m_data[i * m_header.stride + j];
+        }
+
+        ConstMatrixView<TData> view() const
+        {
+            return ConstMatrixView<TData>(m_data, m_header.rows, m_header.cols, m_header.stride);
+        }
+
+        operator ConstMatrixView<TData>() const
+        {
+            return view();
+        }
+
+        /**
+         * Getter for the dimensions of the matrix, returned as a pair in the form of rows, cols
+         *
+         * @return std::pair <size_t, size_t>
+         */
+        std::pair<size_t, size_t> getDimensions() const
+        {
+            return std::make_pair(rows(), cols());
+        }
+
+    private:
+        void release()
+        {
+#if MATRIX_LIBRARY_HAS_MMAP
+            if (m_mapping)
+            {
+                ::munmap(m_mapping, m_mapping_bytes);
+            }
+#endif
+            m_mapping = nullptr;
+            m_mapping_bytes = 0;
+            m_data = nullptr;
+            m_buffer.clear();
+        }
+
+        MatrixFileHeader m_header{};
+        const TData *m_data = nullptr;
+        void *m_mapping = nullptr;
+        size_t m_mapping_bytes = 0;
+        std::vector<TData> m_buffer;
+    };
+} // end namespace MatrixLibrary
+
+#endif // #ifndef MATRIX_IO_HPP
@@ -9,32 +9,108 @@
 #define MATRIX_LIBRARY_HPP
 
 #include <vector>
+#include <initializer_list>
 #include <iostream>
 #include <cassert>
 #include <iomanip>
 #include <utility>
 #include <stdexcept>
+#include <functional>
+#include <type_traits>
+#include <algorithm>
+#include "instrumentation.hpp"
+#include "matrix_allocator.hpp"
+#include "simd_kernels.hpp"
 #include "concurrency_utils.hpp"
+#include "transpose_kernel.hpp"
+#include "matrix_expression.hpp"
+#include "matrix_view.hpp"
+#include "strassen.hpp"
 
 namespace MatrixLibrary
 {
     // Number of threads to use for matrix computations, set as a static variable of the namespace
     static size_t n_threads = 1;
-    static bool printMemoryInfo = false;
+
+    // Element-wise operations, copies and fills of fewer elements than this run on the calling thread only, they are
+    // bound by memory bandwidth and too short to amortize waking other threads
+    static constexpr size_t elementwise_parallel_threshold = 1 << 16;
+
+    /**
+     * Calls func(row_begin, row_end) over [0, rows) split into one contiguous range per thread when the rows x cols
+     * elements reach elementwise_parallel_threshold, and once on the calling thread otherwise. New buffers are
+     * initialized through this split as well, so that on NUMA systems their pages are first touched, and placed, by
+     * the pool threads rather than all on the node of the calling thread.
+     *
+     * @param rows
+     * @param cols
+     * @param func
+     */
+    inline void parallelRows(const size_t rows, const size_t cols, const std::function<void(size_t, size_t)> &func)
+    {
+        const size_t n_parts = (n_threads <= 1 || rows * cols < elementwise_parallel_threshold) ? 1 : std::min(rows, n_threads);
+        if (n_parts <= 1)
+        {
+            func(0, rows);
+            return;
+        }
+        const size_t rows_per_part = (rows + n_parts - 1) / n_parts;
+        parallelFor(n_parts, n_threads, [&](const size_t p)
+        {
+            func(std::min(rows, p * rows_per_part), std::min(rows, (p + 1) * rows_per_part));
+        });
+    }
+
+    /**
+     * Evaluates all rows of an expression into a row-major destination, see evaluateRows, split by parallelRows.
+     */
+    template <typename TExpr, typename TData, typename TAssign>
+    void evaluateRowsParallel(const TExpr &expr, TData *dst, const size_t ld, const size_t rows, TAssign assign)
+    {
+        parallelRows(rows, expr.cols(), [&](const size_t row_begin, const size_t row_end)
+        {
+            evaluateRows(expr, dst, ld, row_begin, row_end, assign);
+        });
+    }
+
+    /**
+     * Copy of n elements into a new buffer, in parallel chunks of whole rows of row_length elements. The buffer is
+     * allocated without initialization, each chunk is first touched by the thread copying it.
+     */
+    template <typename TData>
+    MatrixBuffer<TData> copyBuffer(const TData *src, const size_t n, const size_t row_length,
+        const MatrixAllocator<TData> &allocator = MatrixAllocator<TData>())
+    {
+        MatrixBuffer<TData> buffer(n, allocator);
+        if (n == 0)
+        {
+            return buffer;
+        }
+        const size_t length = std::max<size_t>(row_length, 1);
+        parallelRows((n + length - 1) / length, length, [&](const size_t row_begin, const size_t row_end)
+        {
+            std::copy(src + row_begin * length, src + std::min(n, row_end * length), buffer.data() + row_begin * length);
+        });
+        return buffer;
+    }
+
+    template <typename TData>
+    class Matrix;
+
+    template <typename TData>
+    Matrix<TData> multiply(const ConstMatrixView<TData> &lhs, const ConstMatrixView<TData> &rhs);
 
     template <typename TData>
-    class Matrix
+    class Matrix : public MatrixExpr<Matrix<TData>>
     {
     public:
+        using value_type = TData;
+
         /**
          * Default constructor.
          */
-        Matrix() : m_rows(0), m_cols(0)
+        Matrix() : m_rows(0), m_cols(0), m_stride(0)
         {
-            if (printMemoryInfo)
-            {
-                std::cout << "Default Constructor called" << std::endl;
-            }
         }
 
         /**
@@ -42,38 +118,78 @@ namespace MatrixLibrary
          *  @param rows
          *  @param cols
          */
-        Matrix(const size_t rows, const size_t cols): m_rows(rows), m_cols(cols), m_data(rows, std::vector<TData>(cols))
+        Matrix(const size_t rows, const size_t cols): m_data(rows * cols), m_rows(rows), m_cols(cols), m_stride(cols)
         {
             if (rows <= 0 || cols <= 0)
             {
                 throw std::invalid_argument("Row and column must be positive integers");
             }
-            if (printMemoryInfo)
+            parallelRows(m_rows, m_cols, [this](const size_t row_begin, const size_t row_end)
             {
-                std::cout << "Dimensions-only Constructor called" << std::endl;
-            }
+                std::fill(m_data.data() + row_begin * m_stride, m_data.data() + row_end * m_stride, TData(0));
+            });
         }
         
         /**
-         * Constructor with input data available.
+         * Constructor with input data available. The rows are copied into a single contiguous row-major buffer.
          *  @param data Vector of vectors holding the input data
          */
         Matrix(const std::vector<std::vector<TData>>& data): 
-            m_rows(data.size()), m_cols(data.front().size()), m_data(data)
+            m_rows(data.size()), m_cols(data.front().size()), m_stride(data.front().size())
         {
             // Assert that the input data type is numeric
             static_assert(std::is_arithmetic<TData>::value, "TData must be numeric");
 
             // Assert that the input data is valid in terms of dimensions
             assert(m_rows > 0 && m_cols > 0 && "Matrix must have at least 1 row");
-            for (size_t i = 0; i < m_rows; ++i)
+            m_data = MatrixBuffer<TData>(m_rows * m_stride);
+            parallelRows(m_rows, m_cols, [&](const size_t row_begin, const size_t row_end)
             {
-                assert(m_data[i].size() == m_cols && "Each row must have the same size");
-            }
+                for (size_t i = row_begin; i < row_end; ++i)
+                {
+                    assert(data[i].size() == m_cols && "Each row must have the same size");
+                    std::copy(data[i].begin(), data[i].end(), m_data.data() + i * m_stride);
+                }
+            });
+        }
 
-            if (printMemoryInfo)
+        /**
+         * Constructor with contiguous row-major input data available, the data is copied into an aligned buffer.
+         *  @param rows
+         *  @param cols
+         *  @param data Row-major buffer of size rows * cols
+         */
+        Matrix(const size_t rows, const size_t cols, const std::vector<TData> &data): 
+            Matrix(rows, cols, copyBuffer(data.data(), data.size(), cols))
+        {
+        }
+
+        /**
+         * Constructor with row-major input data given in braces, e.g. Matrix<int>(2, 2, {1, 2, 3, 4}).
+         */
+        Matrix(const size_t rows, const size_t cols, std::initializer_list<TData> data): 
+            Matrix(rows, cols, MatrixBuffer<TData>(data))
+        {
+        }
+
+        /**
+         * Constructor with contiguous row-major input data available in a Matrix buffer, which is taken over without copying when moved in.
+         *  @param rows
+         *  @param cols
+         *  @param data Row-major buffer of size rows * cols
+         */
+        Matrix(const size_t rows, const size_t cols, MatrixBuffer<TData> data): 
+            m_data(std::move(data)), m_rows(rows), m_cols(cols), m_stride(cols)
+        {
+            static_assert(std::is_arithmetic<TData>::value, "TData must be numeric");
+
+            if (rows <= 0 || cols <= 0)
             {
-                std::cout << "Constructor with data called" << std::endl;
+                throw std::invalid_argument("Row and column must be positive integers");
+            }
+            if (m_data.size() != rows * cols)
+            {
+                throw std::invalid_argument("Data size must equal rows * cols");
             }
         }
 
@@ -81,25 +197,35 @@ namespace MatrixLibrary
          * Copy constructor.
          * 
          */
-        Matrix(const Matrix &source): m_rows(source.m_rows), m_cols(source.m_cols), m_data(source.m_data)
+        Matrix(const Matrix &source): m_data(copyBuffer(source.m_data.data(), source.m_data.size(), source.m_stride)),
+            m_rows(source.m_rows), m_cols(source.m_cols), m_stride(source.m_stride)
         {
-            if (printMemoryInfo)
-            {
-                std::cout << "Copy Constructor called" << std::endl;
-            }
+            MATRIX_LIBRARY_COUNT(copies, 1);
         }
 
         /**
          * Move constructor.
          * 
          */
-        Matrix(Matrix &&source): m_rows(source.m_rows), m_cols(source.m_cols)
+        Matrix(Matrix &&source): m_rows(source.m_rows), m_cols(source.m_cols), m_stride(source.m_stride)
         {
             m_data = std::move(source.m_data);
-            if (printMemoryInfo)
-            {
-                std::cout << "Move Constructor called" << std::endl;
-            }
+            MATRIX_LIBRARY_COUNT(moves, 1);
+        }
+
+        /**
+         * Constructor evaluating a Matrix expression, e.g. the result of A + B - C, in a single pass.
+         * The expression may have a narrower datatype, e.g. a Matrix<double> from an int expression, while narrowing
+         * conversions must be requested explicitly with cast<T>().
+         * @param expr
+         */
+        template <typename TDerived>
+        Matrix(const MatrixExpr<TDerived> &expr): 
+            m_data(expr.derived().rows() * expr.derived().cols()), m_rows(expr.derived().rows()), m_cols(expr.derived().cols()), m_stride(expr.derived().cols())
+        {
+            static_assert(IsPromotable<typename TDerived::value_type, TData>::value,
+                "Expression datatype does not convert implicitly to the datatype of the Matrix, use cast<T>()");
+            evaluateRowsParallel(expr.derived(), m_data.data(), m_stride, m_rows, AssignOp());
         }
 
         /**
@@ -108,14 +234,26 @@ namespace MatrixLibrary
          */
         Matrix &operator=(const Matrix &source)
         {
+            if (this == &source)
+            {
+                return *this;
+            }
             m_rows = source.m_rows;
             m_cols = source.m_cols;
-            m_data = source.m_data;
-
-            if (printMemoryInfo)
+            m_stride = source.m_stride;
+            if (m_data.size() == source.m_data.size())
             {
-                std::cout << "Copy Assignment Operator called" << std::endl;
+                parallelRows(m_rows, m_stride, [&](const size_t row_begin, const size_t row_end)
+                {
+                    std::copy(source.m_data.data() + row_begin * m_stride, source.m_data.data() + row_end * m_stride,
+                        m_data.data() + row_begin * m_stride);
+                });
             }
+            else
+            {
+                m_data = copyBuffer(source.m_data.data(), source.m_data.size(), source.m_stride, m_data.get_allocator());
+            }
+            MATRIX_LIBRARY_COUNT(copies, 1);
 
             return *this;
         }
@@ -132,144 +270,160 @@ namespace MatrixLibrary
             }
             m_rows = source.m_rows;
             m_cols = source.m_cols;
+            m_stride = source.m_stride;
             m_data = std::move(source.m_data);
-
-            if (printMemoryInfo)
-            {
-                std::cout << "Move assignment operator called" << std::endl;
-            }
+            MATRIX_LIBRARY_COUNT(moves, 1);
 
             return *this;
         }
 
         /**
-         * Overloaded * operator, each Matrix operand must have the same datatype, or else the compiler will fail.
+         * Overloaded * operator for two matrices of the same datatype, see below for mixed datatypes.
          * @param mat The other Matrix to multiply with
          * @return A new Matrix holding the result
          */
-        virtual Matrix operator*(const Matrix &mat) const
+        Matrix operator*(const Matrix &mat) const
         {
-            assert(m_cols == mat.m_rows && "First matrix's cols must match second matrix's rows");
-
-            std::vector<std::vector<TData>> r_data(m_rows, std::vector<TData>(mat.m_cols));
-
-            // Serial computation, no multithreading
-            if (n_threads == 1)
-            {
-                std::cout << "Multiplying without multithreading..." << "\n";
-                for (size_t i = 0; i < m_rows; ++i)
-                {
-                    for (size_t j = 0; j < mat.m_cols; ++j)
-                    {
-                        for (size_t k = 0; k < m_cols; ++k)
-                        {
-                            r_data[i][j] += m_data[i][k] * mat.m_data[k][j];
-                        }
-                    }
-                }
-            }
-            // Employ multithreaded computation
-            else
-            {
-                std::cout << "Multiplying with multithreading using " << n_threads << " threads ..." << "\n";
-                multiplyMatricesAsync(r_data, m_data, mat.m_data, n_threads);
-            }
+            return multiply<TData>(*this, mat);
+        }
 
-            Matrix<TData> r(r_data);
-            return r;
+        /**
+         * Overloaded * operator for a view or expression as the second operand, views are multiplied without copying
+         * and expressions are evaluated once beforehand. An operand of another datatype is converted first and the
+         * result has the PromotedType of both, e.g. Matrix<int> * Matrix<double> gives a Matrix<double>.
+         * @param expr The other operand to multiply with
+         * @return A new Matrix holding the result
+         */
+        template <typename TDerived>
+        Matrix<PromotedType<TData, typename TDerived::value_type>> operator*(const MatrixExpr<TDerived> &expr) const
+        {
+            return multiplyPromoted(*this, expr.derived());
         }
 
         /**
          * Overloaded *= operator, each Matrix operand must have the same datatype, or else the compiler will fail.
+         * A square right-hand side keeps the dimensions, the product is then computed in place a panel of rows at a
+         * time, each panel being copied out before it is overwritten, instead of into a new Matrix.
          * @param mat The other Matrix to multiply with
          */
         Matrix &operator*=(const Matrix &mat)
         {
-            *this = std::move((*this) * mat);
+            assert(m_cols == mat.m_rows && "First matrix's cols must match second matrix's rows");
+            if (&mat == this || mat.m_rows != mat.m_cols || useStrassen<TData>(m_rows, m_cols, mat.m_cols))
+            {
+                *this = std::move((*this) * mat);
+                return *this;
+            }
+
+            MATRIX_LIBRARY_TRACE_SCOPE("multiply");
+            MATRIX_LIBRARY_COUNT(multiplications, 1);
+            MATRIX_LIBRARY_COUNT(flops, 2 * m_rows * m_cols * m_cols);
+            const size_t panel_rows = std::min(m_rows, GemmBlocking<TData>::MC * std::max<size_t>(n_threads, 1));
+            MatrixBuffer<TData> panel(panel_rows * m_cols);
+            for (size_t row = 0; row < m_rows; row += panel_rows)
+            {
+                const size_t rows = std::min(panel_rows, m_rows - row);
+                TData *out = m_data.data() + row * m_stride;
+                for (size_t i = 0; i < rows; ++i)
+                {
+                    std::copy(out + i * m_stride, out + i * m_stride + m_cols, panel.data() + i * m_cols);
+                    std::fill(out + i * m_stride, out + i * m_stride + m_cols, TData(0));
+                }
+                gemmUpdate(rows, m_cols, m_cols, TData(1), panel.data(), m_cols, mat.m_data.data(), mat.m_stride, out, m_stride,
+                    std::max<size_t>(n_threads, 1));
+            }
             return *this;
         }
 
         /**
-        * Overloaded + operator, each Matrix operand must have the same datatype, or else the compiler will fail.
-        * @param mat The other Matrix to add with
-        * @return A new Matrix holding the result
-        */
-        Matrix operator+(const Matrix& mat) const
+         * Assignment from a Matrix expression. The expression is evaluated directly into the existing buffer when
+         * the dimensions match, and through a temporary when it reads this Matrix in transposed order.
+         * @param expr
+         */
+        template <typename TDerived>
+        Matrix &operator=(const MatrixExpr<TDerived> &expr)
         {
-            assert(m_cols == mat.m_cols && m_rows == mat.m_rows && "Two matrices must have the same dimensions");
-
-            std::vector<std::vector<TData>> r_data(m_rows, std::vector<TData>(m_cols));
-
-            for (size_t i = 0; i < m_rows; ++i)
+            static_assert(IsPromotable<typename TDerived::value_type, TData>::value,
+                "Expression datatype does not convert implicitly to the datatype of the Matrix, use cast<T>()");
+            const TDerived &e = expr.derived();
+            if (e.rows() != m_rows || e.cols() != m_cols || e.transposeAliases(dataBegin(), dataEnd()))
             {
-                for (size_t j = 0; j < mat.m_cols; ++j)
-                {                    
-                    r_data[i][j] += (m_data[i][j] + mat.m_data[i][j]);
-                }
+                return *this = Matrix(e);
             }
-            Matrix<TData> r(r_data);
-            return r;
+            evaluateRowsParallel(e, m_data.data(), m_stride, m_rows, AssignOp());
+            return *this;
         }
 
         /**
-         * Overloaded += operator, each Matrix operand must have the same datatype, or else the compiler will fail.
-         * @param mat The other Matrix to add with
+         * Overloaded += operator, the expression is added into this Matrix in place without temporaries.
+         * The expression may have a narrower datatype, which is converted, e.g. adding an int Matrix into a double one.
+         * @param expr The Matrix or Matrix expression to add with
          */
-        Matrix& operator+=(const Matrix& mat)
+        template <typename TDerived>
+        Matrix& operator+=(const MatrixExpr<TDerived> &expr)
         {
-            *this = std::move((*this) + mat);
-            return *this;
+            return compoundAssign(expr.derived(), AddAssignOp());
         }
 
         /**
-        * Overloaded - operator, each Matrix operand must have the same datatype, or else the compiler will fail.
-        * @param mat The other Matrix that will be subtracted from the current
-        * @return A new Matrix holding the result
-        */
-        Matrix operator-(const Matrix& mat) const
+         * Overloaded -= operator, the expression is subtracted from this Matrix in place without temporaries.
+         * The expression may have a narrower datatype, which is converted, e.g. subtracting an int Matrix from a double one.
+         * @param expr The Matrix or Matrix expression to subtract with
+         */
+        template <typename TDerived>
+        Matrix& operator-=(const MatrixExpr<TDerived> &expr)
         {
-            assert(m_cols == mat.m_cols && m_rows == mat.m_rows && "Two matrices must have the same dimensions");
-
-            std::vector<std::vector<TData>> r_data(m_rows, std::vector<TData>(m_cols));
+            return compoundAssign(expr.derived(), SubtractAssignOp());
+        }
 
-            for (size_t i = 0; i < m_rows; ++i)
-            {
-                for (size_t j = 0; j < mat.m_cols; ++j)
-                {
-                    r_data[i][j] += (m_data[i][j] - mat.m_data[i][j]);
-                }
-            }
-            Matrix<TData> r(r_data);
-            return r;
+        /**
+         * Overloaded *= operator for scaling by a scalar in place.
+         * @param scalar
+         */
+        Matrix &operator*=(const TData scalar)
+        {
+            evaluateRowsParallel((*this) * scalar, m_data.data(), m_stride, m_rows, AssignOp());
+            return *this;
         }
 
         /**
-         * Overloaded -= operator, each Matrix operand must have the same datatype, or else the compiler will fail.
-         * @param mat The other Matrix to subtract with
+         * Overloaded /= operator for dividing by a scalar in place.
+         * @param scalar
          */
-        Matrix& operator-=(const Matrix& mat)
+        Matrix &operator/=(const TData scalar)
         {
-            *this = std::move((*this) - mat);
+            evaluateRowsParallel((*this) / scalar, m_data.data(), m_stride, m_rows, AssignOp());
             return *this;
         }
 
         /**
          * Instantiates a new Matrix which contains the result of transposing the current Matrix.
+         * Uses a cache-oblivious blocked transpose, multithreaded depending on the n_threads setting.
          * @return A new matrix holding the transpose
          */
-        virtual Matrix transpose() const
+        Matrix transpose() const
         {
-            std::vector<std::vector<TData>> r_data(m_cols, std::vector<TData>(m_rows));
-            
-            for (size_t i = 0; i < m_rows; ++i)
+            Matrix<TData> r = uninitialized(m_cols, m_rows);
+            transposeMatrix(m_rows, m_cols, m_data.data(), m_stride, r.m_data.data(), r.m_stride, n_threads);
+            return r;
+        }
+
+        /**
+         * Transposes the current Matrix. Square matrices are transposed in place by swapping tiles without any allocation,
+         * other shapes are transposed into a new buffer that replaces the current one.
+         * @return Reference to the current Matrix
+         */
+        Matrix &transposeInPlace()
+        {
+            if (m_rows == m_cols)
             {
-                for (size_t j = 0; j < m_cols; ++j)
-                {
-                    r_data[j][i] = m_data[i][j];
-                }
+                transposeInPlaceSquare(m_rows, m_data.data(), m_stride, n_threads);
+            }
+            else
+            {
+                *this = transpose();
             }
-            Matrix<TData> r(r_data);
-            return r;            
+            return *this;
         }
 
         /**
@@ -284,7 +438,7 @@ namespace MatrixLibrary
             {
                 for (size_t j = 0; j < m_cols; ++j)
                 {
-                    std::cout << std::fixed << std::setprecision(p) << m_data[i][j] << " ";
+                    std::cout << std::fixed << std::setprecision(p) << m_data[i * m_stride + j] << " ";
                 }
                 std::cout << "\n";
             }
@@ -305,29 +459,464 @@ namespace MatrixLibrary
         }
 
         /**
-         * Get a reference to the underlying data of the Matrix
+         * Get a copy of the data of the Matrix as a vector of vectors. Kept for compatibility, 
+         * use data() and stride() to access the underlying contiguous buffer without copying.
+         * The copy is const, so that code writing through the reference getData() used to return,
+         * e.g. mat.getData()[i][j] = x, fails to compile instead of writing into a temporary.
          * 
-         * @return std::vector<std::vector<TData>>& 
+         * @return const std::vector<std::vector<TData>>
+         */
+        const std::vector<std::vector<TData>> getData() const
+        {
+            std::vector<std::vector<TData>> r_data;
+            r_data.reserve(m_rows);
+            for (size_t i = 0; i < m_rows; ++i)
+            {
+                r_data.emplace_back(m_data.begin() + i * m_stride, m_data.begin() + i * m_stride + m_cols);
+            }
+            return r_data;
+        }
+
+        /**
+         * Get a pointer to the contiguous row-major buffer, element (i, j) is located at data()[i * stride() + j]
+         * 
+         * @return TData* 
+         */
+        TData *data()
+        {
+            return m_data.data();
+        }
+
+        const TData *data() const
+        {
+            return m_data.data();
+        }
+
+        /**
+         * Getter for the row stride (leading dimension) of the underlying buffer
+         * 
+         * @return size_t
+         */
+        size_t stride() const
+        {
+            return m_stride;
+        }
+
+        /**
+         * Views of the whole Matrix, see matrix_view.hpp
+         */
+        MatrixView<TData> view()
+        {
+            return MatrixView<TData>(*this);
+        }
+
+        ConstMatrixView<TData> view() const
+        {
+            return ConstMatrixView<TData>(*this);
+        }
+
+        /**
+         * View of the h x w block whose top left element is (r, c), no data is copied.
+         * @param r
+         * @param c
+         * @param h
+         * @param w
+         */
+        MatrixView<TData> block(const size_t r, const size_t c, const size_t h, const size_t w)
+        {
+            return view().block(r, c, h, w);
+        }
+
+        ConstMatrixView<TData> block(const size_t r, const size_t c, const size_t h, const size_t w) const
+        {
+            return view().block(r, c, h, w);
+        }
+
+        /**
+         * View of row i, no data is copied.
+         * @param i
+         */
+        MatrixView<TData> row(const size_t i)
+        {
+            return view().row(i);
+        }
+
+        ConstMatrixView<TData> row(const size_t i) const
+        {
+            return view().row(i);
+        }
+
+        /**
+         * View of column j, no data is copied.
+         * @param j
+         */
+        MatrixView<TData> col(const size_t j)
+        {
+            return view().col(j);
+        }
+
+        ConstMatrixView<TData> col(const size_t j) const
+        {
+            return view().col(j);
+        }
+
+        /**
+         * Element access without bounds checking.
+         * @param i Row index
+         * @param j Column index
+         * @return Reference to the element
          */
-        std::vector<std::vector<TData>> &getData()
+        TData &operator()(const size_t i, const size_t j)
+        {
+            return m_data[i * m_stride + j];
+        }
+
+        const TData &operator()(const size_t i, const size_t j) const
         {
-            return m_data;
+            return m_data[i * m_stride + j];
+        }
+
+        /*
+         * Expression interface, see matrix_expression.hpp
+         */
+
+        size_t rows() const
+        {
+            return m_rows;
+        }
+
+        size_t cols() const
+        {
+            return m_cols;
+        }
+
+        TData coeff(const size_t i, const size_t j) const
+        {
+            return m_data[i * m_stride + j];
+        }
+
+        bool aliases(const void *begin, const void *end) const
+        {
+            return dataBegin() < end && begin < dataEnd();
+        }
+
+        bool transposeAliases(const void *, const void *) const
+        {
+            return false;
         }
 
     protected:
-        std::vector<std::vector<TData>> m_data;
+        const void *dataBegin() const
+        {
+            return m_data.data();
+        }
+
+        const void *dataEnd() const
+        {
+            return m_data.data() + m_data.size();
+        }
+
+        // Matrix whose elements are left uninitialized, for results which are entirely overwritten
+        static Matrix uninitialized(const size_t rows, const size_t cols)
+        {
+            return Matrix(rows, cols, MatrixBuffer<TData>(rows * cols));
+        }
+
+        template <typename TExpr, typename TAssign>
+        Matrix &compoundAssign(const TExpr &expr, TAssign assign)
+        {
+            static_assert(IsPromotable<typename TExpr::value_type, TData>::value,
+                "Expression datatype does not convert implicitly to the datatype of the Matrix, use cast<T>()");
+            assert(m_cols == expr.cols() && m_rows == expr.rows() && "Two matrices must have the same dimensions");
+            if (expr.transposeAliases(dataBegin(), dataEnd()))
+            {
+                const Matrix evaluated(expr);
+                evaluateRowsParallel(evaluated, m_data.data(), m_stride, m_rows, assign);
+            }
+            else
+            {
+                evaluateRowsParallel(expr, m_data.data(), m_stride, m_rows, assign);
+            }
+            return *this;
+        }
+
+        // Single row-major allocation aligned to matrix_alignment, element (i, j) is stored at m_data[i * m_stride + j]
+        MatrixBuffer<TData> m_data;
         size_t m_rows;
         size_t m_cols;
+        size_t m_stride;
+    };
+
+    /**
+     * Multiplies two blocks of row-major data, using multithreading depending on the n_threads setting.
+     * @param lhs
+     * @param rhs
+     * @return A new Matrix holding the result
+     */
+    template <typename TData>
+    Matrix<TData> multiply(const ConstMatrixView<TData> &lhs, const ConstMatrixView<TData> &rhs)
+    {
+        assert(lhs.cols() == rhs.rows() && "First matrix's cols must match second matrix's rows");
+
+        MATRIX_LIBRARY_TRACE_SCOPE("multiply");
+        MATRIX_LIBRARY_COUNT(multiplications, 1);
+        MATRIX_LIBRARY_COUNT(flops, 2 * lhs.rows() * lhs.cols() * rhs.cols());
+        Matrix<TData> r(lhs.rows(), rhs.cols());
+
+        // Opt-in fast algorithm for large square floating point products
+        if (useStrassen<TData>(lhs.rows(), lhs.cols(), rhs.cols()))
+        {
+            strassenMultiply(lhs.rows(), lhs.data(), lhs.stride(), rhs.data(), rhs.stride(), r.data(), r.stride(),
+                strassen_crossover, std::max<size_t>(n_threads, 1));
+        }
+        // Serial computation, no multithreading
+        else if (n_threads == 1)
+        {
+            computeGivenRows(r.data(), r.stride(), 0, lhs.rows(), lhs.data(), lhs.stride(), rhs.data(), rhs.stride(), lhs.cols(), rhs.cols());
+        }
+        // Employ multithreaded computation
+        else
+        {
+            multiplyMatricesAsync(r.data(), r.stride(), lhs.data(), lhs.stride(), rhs.data(), rhs.stride(), 
+                lhs.rows(), lhs.cols(), rhs.cols(), n_threads);
+        }
+
+        return r;
+    }
+
+    // Whether an operand of gemm is used as is or transposed, as the transa and transb arguments of BLAS
+    enum class Transpose
+    {
+        NoTrans,
+        Trans
     };
 
+    /**
+     * BLAS-style product C = alpha * op(A) * op(B) + beta * C, written into the existing C without any allocation.
+     * op(X) is X or its transpose according to the flags, transposed operands are read in transposed order by the
+     * kernel rather than transposed beforehand, e.g. gemm(1.0, A, Transpose::NoTrans, A, Transpose::Trans, 0.0, C)
+     * computes A * A^T. As in BLAS, C is not read when beta is 0 and must not overlap A or B.
+     *
+     * @param alpha
+     * @param A
+     * @param trans_a
+     * @param B
+     * @param trans_b
+     * @param beta
+     * @param C The output, which may be a block of a larger Matrix, its dimensions must match op(A) * op(B)
+     */
+    template <typename TData>
+    void gemm(const typename Matrix<TData>::value_type alpha, const ConstMatrixView<TData> &A, const Transpose trans_a,
+        const ConstMatrixView<TData> &B, const Transpose trans_b, const typename Matrix<TData>::value_type beta, const MatrixView<TData> &C)
+    {
+        const bool transposed_a = (trans_a == Transpose::Trans);
+        const bool transposed_b = (trans_b == Transpose::Trans);
+        const size_t M = transposed_a ? A.cols() : A.rows();
+        const size_t K = transposed_a ? A.rows() : A.cols();
+        const size_t N = transposed_b ? B.rows() : B.cols();
+        assert(K == (transposed_b ? B.cols() : B.rows()) && "Cols of op(A) must match rows of op(B)");
+        assert(C.rows() == M && C.cols() == N && "Output must have the dimensions of op(A) * op(B)");
+        assert(!A.aliases(C.data(), C.data() + C.rows() * C.stride()) && !B.aliases(C.data(), C.data() + C.rows() * C.stride())
+            && "Output must not overlap the operands");
+
+        MATRIX_LIBRARY_TRACE_SCOPE("gemm");
+        MATRIX_LIBRARY_COUNT(multiplications, 1);
+        MATRIX_LIBRARY_COUNT(flops, 2 * M * N * K);
+        if (beta != TData(1))
+        {
+            parallelRows(M, N, [&](const size_t row_begin, const size_t row_end)
+            {
+                for (size_t i = row_begin; i < row_end; ++i)
+                {
+                    TData *c_row = C.data() + i * C.stride();
+                    if (beta == TData(0))
+                    {
+                        std::fill(c_row, c_row + N, TData(0));
+                    }
+                    else
+                    {
+                        std::transform(c_row, c_row + N, c_row, [beta](const TData c) { return beta * c; });
+                    }
+                }
+            });
+        }
+        if (alpha != TData(0))
+        {
+            gemmUpdate(M, N, K, TData(alpha), A.data(), A.stride(), B.data(), B.stride(), C.data(), C.stride(), std::max<size_t>(n_threads, 1),
+                transposed_a, transposed_b);
+        }
+    }
+
+    /**
+     * gemm on whole matrices, see above.
+     */
+    template <typename TData>
+    void gemm(const typename Matrix<TData>::value_type alpha, const Matrix<TData> &A, const Transpose trans_a,
+        const Matrix<TData> &B, const Transpose trans_b, const typename Matrix<TData>::value_type beta, Matrix<TData> &C)
+    {
+        gemm<TData>(alpha, A.view(), trans_a, B.view(), trans_b, beta, C.view());
+    }
+
+    /**
+     * Computes A * B with both algorithms and reports how far the Strassen-Winograd result is from the classical one.
+     * Strassen trades some accuracy for fewer flops, the error grows with the number of recursion levels.
+     *
+     * @tparam TData float or double
+     * @param A n x n
+     * @param B n x n
+     * @param crossover Crossover size to use for the Strassen product, defaults to the current setting
+     * @return StrassenErrorReport
+     */
+    template <typename TData>
+    StrassenErrorReport measureStrassenError(const Matrix<TData> &A, const Matrix<TData> &B, const size_t crossover = strassen_crossover)
+    {
+        static_assert(std::is_floating_point<TData>::value, "Strassen multiplication is only available for float and double");
+        const size_t n = A.rows();
+        if (A.cols() != n || B.rows() != n || B.cols() != n)
+        {
+            throw std::invalid_argument("Strassen multiplication requires square matrices of the same size");
+        }
+
+        std::vector<TData> classical(n * n), fast(n * n);
+        gemmBlocked(n, n, n, TData(1), A.data(), A.stride(), B.data(), B.stride(), classical.data(), n);
+        strassenMultiply(n, A.data(), A.stride(), B.data(), B.stride(), fast.data(), n, crossover, std::max<size_t>(n_threads, 1));
+
+        StrassenErrorReport report{0.0, 0.0};
+        double diff_norm = 0.0, ref_norm = 0.0;
+        for (size_t i = 0; i < n * n; ++i)
+        {
+            const double diff = (double)fast[i] - (double)classical[i];
+            report.max_abs_error = std::max(report.max_abs_error, std::abs(diff));
+            diff_norm += diff * diff;
+            ref_norm += (double)classical[i] * (double)classical[i];
+        }
+        report.relative_error = (ref_norm > 0.0) ? std::sqrt(diff_norm / ref_norm) : std::sqrt(diff_norm);
+        return report;
+    }
+    /**
+     * Evaluates an operand of a product, Matrix and view operands are used directly without copying.
+     */
+    template <typename TData>
+    const Matrix<TData> &evaluateOperand(const Matrix<TData> &mat)
+    {
+        return mat;
+    }
+
+    template <typename TData>
+    ConstMatrixView<TData> evaluateOperand(const ConstMatrixView<TData> &view)
+    {
+        return view;
+    }
+
+    template <typename TData>
+    ConstMatrixView<TData> evaluateOperand(const MatrixView<TData> &view)
+    {
+        return view;
+    }
+
+    template <typename TDerived>
+    Matrix<typename TDerived::value_type> evaluateOperand(const MatrixExpr<TDerived> &expr)
+    {
+        return Matrix<typename TDerived::value_type>(expr.derived());
+    }
+
+    /**
+     * Evaluates an operand of a product as TResult, operands which already have that datatype are passed to
+     * evaluateOperand and others are converted into a new Matrix.
+     */
+    template <typename TResult, typename TDerived>
+    decltype(auto) promoteOperand(const MatrixExpr<TDerived> &expr)
+    {
+        if constexpr (std::is_same<typename TDerived::value_type, TResult>::value)
+        {
+            return evaluateOperand(expr.derived());
+        }
+        else
+        {
+            return Matrix<TResult>(expr.derived().template cast<TResult>());
+        }
+    }
+
+    /**
+     * Product of two operands of possibly different datatypes, computed in their PromotedType.
+     */
+    template <typename TLhs, typename TRhs>
+    Matrix<PromotedExprType<TLhs, TRhs>> multiplyPromoted(const MatrixExpr<TLhs> &lhs, const MatrixExpr<TRhs> &rhs)
+    {
+        using TResult = PromotedExprType<TLhs, TRhs>;
+        const auto &lhs_eval = promoteOperand<TResult>(lhs);
+        const auto &rhs_eval = promoteOperand<TResult>(rhs);
+        return multiply<TResult>(lhs_eval, rhs_eval);
+    }
+
+    template <typename T>
+    struct IsMatrix : std::false_type {};
+
+    template <typename TData>
+    struct IsMatrix<Matrix<TData>> : std::true_type {};
+
+    /**
+     * Overloaded * operator for products where the left operand is a view or an expression, e.g. A.block(0, 0, 2, 2) * B
+     * or (A + B) * C. Expression operands are evaluated once before the multiplication. Products with a Matrix on the left
+     * are handled by Matrix::operator*. Operands of different datatypes are promoted as in Matrix::operator*.
+     * @return A new Matrix holding the result
+     */
+    template <typename TLhs, typename TRhs, typename = typename std::enable_if<!IsMatrix<TLhs>::value>::type>
+    Matrix<PromotedExprType<TLhs, TRhs>> operator*(const MatrixExpr<TLhs> &lhs, const MatrixExpr<TRhs> &rhs)
+    {
+        return multiplyPromoted(lhs, rhs);
+    }
+
+    /**
+     * Accumulator datatype of multiplyWidened, wide enough that products of the narrow integer types do not overflow
+     * for typical inner dimensions.
+     */
+    template <typename TData>
+    struct WideAccumulator
+    {
+        using type = TData;
+    };
+
+    template <>
+    struct WideAccumulator<short>
+    {
+        using type = int;
+    };
+
+    template <>
+    struct WideAccumulator<int>
+    {
+        using type = long;
+    };
+
+    /**
+     * Multiplies two operands accumulating in a wider datatype than their own, e.g. Matrix<short> operands give a
+     * Matrix<int> result, where the plain product would silently overflow. Floating point operands are unaffected.
+     * @param lhs
+     * @param rhs
+     * @return A new Matrix holding the result
+     */
+    template <typename TLhs, typename TRhs>
+    Matrix<typename WideAccumulator<PromotedExprType<TLhs, TRhs>>::type> multiplyWidened(const MatrixExpr<TLhs> &lhs, const MatrixExpr<TRhs> &rhs)
+    {
+        using TWide = typename WideAccumulator<PromotedExprType<TLhs, TRhs>>::type;
+        const auto &lhs_eval = promoteOperand<TWide>(lhs);
+        const auto &rhs_eval = promoteOperand<TWide>(rhs);
+        return multiply<TWide>(lhs_eval, rhs_eval);
+    }
+
     static void setNumThreads(const size_t n_threads_)
     {
         n_threads = n_threads_;
     }
 
-    static void setPrintMemoryInfo(const bool printMemoryInfo_)
+    /**
+     * Constructors and assignments no longer print messages. Copies, moves and allocations are counted by the
+     * instrumentation in instrumentation.hpp instead, see getStats().
+     */
+    [[deprecated("Use getStats() with MATRIX_LIBRARY_ENABLE_STATS instead")]]
+    inline void setPrintMemoryInfo(const bool)
     {
-        printMemoryInfo = printMemoryInfo_;
     }
 
     template class Matrix<int>;
@@ -0,0 +1,315 @@
+/**
+ * @file matrix_view.hpp
+ * @author Alex Liu (alex.liuyining@outlook.com)
+ * @brief Non-owning views into the data of a Matrix, used for slicing blocks, rows and columns without copying
+ * @date 2021-12
+ */
+
+#ifndef MATRIX_VIEW_HPP
+#define MATRIX_VIEW_HPP
+
+#include <cassert>
+#include <stdexcept>
+#include "matrix_expression.hpp"
+
+namespace MatrixLibrary
+{
+    template <typename TData>
+    class Matrix;
+
+    template <typename TExpr, typename TData, typename TAssign>
+    void evaluateRowsParallel(const TExpr &expr, TData *dst, const size_t ld, const size_t rows, TAssign assign);
+
+    /**
+     * Read-only view of a rows x cols block of row-major data with a given row stride. The view does not own
+     * the data, which must outlive it. Views take part in Matrix expressions and products like a Matrix does.
+     *
+     * @tparam TData
+     */
+    template <typename TData>
+    class ConstMatrixView : public MatrixExpr<ConstMatrixView<TData>>
+    {
+    public:
+        using value_type = TData;
+
+        /**
+         * Constructor from raw row-major data.
+         *  @param data Pointer to the top left element
+         *  @param rows
+         *  @param cols
+         *  @param stride Row stride of the data, at least cols
+         */
+        ConstMatrixView(const TData *data, const size_t rows, const size_t cols, const size_t stride):
+            m_data(data), m_rows(rows), m_cols(cols), m_stride(stride)
+        {
+            assert(stride >= cols && "Stride must be at least the number of columns");
+        }
+
+        /**
+         * View of a whole Matrix.
+         *  @param mat
+         */
+        ConstMatrixView(const Matrix<TData> &mat): ConstMatrixView(mat.data(), mat.rows(), mat.cols(), mat.stride()) {}
+
+        size_t rows() const
+        {
+            return m_rows;
+        }
+
+        size_t cols() const
+        {
+            return m_cols;
+        }
+
+        size_t stride() const
+        {
+            return m_stride;
+        }
+
+        const TData *data() const
+        {
+            return m_data;
+        }
+
+        const TData &operator()(const size_t i, const size_t j) const
+        {
+            return m_data[i * m_stride + j];
+        }
+
+        /**
+         * View of the h x w block whose top left element is (r, c).
+         */
+        ConstMatrixView block(const size_t r, const size_t c, const size_t h, const size_t w) const
+        {
+            if (r + h > m_rows || c + w > m_cols)
+            {
+                throw std::out_of_range("Block exceeds the dimensions of the matrix");
+            }
+            return ConstMatrixView(m_data + r * m_stride + c, h, w, m_stride);
+        }
+
+        /**
+         * View of row i as a 1 x cols block.
+         */
+        ConstMatrixView row(const size_t i) const
+        {
+            return block(i, 0, 1, m_cols);
+        }
+
+        /**
+         * View of column j as a rows x 1 block.
+         */
+        ConstMatrixView col(const size_t j) const
+        {
+            return block(0, j, m_rows, 1);
+        }
+
+        /*
+         * Expression interface, see matrix_expression.hpp
+         */
+
+        TData coeff(const size_t i, const size_t j) const
+        {
+            return m_data[i * m_stride + j];
+        }
+
+        bool aliases(const void *begin, const void *end) const
+        {
+            if (m_rows == 0 || m_cols == 0)
+            {
+                return false;
+            }
+            return (const void *)m_data < end && begin < (const void *)(m_data + (m_rows - 1) * m_stride + m_cols);
+        }
+
+        // A view starting anywhere else than the destination reads elements other than the one being written
+        bool transposeAliases(const void *begin, const void *end) const
+        {
+            return aliases(begin, end) && (const void *)m_data != begin;
+        }
+
+    private:
+        const TData *m_data;
+        size_t m_rows;
+        size_t m_cols;
+        size_t m_stride;
+    };
+
+    /**
+     * Mutable view of a rows x cols block of row-major data with a given row stride. Assigning an expression
+     * to a view writes into the viewed data, so e.g. mat.block(0, 0, 2, 2) = A + B updates mat in place.
+     *
+     * @tparam TData
+     */
+    template <typename TData>
+    class MatrixView : public MatrixExpr<MatrixView<TData>>
+    {
+    public:
+        using value_type = TData;
+
+        /**
+         * Constructor from raw row-major data.
+         *  @param data Pointer to the top left element
+         *  @param rows
+         *  @param cols
+         *  @param stride Row stride of the data, at least cols
+         */
+        MatrixView(TData *data, const size_t rows, const size_t cols, const size_t stride):
+            m_data(data), m_rows(rows), m_cols(cols), m_stride(stride)
+        {
+            assert(stride >= cols && "Stride must be at least the number of columns");
+        }
+
+        /**
+         * View of a whole Matrix.
+         *  @param mat
+         */
+        MatrixView(Matrix<TData> &mat): MatrixView(mat.data(), mat.rows(), mat.cols(), mat.stride()) {}
+
+        MatrixView(const MatrixView &source) = default;
+
+        /**
+         * Copies the elements of another view into the data viewed by this one, the dimensions must match.
+         */
+        MatrixView &operator=(const MatrixView &source)
+        {
+            return assign(source, AssignOp());
+        }
+
+        /**
+         * Evaluates an expression into the data viewed by this one, the dimensions must match.
+         */
+        template <typename TDerived>
+        MatrixView &operator=(const MatrixExpr<TDerived> &expr)
+        {
+            return assign(expr.derived(), AssignOp());
+        }
+
+        template <typename TDerived>
+        MatrixView &operator+=(const MatrixExpr<TDerived> &expr)
+        {
+            return assign(expr.derived(), AddAssignOp());
+        }
+
+        template <typename TDerived>
+        MatrixView &operator-=(const MatrixExpr<TDerived> &expr)
+        {
+            return assign(expr.derived(), SubtractAssignOp());
+        }
+
+        MatrixView &operator*=(const TData scalar)
+        {
+            evaluateRowsParallel((*this) * scalar, m_data, m_stride, m_rows, AssignOp());
+            return *this;
+        }
+
+        operator ConstMatrixView<TData>() const
+        {
+            return ConstMatrixView<TData>(m_data, m_rows, m_cols, m_stride);
+        }
+
+        size_t rows() const
+        {
+            return m_rows;
+        }
+
+        size_t cols() const
+        {
+            return m_cols;
+        }
+
+        size_t stride() const
+        {
+            return m_stride;
+        }
+
+        TData *data() const
+        {
+            return m_data;
+        }
+
+        TData &operator()(const size_t i, const size_t j) const
+        {
+            return m_data[i * m_stride + j];
+        }
+
+        /**
+         * View of the h x w block whose top left element is (r, c).
+         */
+        MatrixView block(const size_t r, const size_t c, const size_t h, const size_t w) const
+        {
+            if (r + h > m_rows || c + w > m_cols)
+            {
+                throw std::out_of_range("Block exceeds the dimensions of the matrix");
+            }
+            return MatrixView(m_data + r * m_stride + c, h, w, m_stride);
+        }
+
+        /**
+         * View of row i as a 1 x cols block.
+         */
+        MatrixView row(const size_t i) const
+        {
+            return block(i, 0, 1, m_cols);
+        }
+
+        /**
+         * View of column j as a rows x 1 block.
+         */
+        MatrixView col(const size_t j) const
+        {
+            return block(0, j, m_rows, 1);
+        }
+
+        /*
+         * Expression interface, see matrix_expression.hpp
+         */
+
+        TData coeff(const size_t i, const size_t j) const
+        {
+            return m_data[i * m_stride + j];
+        }
+
+        bool aliases(const void *begin, const void *end) const
+        {
+            return ConstMatrixView<TData>(*this).aliases(begin, end);
+        }
+
+        bool transposeAliases(const void *begin, const void *end) const
+        {
+            return ConstMatrixView<TData>(*this).transposeAliases(begin, end);
+        }
+
+    private:
+        template <typename TExpr, typename TAssign>
+        MatrixView &assign(const TExpr &expr, TAssign assign_op)
+        {
+            static_assert(IsPromotable<typename TExpr::value_type, TData>::value,
+                "Expression datatype does not convert implicitly to the datatype of the view, use cast<T>()");
+            assert(m_rows == expr.rows() && m_cols == expr.cols() && "Two matrices must have the same dimensions");
+            if (m_rows == 0 || m_cols == 0)
+            {
+                return *this;
+            }
+            const void *begin = m_data;
+            const void *end = m_data + (m_rows - 1) * m_stride + m_cols;
+            if (expr.transposeAliases(begin, end))
+            {
+                const Matrix<TData> evaluated(expr);
+                evaluateRowsParallel(evaluated, m_data, m_stride, m_rows, assign_op);
+            }
+            else
+            {
+                evaluateRowsParallel(expr, m_data, m_stride, m_rows, assign_op);
+            }
+            return *this;
+        }
+
+        TData *m_data;
+        size_t m_rows;
+        size_t m_cols;
+        size_t m_stride;
+    };
+} // end namespace MatrixLibrary
+
+#endif // #ifndef MATRIX_VIEW_HPP
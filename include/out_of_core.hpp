@@ -0,0 +1,266 @@
+/**
+ * @file out_of_core.hpp
+ * @author Alex Liu (alex.liuyining@outlook.com)
+ * @brief Multiplication of file-backed matrices larger than memory, streaming tiles within a memory budget
+ * @date 2021-12
+ */
+
+#ifndef OUT_OF_CORE_HPP
+#define OUT_OF_CORE_HPP
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <future>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include "matrix_library.hpp"
+#include "matrix_io.hpp"
+#include "concurrency_utils.hpp"
+
+namespace MatrixLibrary
+{
+    // Default upper bound, in bytes, on the tile buffers of an out-of-core multiplication
+    inline size_t out_of_core_memory_budget = size_t(256) << 20;
+
+    inline void setOutOfCoreMemoryBudget(const size_t out_of_core_memory_budget_)
+    {
+        out_of_core_memory_budget = out_of_core_memory_budget_;
+    }
+
+    /**
+     * Tile sizes of an out-of-core M x K by K x N product: the result is computed tile_rows x tile_cols at a time,
+     * accumulating over chunks of tile_depth along the inner dimension.
+     */
+    struct OutOfCorePlan
+    {
+        size_t tile_rows;
+        size_t tile_cols;
+        size_t tile_depth;
+    };
+
+    /**
+     * Chooses tile sizes such that the double-buffered tiles of A, B and the result fit in the memory budget,
+     * i.e. 2 * (tile_rows * tile_depth + tile_depth * tile_cols + tile_rows * tile_cols) elements. Tiles are square
+     * where the dimensions allow, and any budget left by a small dimension goes to the inner dimension.
+     *
+     * @tparam TData
+     * @param M
+     * @param N
+     * @param K
+     * @param memory_budget In bytes
+     * @return OutOfCorePlan
+     * @throw std::invalid_argument if the budget cannot hold a single element of each buffer
+     */
+    template <typename TData>
+    OutOfCorePlan planOutOfCore(const size_t M, const size_t N, const size_t K, const size_t memory_budget)
+    {
+        const size_t budget_elements = memory_budget / sizeof(TData);
+        if (budget_elements < 6)
+        {
+            throw std::invalid_argument("Memory budget is too small for an out-of-core multiplication");
+        }
+
+        const size_t side = std::max<size_t>((size_t)std::sqrt((double)budget_elements / 6.0), 1);
+        OutOfCorePlan plan;
+        plan.tile_rows = std::min(side, M);
+        plan.tile_cols = std::min(side, N);
+        const size_t remaining = budget_elements / 2 - plan.tile_rows * plan.tile_cols;
+        plan.tile_depth = std::max<size_t>(std::min(remaining / (plan.tile_rows + plan.tile_cols), K), 1);
+        return plan;
+    }
+
+    /**
+     * Reads the h x w block whose top left element is (row, col) from a matrix file into dst.
+     */
+    template <typename TData>
+    void readTile(std::ifstream &file, const MatrixFileHeader &header, const size_t row, const size_t col, const size_t h, const size_t w,
+        TData *dst, const size_t ld)
+    {
+        for (size_t i = 0; i < h; ++i)
+        {
+            file.seekg(header.data_offset + ((row + i) * header.stride + col) * sizeof(TData));
+            if (!file.read(reinterpret_cast<char *>(dst + i * ld), w * sizeof(TData)))
+            {
+                throw std::runtime_error("Could not read a tile of a matrix file");
+            }
+        }
+    }
+
+    /**
+     * Writes an h x w block to the location of element (row, col) of a matrix file.
+     */
+    template <typename TData>
+    void writeTile(std::fstream &file, const MatrixFileHeader &header, const size_t row, const size_t col, const size_t h, const size_t w,
+        const TData *src, const size_t ld)
+    {
+        for (size_t i = 0; i < h; ++i)
+        {
+            file.seekp(header.data_offset + ((row + i) * header.stride + col) * sizeof(TData));
+            if (!file.write(reinterpret_cast<const char *>(src + i * ld), w * sizeof(TData)))
+            {
+                throw std::runtime_error("Could not write a tile of a matrix file");
+            }
+        }
+    }
+
+    /**
+     * Multiplies two matrices stored in files written by saveMatrix, and writes the result to a new file, without ever
+     * holding more than the memory budget of tile data. Result tiles are computed one at a time by accumulating products
+     * of tiles of A and B read from disk. The tiles for the next step are read on a separate I/O thread while the current
+     * ones are multiplied, and finished result tiles are written back on that thread while the next tile is computed.
+     * Tile products use multithreading depending on the n_threads setting.
+     *
+     * @tparam TData
+     * @param lhs_path File holding the M x K left operand
+     * @param rhs_path File holding the K x N right operand
+     * @param result_path File to create holding the M x N result
+     * @param memory_budget Upper bound in bytes on the tile buffers, defaults to the out_of_core_memory_budget setting
+     * @throw std::runtime_error on I/O errors or mismatched datatypes, std::invalid_argument on mismatched dimensions
+     */
+    template <typename TData>
+    void multiplyOutOfCore(const std::string &lhs_path, const std::string &rhs_path, const std::string &result_path,
+        const size_t memory_budget = out_of_core_memory_budget)
+    {
+        const MatrixFileHeader lhs_header = readMatrixHeader(lhs_path);
+        const MatrixFileHeader rhs_header = readMatrixHeader(rhs_path);
+        checkHeaderType<TData>(lhs_header, lhs_path);
+        checkHeaderType<TData>(rhs_header, rhs_path);
+        if (lhs_header.endianness != hostEndianness() || rhs_header.endianness != hostEndianness())
+        {
+            throw std::runtime_error("Out-of-core operands must be stored in the byte order of the host");
+        }
+        if (lhs_header.cols != rhs_header.rows)
+        {
+            throw std::invalid_argument("First matrix's cols must match second matrix's rows");
+        }
+
+        const size_t M = lhs_header.rows, K = lhs_header.cols, N = rhs_header.cols;
+
+        // Create the result file at its full size, zero-filled, tiles are then written in place
+        const MatrixFileHeader result_header = makeMatrixHeader<TData>(M, N);
+        {
+            std::ofstream create(result_path, std::ios::binary | std::ios::trunc);
+            create.write(reinterpret_cast<const char *>(&result_header), sizeof(result_header));
+            if (M * N > 0)
+            {
+                create.seekp(result_header.data_offset + M * N * sizeof(TData) - 1);
+                create.put('\0');
+            }
+            if (!create)
+            {
+                throw std::runtime_error("Could not create " + result_path);
+            }
+        }
+
+        // An empty product leaves the result empty, or zero when only the inner dimension is empty
+        if (M == 0 || N == 0 || K == 0)
+        {
+            return;
+        }
+
+        const OutOfCorePlan plan = planOutOfCore<TData>(M, N, K, memory_budget);
+        const size_t tiles_m = (M + plan.tile_rows - 1) / plan.tile_rows;
+        const size_t tiles_n = (N + plan.tile_cols - 1) / plan.tile_cols;
+        const size_t tiles_k = (K + plan.tile_depth - 1) / plan.tile_depth;
+        const size_t n_steps = tiles_m * tiles_n * tiles_k;
+
+        std::ifstream lhs_file(lhs_path, std::ios::binary);
+        std::ifstream rhs_file(rhs_path, std::ios::binary);
+        std::fstream result_file(result_path, std::ios::binary | std::ios::in | std::ios::out);
+
+        // Step s computes chunk s % tiles_k of result tile s / tiles_k, tiles are visited in row-major order
+        struct Step
+        {
+            size_t row, col, depth, rows, cols, inner;
+            bool first, last;
+        };
+        auto step = [&](const size_t s)
+        {
+            const size_t tile = s / tiles_k, kp = s % tiles_k;
+            Step st;
+            st.row = (tile / tiles_n) * plan.tile_rows;
+            st.col = (tile % tiles_n) * plan.tile_cols;
+            st.depth = kp * plan.tile_depth;
+            st.rows = std::min(plan.tile_rows, M - st.row);
+            st.cols = std::min(plan.tile_cols, N - st.col);
+            st.inner = std::min(plan.tile_depth, K - st.depth);
+            st.first = (kp == 0);
+            st.last = (kp == tiles_k - 1);
+            return st;
+        };
+
+        std::vector<TData> lhs_tiles[2], rhs_tiles[2], result_tiles[2];
+        for (size_t b = 0; b < 2; ++b)
+        {
+            lhs_tiles[b].resize(plan.tile_rows * plan.tile_depth);
+            rhs_tiles[b].resize(plan.tile_depth * plan.tile_cols);
+            result_tiles[b].resize(plan.tile_rows * plan.tile_cols);
+        }
+
+        // I/O runs on its own thread rather than the pool, so that blocking reads never hold up compute workers
+        auto load = [&](const size_t s)
+        {
+            const Step st = step(s);
+            readTile(lhs_file, lhs_header, st.row, st.depth, st.rows, st.inner, lhs_tiles[s % 2].data(), st.inner);
+            readTile(rhs_file, rhs_header, st.depth, st.col, st.inner, st.cols, rhs_tiles[s % 2].data(), st.cols);
+        };
+        std::future<void> pending_load = std::async(std::launch::async, load, 0);
+        std::future<void> pending_write;
+        size_t result_buffer = 0;
+
+        for (size_t s = 0; s < n_steps; ++s)
+        {
+            pending_load.get();
+            if (s + 1 < n_steps)
+            {
+                pending_load = std::async(std::launch::async, load, s + 1);
+            }
+
+            const Step st = step(s);
+            TData *result_tile = result_tiles[result_buffer].data();
+            if (st.first)
+            {
+                std::fill(result_tile, result_tile + st.rows * st.cols, TData(0));
+            }
+
+            const TData *lhs_tile = lhs_tiles[s % 2].data();
+            const TData *rhs_tile = rhs_tiles[s % 2].data();
+            if (n_threads <= 1)
+            {
+                computeGivenRows(result_tile, st.cols, 0, st.rows, lhs_tile, st.inner, rhs_tile, st.cols, st.inner, st.cols);
+            }
+            else
+            {
+                multiplyMatricesAsync(result_tile, st.cols, lhs_tile, st.inner, rhs_tile, st.cols, st.rows, st.inner, st.cols, n_threads);
+            }
+
+            if (st.last)
+            {
+                // Only one write is in flight at a time, which also guarantees the other result buffer is free again
+                if (pending_write.valid())
+                {
+                    pending_write.get();
+                }
+                pending_write = std::async(std::launch::async, [&, st, result_tile]()
+                {
+                    writeTile(result_file, result_header, st.row, st.col, st.rows, st.cols, result_tile, st.cols);
+                });
+                result_buffer ^= 1;
+            }
+        }
+
+        if (pending_write.valid())
+        {
+            pending_write.get();
+        }
+        result_file.flush();
+        if (!result_file)
+        {
+            throw std::runtime_error("Could not write " + result_path);
+        }
+    }
+} // end namespace MatrixLibrary
+
+#endif // #ifndef OUT_OF_CORE_HPP
@@ -0,0 +1,667 @@
+/**
+ * @file quantized_gemm.hpp
+ * @author Alex Liu (alex.liuyining@outlook.com)
+ * @brief Quantized int8/int16 matrices and their multiplication with int32 accumulation, using pmaddwd and VNNI
+ * @date 2021-12
+ */
+
+#ifndef QUANTIZED_GEMM_HPP
+#define QUANTIZED_GEMM_HPP
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include "simd_kernels.hpp"
+#include "concurrency_utils.hpp"
+#include "matrix_allocator.hpp"
+#include "matrix_library.hpp"
+
+namespace MatrixLibrary
+{
+    /**
+     * Affine mapping between real values and quantized integers, real = scale * (quantized - zero_point).
+     * The zero point is the quantized value representing 0 exactly.
+     */
+    struct QuantizationParams
+    {
+        float scale = 1.0f;
+        int32_t zero_point = 0;
+    };
+
+    /**
+     * Row-major matrix of int8_t or int16_t values sharing one set of quantization parameters.
+     *
+     * @tparam TQuant int8_t or int16_t
+     */
+    template <typename TQuant>
+    class QuantizedMatrix
+    {
+    public:
+        static_assert(std::is_same<TQuant, int8_t>::value || std::is_same<TQuant, int16_t>::value,
+            "Quantized matrices hold int8_t or int16_t values");
+
+        using value_type = TQuant;
+
+        QuantizedMatrix(const size_t rows, const size_t cols, const QuantizationParams params = QuantizationParams()):
+            m_data(rows * cols, TQuant(0)), m_rows(rows), m_cols(cols), m_params(params)
+        {
+        }
+
+        /**
+         * @param rows
+         * @param cols
+         * @param data Row-major quantized values
+         * @param params
+         * @throw std::invalid_argument if data does not hold rows * cols values
+         */
+        QuantizedMatrix(const size_t rows, const size_t cols, const std::vector<TQuant> &data, const QuantizationParams params):
+            m_data(data.begin(), data.end()), m_rows(rows), m_cols(cols), m_params(params)
+        {
+            if (data.size() != rows * cols)
+            {
+                throw std::invalid_argument("Data size does not match the dimensions of the matrix");
+            }
+        }
+
+        size_t rows() const
+        {
+            return m_rows;
+        }
+
+        size_t cols() const
+        {
+            return m_cols;
+        }
+
+        size_t stride() const
+        {
+            return m_cols;
+        }
+
+        const TQuant *data() const
+        {
+            return m_data.data();
+        }
+
+        TQuant *data()
+        {
+            return m_data.data();
+        }
+
+        const QuantizationParams &params() const
+        {
+            return m_params;
+        }
+
+        TQuant operator()(const size_t i, const size_t j) const
+        {
+            return m_data[i * m_cols + j];
+        }
+
+        TQuant &operator()(const size_t i, const size_t j)
+        {
+            return m_data[i * m_cols + j];
+        }
+
+    private:
+        MatrixBuffer<TQuant> m_data;
+        size_t m_rows;
+        size_t m_cols;
+        QuantizationParams m_params;
+    };
+
+    /**
+     * Parameters mapping the real range [min_value, max_value], widened to include 0, onto the full range of TQuant.
+     *
+     * @tparam TQuant
+     * @param min_value
+     * @param max_value
+     * @return QuantizationParams
+     */
+    template <typename TQuant>
+    QuantizationParams chooseQuantizationParams(const float min_value, const float max_value)
+    {
+        const float q_min = (float)std::numeric_limits<TQuant>::min();
+        const float q_max = (float)std::numeric_limits<TQuant>::max();
+        const float lo = std::min(min_value, 0.0f);
+        const float hi = std::max(max_value, 0.0f);
+
+        QuantizationParams params;
+        params.scale = (hi > lo) ? (hi - lo) / (q_max - q_min) : 1.0f;
+        params.zero_point = (int32_t)std::min(std::max(std::round(q_min - lo / params.scale), q_min), q_max);
+        return params;
+    }
+
+    // Rounds a real value to the nearest quantized value, saturating at the limits of TQuant
+    template <typename TQuant>
+    TQuant quantizeValue(const float value, const QuantizationParams &params)
+    {
+        const float q = std::round(value / params.scale) + (float)params.zero_point;
+        return (TQuant)std::min(std::max(q, (float)std::numeric_limits<TQuant>::min()), (float)std::numeric_limits<TQuant>::max());
+    }
+
+    /**
+     * Quantizes a Matrix, view or expression with the given parameters.
+     *
+     * @tparam TQuant int8_t or int16_t
+     * @param expr
+     * @param params
+     * @return QuantizedMatrix<TQuant>
+     */
+    template <typename TQuant, typename TDerived>
+    QuantizedMatrix<TQuant> quantize(const MatrixExpr<TDerived> &expr, const QuantizationParams params)
+    {
+        const auto &source = evaluateOperand(expr.derived());
+        QuantizedMatrix<TQuant> result(source.rows(), source.cols(), params);
+        for (size_t i = 0; i < source.rows(); ++i)
+        {
+            for (size_t j = 0; j < source.cols(); ++j)
+            {
+                result(i, j) = quantizeValue<TQuant>((float)source.coeff(i, j), params);
+            }
+        }
+        return result;
+    }
+
+    /**
+     * Quantizes a Matrix, view or expression with parameters covering the range of its values.
+     *
+     * @tparam TQuant int8_t or int16_t
+     * @param expr
+     * @return QuantizedMatrix<TQuant>
+     */
+    template <typename TQuant, typename TDerived>
+    QuantizedMatrix<TQuant> quantize(const MatrixExpr<TDerived> &expr)
+    {
+        const auto &source = evaluateOperand(expr.derived());
+        float min_value = 0.0f, max_value = 0.0f;
+        for (size_t i = 0; i < source.rows(); ++i)
+        {
+            for (size_t j = 0; j < source.cols(); ++j)
+            {
+                min_value = std::min(min_value, (float)source.coeff(i, j));
+                max_value = std::max(max_value, (float)source.coeff(i, j));
+            }
+        }
+        return quantize<TQuant>(source, chooseQuantizationParams<TQuant>(min_value, max_value));
+    }
+
+    /**
+     * Converts a quantized matrix back to real values.
+     *
+     * @param mat
+     * @return Matrix<float>
+     */
+    template <typename TQuant>
+    Matrix<float> dequantize(const QuantizedMatrix<TQuant> &mat)
+    {
+        Matrix<float> result(mat.rows(), mat.cols());
+        const QuantizationParams &params = mat.params();
+        for (size_t i = 0; i < mat.rows(); ++i)
+        {
+            for (size_t j = 0; j < mat.cols(); ++j)
+            {
+                result(i, j) = params.scale * (float)((int32_t)mat(i, j) - params.zero_point);
+            }
+        }
+        return result;
+    }
+
+    /*
+     * Packed layouts of the quantized kernels. B is packed into panels of quantized_nr columns in which the values of
+     * consecutive k are interleaved, pairs of int16 for pmaddwd style kernels and quads of int8 for VNNI dpbusd, so that
+     * one register load holds the pairs or quads of quantized_nr columns. A is packed row by row, widened to int16 for
+     * pairs, or shifted by +128 to uint8 for quads since dpbusd multiplies unsigned by signed bytes.
+     */
+
+    static constexpr size_t quantized_mr = 4;
+    static constexpr size_t quantized_nr = 32;
+    static constexpr size_t quantized_mc = 64;
+    static constexpr size_t quantized_kc = 512;
+
+    // Offset added to int8 values of A packed as quads, removed again in the zero point correction
+    static constexpr int32_t quantized_quad_shift = 128;
+
+    enum class QuantizedKernel
+    {
+        Generic,
+        Avx2Pairs,
+        Avx512Pairs,
+        VnniPairs,
+        VnniQuads
+    };
+
+    /**
+     * Kernel used for quantized products of TQuant on the host, depending on the simd_level setting and the
+     * AVX-512 BW/VNNI extensions. int8 products use quads only with VNNI, and are widened to pairs otherwise.
+     */
+    template <typename TQuant>
+    QuantizedKernel selectQuantizedKernel()
+    {
+#if MATRIX_LIBRARY_X86_SIMD
+        switch (simd_level)
+        {
+        case SimdLevel::AVX512:
+            if (has_avx512_vnni)
+            {
+                return std::is_same<TQuant, int8_t>::value ? QuantizedKernel::VnniQuads : QuantizedKernel::VnniPairs;
+            }
+            if (has_avx512_bw)
+            {
+                return QuantizedKernel::Avx512Pairs;
+            }
+            return QuantizedKernel::Avx2Pairs;
+        case SimdLevel::AVX2:
+            return QuantizedKernel::Avx2Pairs;
+        default:
+            break;
+        }
+#endif
+        return QuantizedKernel::Generic;
+    }
+
+    /**
+     * Packs A into rows of depth values of TPacked, with the values of each row shifted by shift, and computes the
+     * sum of the original values of every row.
+     */
+    template <typename TPacked, typename TQuant>
+    void packQuantizedA(const size_t M, const size_t K, const size_t depth, const TQuant *A, const size_t lda, const int32_t shift,
+        TPacked *packed, int32_t *row_sums)
+    {
+        for (size_t i = 0; i < M; ++i)
+        {
+            int32_t sum = 0;
+            TPacked *dst = packed + i * depth;
+            for (size_t k = 0; k < K; ++k)
+            {
+                sum += A[i * lda + k];
+                dst[k] = (TPacked)(A[i * lda + k] + shift);
+            }
+            std::fill(dst + K, dst + depth, (TPacked)shift);
+            row_sums[i] = sum;
+        }
+    }
+
+    /**
+     * Packs the panel of B starting at column col into groups of Group consecutive k per column, padded with zeros,
+     * and computes the sum of every column of the panel.
+     */
+    template <size_t Group, typename TPacked, typename TQuant>
+    void packQuantizedPanel(const size_t N, const size_t K, const size_t depth, const TQuant *B, const size_t ldb, const size_t col,
+        TPacked *packed, int32_t *col_sums)
+    {
+        const size_t nr = std::min(quantized_nr, N - col);
+        for (size_t j = 0; j < quantized_nr; ++j)
+        {
+            int32_t sum = 0;
+            for (size_t k = 0; k < depth; ++k)
+            {
+                const TQuant value = (j < nr && k < K) ? B[k * ldb + col + j] : TQuant(0);
+                sum += value;
+                packed[(k / Group) * quantized_nr * Group + j * Group + k % Group] = (TPacked)value;
+            }
+            if (j < nr)
+            {
+                col_sums[col + j] = sum;
+            }
+        }
+    }
+
+    /*
+     * Micro-kernels adding the raw int32 sums of a quantized_mr x quantized_nr tile over a chunk of depth values,
+     * i.e. tile[r][j] += sum_k a_rows[r][k] * panel(k, j), into a row-major array.
+     */
+
+    inline void quantizedTilePairs(const size_t depth, const int16_t *const *a_rows, const int16_t *panel, int32_t *tile)
+    {
+        for (size_t kk = 0; kk < depth / 2; ++kk)
+        {
+            const int16_t *b = panel + kk * quantized_nr * 2;
+            for (size_t r = 0; r < quantized_mr; ++r)
+            {
+                const int32_t a0 = a_rows[r][2 * kk], a1 = a_rows[r][2 * kk + 1];
+                for (size_t j = 0; j < quantized_nr; ++j)
+                {
+                    tile[r * quantized_nr + j] += a0 * b[2 * j] + a1 * b[2 * j + 1];
+                }
+            }
+        }
+    }
+
+#if MATRIX_LIBRARY_X86_SIMD
+    // Broadcast of the 4 bytes holding a pair of int16 or a quad of int8
+    MATRIX_LIBRARY_ALWAYS_INLINE inline int32_t loadGroup(const void *p)
+    {
+        int32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    MATRIX_LIBRARY_TARGET("avx2")
+    inline void quantizedTilePairsAvx2(const size_t depth, const int16_t *const *a_rows, const int16_t *panel, int32_t *tile)
+    {
+        // The 32 columns are done as two halves, a whole tile would need more than the 16 ymm registers
+        for (size_t half = 0; half < 2; ++half)
+        {
+            __m256i acc[quantized_mr][2];
+            for (size_t r = 0; r < quantized_mr; ++r)
+            {
+                acc[r][0] = _mm256_loadu_si256((const __m256i *)(tile + r * quantized_nr + half * 16));
+                acc[r][1] = _mm256_loadu_si256((const __m256i *)(tile + r * quantized_nr + half * 16 + 8));
+            }
+            for (size_t kk = 0; kk < depth / 2; ++kk)
+            {
+                const int16_t *b = panel + kk * quantized_nr * 2 + half * quantized_nr;
+                const __m256i b0 = _mm256_loadu_si256((const __m256i *)b);
+                const __m256i b1 = _mm256_loadu_si256((const __m256i *)(b + 16));
+                for (size_t r = 0; r < quantized_mr; ++r)
+                {
+                    const __m256i a = _mm256_set1_epi32(loadGroup(a_rows[r] + 2 * kk));
+                    acc[r][0] = _mm256_add_epi32(acc[r][0], _mm256_madd_epi16(a, b0));
+                    acc[r][1] = _mm256_add_epi32(acc[r][1], _mm256_madd_epi16(a, b1));
+                }
+            }
+            for (size_t r = 0; r < quantized_mr; ++r)
+            {
+                _mm256_storeu_si256((__m256i *)(tile + r * quantized_nr + half * 16), acc[r][0]);
+                _mm256_storeu_si256((__m256i *)(tile + r * quantized_nr + half * 16 + 8), acc[r][1]);
+            }
+        }
+    }
+
+    MATRIX_LIBRARY_TARGET("avx512f,avx512bw")
+    inline void quantizedTilePairsAvx512(const size_t depth, const int16_t *const *a_rows, const int16_t *panel, int32_t *tile)
+    {
+        __m512i acc[quantized_mr][2];
+        for (size_t r = 0; r < quantized_mr; ++r)
+        {
+            acc[r][0] = _mm512_loadu_si512(tile + r * quantized_nr);
+            acc[r][1] = _mm512_loadu_si512(tile + r * quantized_nr + 16);
+        }
+        for (size_t kk = 0; kk < depth / 2; ++kk)
+        {
+            const int16_t *b = panel + kk * quantized_nr * 2;
+            const __m512i b0 = _mm512_loadu_si512(b);
+            const __m512i b1 = _mm512_loadu_si512(b + 32);
+            for (size_t r = 0; r < quantized_mr; ++r)
+            {
+                const __m512i a = _mm512_set1_epi32(loadGroup(a_rows[r] + 2 * kk));
+                acc[r][0] = _mm512_add_epi32(acc[r][0], _mm512_madd_epi16(a, b0));
+                acc[r][1] = _mm512_add_epi32(acc[r][1], _mm512_madd_epi16(a, b1));
+            }
+        }
+        for (size_t r = 0; r < quantized_mr; ++r)
+        {
+            _mm512_storeu_si512(tile + r * quantized_nr, acc[r][0]);
+            _mm512_storeu_si512(tile + r * quantized_nr + 16, acc[r][1]);
+        }
+    }
+
+    MATRIX_LIBRARY_TARGET("avx512f,avx512bw,avx512vnni")
+    inline void quantizedTilePairsVnni(const size_t depth, const int16_t *const *a_rows, const int16_t *panel, int32_t *tile)
+    {
+        __m512i acc[quantized_mr][2];
+        for (size_t r = 0; r < quantized_mr; ++r)
+        {
+            acc[r][0] = _mm512_loadu_si512(tile + r * quantized_nr);
+            acc[r][1] = _mm512_loadu_si512(tile + r * quantized_nr + 16);
+        }
+        for (size_t kk = 0; kk < depth / 2; ++kk)
+        {
+            const int16_t *b = panel + kk * quantized_nr * 2;
+            const __m512i b0 = _mm512_loadu_si512(b);
+            const __m512i b1 = _mm512_loadu_si512(b + 32);
+            for (size_t r = 0; r < quantized_mr; ++r)
+            {
+                const __m512i a = _mm512_set1_epi32(loadGroup(a_rows[r] + 2 * kk));
+                acc[r][0] = _mm512_dpwssd_epi32(acc[r][0], a, b0);
+                acc[r][1] = _mm512_dpwssd_epi32(acc[r][1], a, b1);
+            }
+        }
+        for (size_t r = 0; r < quantized_mr; ++r)
+        {
+            _mm512_storeu_si512(tile + r * quantized_nr, acc[r][0]);
+            _mm512_storeu_si512(tile + r * quantized_nr + 16, acc[r][1]);
+        }
+    }
+
+    MATRIX_LIBRARY_TARGET("avx512f,avx512bw,avx512vnni")
+    inline void quantizedTileQuadsVnni(const size_t depth, const uint8_t *const *a_rows, const int8_t *panel, int32_t *tile)
+    {
+        __m512i acc[quantized_mr][2];
+        for (size_t r = 0; r < quantized_mr; ++r)
+        {
+            acc[r][0] = _mm512_loadu_si512(tile + r * quantized_nr);
+            acc[r][1] = _mm512_loadu_si512(tile + r * quantized_nr + 16);
+        }
+        for (size_t kq = 0; kq < depth / 4; ++kq)
+        {
+            const int8_t *b = panel + kq * quantized_nr * 4;
+            const __m512i b0 = _mm512_loadu_si512(b);
+            const __m512i b1 = _mm512_loadu_si512(b + 64);
+            for (size_t r = 0; r < quantized_mr; ++r)
+            {
+                const __m512i a = _mm512_set1_epi32(loadGroup(a_rows[r] + 4 * kq));
+                acc[r][0] = _mm512_dpbusd_epi32(acc[r][0], a, b0);
+                acc[r][1] = _mm512_dpbusd_epi32(acc[r][1], a, b1);
+            }
+        }
+        for (size_t r = 0; r < quantized_mr; ++r)
+        {
+            _mm512_storeu_si512(tile + r * quantized_nr, acc[r][0]);
+            _mm512_storeu_si512(tile + r * quantized_nr + 16, acc[r][1]);
+        }
+    }
+#endif
+
+    /**
+     * Quantized product C = (A - a_zero) * (B - b_zero) of an M x K by K x N product, accumulated in int32 and
+     * overwriting C. The raw products of the stored values are computed by the SIMD kernels and the zero points are
+     * applied afterwards from the row sums of A and column sums of B:
+     * sum (a - za)(b - zb) = sum ab - zb * sum a - za * sum b + K * za * zb.
+     * Sums wrap around like the int32 lanes of the hardware instructions, so results must fit in int32.
+     * Uses multithreading depending on the n_threads setting.
+     *
+     * @tparam TQuant int8_t or int16_t
+     */
+    template <typename TQuant>
+    void gemmQuantized(const size_t M, const size_t N, const size_t K, const TQuant *A, const size_t lda, const int32_t a_zero,
+        const TQuant *B, const size_t ldb, const int32_t b_zero, int32_t *C, const size_t ldc)
+    {
+        if (M == 0 || N == 0)
+        {
+            return;
+        }
+
+        const QuantizedKernel kernel = selectQuantizedKernel<TQuant>();
+        const bool quads = (kernel == QuantizedKernel::VnniQuads);
+        const size_t group = quads ? 4 : 2;
+        const size_t depth = std::max<size_t>((K + group - 1) / group * group, group);
+        const size_t n_panels = (N + quantized_nr - 1) / quantized_nr;
+        const size_t panel_size = depth * quantized_nr;
+        const int32_t shift = quads ? quantized_quad_shift : 0;
+
+        std::vector<int32_t> row_sums(M), col_sums(N);
+        std::vector<int16_t> a_pairs, b_pairs;
+        std::vector<uint8_t> a_quads;
+        std::vector<int8_t> b_quads;
+        if (quads)
+        {
+            a_quads.resize(M * depth);
+            b_quads.resize(n_panels * panel_size);
+            packQuantizedA(M, K, depth, A, lda, shift, a_quads.data(), row_sums.data());
+        }
+        else
+        {
+            a_pairs.resize(M * depth);
+            b_pairs.resize(n_panels * panel_size);
+            packQuantizedA(M, K, depth, A, lda, shift, a_pairs.data(), row_sums.data());
+        }
+
+        const size_t threads = (M * N * K < gemm_small_threshold) ? 1 : std::max<size_t>(n_threads, 1);
+        parallelFor(n_panels, threads, [&](const size_t p)
+        {
+            if (quads)
+            {
+                packQuantizedPanel<4>(N, K, depth, B, ldb, p * quantized_nr, b_quads.data() + p * panel_size, col_sums.data());
+            }
+            else
+            {
+                packQuantizedPanel<2>(N, K, depth, B, ldb, p * quantized_nr, b_pairs.data() + p * panel_size, col_sums.data());
+            }
+        });
+
+        const int32_t constant = (int32_t)K * a_zero * b_zero;
+        const size_t n_row_blocks = (M + quantized_mc - 1) / quantized_mc;
+        parallelFor(n_row_blocks * n_panels, threads, [&](const size_t task)
+        {
+            const size_t p = task % n_panels, row_block = task / n_panels;
+            const size_t col = p * quantized_nr, nr = std::min(quantized_nr, N - col);
+            const size_t row_begin = row_block * quantized_mc, row_end = std::min(M, row_begin + quantized_mc);
+
+            // Sums of the row block, with room for the rows of the last tile that fall past the end of A
+            int32_t block[(quantized_mc + quantized_mr) * quantized_nr] = {};
+
+            // The depth is split in chunks so that the chunk of the panel stays in L1 across all tiles of the block
+            for (size_t k0 = 0; k0 < depth; k0 += quantized_kc)
+            {
+                const size_t kc = std::min(quantized_kc, depth - k0);
+                for (size_t i = row_begin; i < row_end; i += quantized_mr)
+                {
+                    // Rows past the end of A repeat the last row, their sums are discarded
+                    size_t rows[quantized_mr];
+                    for (size_t r = 0; r < quantized_mr; ++r)
+                    {
+                        rows[r] = std::min(i + r, row_end - 1);
+                    }
+                    int32_t *tile = block + (i - row_begin) * quantized_nr;
+
+                    if (quads)
+                    {
+#if MATRIX_LIBRARY_X86_SIMD
+                        const uint8_t *a_rows[quantized_mr];
+                        for (size_t r = 0; r < quantized_mr; ++r)
+                        {
+                            a_rows[r] = a_quads.data() + rows[r] * depth + k0;
+                        }
+                        quantizedTileQuadsVnni(kc, a_rows, b_quads.data() + p * panel_size + k0 * quantized_nr, tile);
+#endif
+                        continue;
+                    }
+
+                    const int16_t *a_rows[quantized_mr];
+                    for (size_t r = 0; r < quantized_mr; ++r)
+                    {
+                        a_rows[r] = a_pairs.data() + rows[r] * depth + k0;
+                    }
+                    const int16_t *panel = b_pairs.data() + p * panel_size + k0 * quantized_nr;
+                    switch (kernel)
+                    {
+#if MATRIX_LIBRARY_X86_SIMD
+                    case QuantizedKernel::VnniPairs:
+                        quantizedTilePairsVnni(kc, a_rows, panel, tile);
+                        break;
+                    case QuantizedKernel::Avx512Pairs:
+                        quantizedTilePairsAvx512(kc, a_rows, panel, tile);
+                        break;
+                    case QuantizedKernel::Avx2Pairs:
+                        quantizedTilePairsAvx2(kc, a_rows, panel, tile);
+                        break;
+#endif
+                    default:
+                        quantizedTilePairs(kc, a_rows, panel, tile);
+                        break;
+                    }
+                }
+            }
+
+            for (size_t i = row_begin; i < row_end; ++i)
+            {
+                const int32_t *sums = block + (i - row_begin) * quantized_nr;
+                const int32_t row_term = constant - b_zero * row_sums[i];
+                int32_t *c_row = C + i * ldc + col;
+                for (size_t j = 0; j < nr; ++j)
+                {
+                    c_row[j] = sums[j] - (a_zero + shift) * col_sums[col + j] + row_term;
+                }
+            }
+        });
+    }
+
+    /**
+     * Multiplies two quantized matrices, returning the int32 sums of (a - za)(b - zb). The real product is these sums
+     * scaled by lhs.params().scale * rhs.params().scale.
+     *
+     * @tparam TQuant int8_t or int16_t
+     * @param lhs
+     * @param rhs
+     * @return Matrix<int32_t>
+     */
+    template <typename TQuant>
+    Matrix<int32_t> multiplyQuantizedAccumulate(const QuantizedMatrix<TQuant> &lhs, const QuantizedMatrix<TQuant> &rhs)
+    {
+        assert(lhs.cols() == rhs.rows() && "First matrix's cols must match second matrix's rows");
+        Matrix<int32_t> result(lhs.rows(), rhs.cols());
+        gemmQuantized(lhs.rows(), rhs.cols(), lhs.cols(), lhs.data(), lhs.stride(), lhs.params().zero_point,
+            rhs.data(), rhs.stride(), rhs.params().zero_point, result.data(), result.stride());
+        return result;
+    }
+
+    /**
+     * Multiplies two quantized matrices and returns the real valued product.
+     *
+     * @tparam TQuant int8_t or int16_t
+     * @param lhs
+     * @param rhs
+     * @return Matrix<float>
+     */
+    template <typename TQuant>
+    Matrix<float> multiplyQuantized(const QuantizedMatrix<TQuant> &lhs, const QuantizedMatrix<TQuant> &rhs)
+    {
+        const Matrix<int32_t> accumulated = multiplyQuantizedAccumulate(lhs, rhs);
+        const float scale = lhs.params().scale * rhs.params().scale;
+        Matrix<float> result(accumulated.rows(), accumulated.cols());
+        for (size_t i = 0; i < result.rows(); ++i)
+        {
+            for (size_t j = 0; j < result.cols(); ++j)
+            {
+                result(i, j) = scale * (float)accumulated(i, j);
+            }
+        }
+        return result;
+    }
+
+    /**
+     * Multiplies two quantized matrices and requantizes the product with the given output parameters, e.g. to feed
+     * the next layer of a quantized network.
+     *
+     * @tparam TQuant int8_t or int16_t
+     * @param lhs
+     * @param rhs
+     * @param output Quantization parameters of the result
+     * @return QuantizedMatrix<TQuant>
+     */
+    template <typename TQuant>
+    QuantizedMatrix<TQuant> multiplyQuantized(const QuantizedMatrix<TQuant> &lhs, const QuantizedMatrix<TQuant> &rhs, const QuantizationParams output)
+    {
+        const Matrix<int32_t> accumulated = multiplyQuantizedAccumulate(lhs, rhs);
+        const float scale = lhs.params().scale * rhs.params().scale;
+        QuantizedMatrix<TQuant> result(accumulated.rows(), accumulated.cols(), output);
+        for (size_t i = 0; i < result.rows(); ++i)
+        {
+            for (size_t j = 0; j < result.cols(); ++j)
+            {
+                result(i, j) = quantizeValue<TQuant>(scale * (float)accumulated(i, j), output);
+            }
+        }
+        return result;
+    }
+} // end namespace MatrixLibrary
+
+#endif // #ifndef QUANTIZED_GEMM_HPP
@@ -0,0 +1,524 @@
+/**
+ * @file simd_kernels.hpp
+ * @author Alex Liu (alex.liuyining@outlook.com)
+ * @brief Vectorized kernels for SSE2, AVX2/FMA and AVX-512, selected at runtime based on the host CPU
+ * @date 2021-12
+ */
+
+#ifndef SIMD_KERNELS_HPP
+#define SIMD_KERNELS_HPP
+
+#include <cstddef>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include "cpu_features.hpp"
+
+#if MATRIX_LIBRARY_X86_SIMD
+#include <immintrin.h>
+#define MATRIX_LIBRARY_TARGET(isa) __attribute__((target(isa)))
+#define MATRIX_LIBRARY_ALWAYS_INLINE __attribute__((always_inline))
+#else
+#define MATRIX_LIBRARY_TARGET(isa)
+#define MATRIX_LIBRARY_ALWAYS_INLINE
+#endif
+
+namespace MatrixLibrary
+{
+    /**
+     * Adds an mr x nr corner of a row-major register tile of width NR into C.
+     *
+     * @tparam TData
+     * @tparam NR Width of the tile
+     * @param tile
+     * @param C
+     * @param ldc Row stride of C
+     * @param mr Number of valid rows
+     * @param nr Number of valid columns
+     */
+    template <typename TData, size_t NR>
+    MATRIX_LIBRARY_ALWAYS_INLINE inline void accumulateTile(const TData *tile, TData *C, const size_t ldc, const size_t mr, const size_t nr)
+    {
+        for (size_t i = 0; i < mr; ++i)
+        {
+            for (size_t j = 0; j < nr; ++j)
+            {
+                C[i * ldc + j] += tile[i * NR + j];
+            }
+        }
+    }
+
+    /**
+     * Scalar 4 x 4 block transpose, the SIMD overloads below take precedence for float and double.
+     */
+    template <typename TData>
+    inline void transposeBlock4x4(const TData *src, const size_t lds, TData *dst, const size_t ldd)
+    {
+        for (size_t i = 0; i < 4; ++i)
+        {
+            for (size_t j = 0; j < 4; ++j)
+            {
+                dst[j * ldd + i] = src[i * lds + j];
+            }
+        }
+    }
+
+    /**
+     * Element-wise loop shared by all instruction set levels. It is force inlined into the target specific
+     * wrappers below, so that the compiler vectorizes it with the instruction set of each wrapper.
+     */
+    template <typename TData, typename TOp>
+    MATRIX_LIBRARY_ALWAYS_INLINE inline void elementwiseLoop(const size_t n, const TData *a, const TData *b, TData *out, TOp op)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[i] = op(a[i], b[i]);
+        }
+    }
+
+#if MATRIX_LIBRARY_X86_SIMD
+    /*
+     * Micro-kernels computing a 4 x 8 (double) or 4 x 16 (float, int) block of C from packed slivers of A and B,
+     * see packBlockA and packPanelB in gemm_kernel.hpp for the layout. The accumulators are spilled into a
+     * register tile once at the end and added into the valid corner of C.
+     */
+
+    MATRIX_LIBRARY_TARGET("sse2")
+    inline void microKernelSse2Half(const size_t kc, const double *a, const double *b, double *tile)
+    {
+        __m128d c00 = _mm_setzero_pd(), c01 = _mm_setzero_pd(), c10 = _mm_setzero_pd(), c11 = _mm_setzero_pd();
+        __m128d c20 = _mm_setzero_pd(), c21 = _mm_setzero_pd(), c30 = _mm_setzero_pd(), c31 = _mm_setzero_pd();
+        for (size_t p = 0; p < kc; ++p)
+        {
+            const __m128d b0 = _mm_loadu_pd(b);
+            const __m128d b1 = _mm_loadu_pd(b + 2);
+            __m128d a_i = _mm_set1_pd(a[0]);
+            c00 = _mm_add_pd(c00, _mm_mul_pd(a_i, b0));
+            c01 = _mm_add_pd(c01, _mm_mul_pd(a_i, b1));
+            a_i = _mm_set1_pd(a[1]);
+            c10 = _mm_add_pd(c10, _mm_mul_pd(a_i, b0));
+            c11 = _mm_add_pd(c11, _mm_mul_pd(a_i, b1));
+            a_i = _mm_set1_pd(a[2]);
+            c20 = _mm_add_pd(c20, _mm_mul_pd(a_i, b0));
+            c21 = _mm_add_pd(c21, _mm_mul_pd(a_i, b1));
+            a_i = _mm_set1_pd(a[3]);
+            c30 = _mm_add_pd(c30, _mm_mul_pd(a_i, b0));
+            c31 = _mm_add_pd(c31, _mm_mul_pd(a_i, b1));
+            a += 4;
+            b += 8;
+        }
+        _mm_storeu_pd(tile, c00);
+        _mm_storeu_pd(tile + 2, c01);
+        _mm_storeu_pd(tile + 8, c10);
+        _mm_storeu_pd(tile + 10, c11);
+        _mm_storeu_pd(tile + 16, c20);
+        _mm_storeu_pd(tile + 18, c21);
+        _mm_storeu_pd(tile + 24, c30);
+        _mm_storeu_pd(tile + 26, c31);
+    }
+
+    // SSE2 only has 16 registers, so the 4 x 8 block is computed as two 4 x 4 halves to avoid spilling accumulators
+    MATRIX_LIBRARY_TARGET("sse2")
+    inline void microKernelSse2(const size_t kc, const double *a, const double *b, double *C, const size_t ldc, const size_t mr, const size_t nr)
+    {
+        alignas(64) double tile[4 * 8];
+        microKernelSse2Half(kc, a, b, tile);
+        microKernelSse2Half(kc, a, b + 4, tile + 4);
+        accumulateTile<double, 8>(tile, C, ldc, mr, nr);
+    }
+
+    MATRIX_LIBRARY_TARGET("avx2,fma")
+    inline void microKernelAvx2(const size_t kc, const double *a, const double *b, double *C, const size_t ldc, const size_t mr, const size_t nr)
+    {
+        __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd(), c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+        __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd(), c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+        for (size_t p = 0; p < kc; ++p)
+        {
+            const __m256d b0 = _mm256_loadu_pd(b);
+            const __m256d b1 = _mm256_loadu_pd(b + 4);
+            __m256d a_i = _mm256_broadcast_sd(a);
+            c00 = _mm256_fmadd_pd(a_i, b0, c00);
+            c01 = _mm256_fmadd_pd(a_i, b1, c01);
+            a_i = _mm256_broadcast_sd(a + 1);
+            c10 = _mm256_fmadd_pd(a_i, b0, c10);
+            c11 = _mm256_fmadd_pd(a_i, b1, c11);
+            a_i = _mm256_broadcast_sd(a + 2);
+            c20 = _mm256_fmadd_pd(a_i, b0, c20);
+            c21 = _mm256_fmadd_pd(a_i, b1, c21);
+            a_i = _mm256_broadcast_sd(a + 3);
+            c30 = _mm256_fmadd_pd(a_i, b0, c30);
+            c31 = _mm256_fmadd_pd(a_i, b1, c31);
+            a += 4;
+            b += 8;
+        }
+        alignas(64) double tile[4 * 8];
+        _mm256_store_pd(tile, c00);
+        _mm256_store_pd(tile + 4, c01);
+        _mm256_store_pd(tile + 8, c10);
+        _mm256_store_pd(tile + 12, c11);
+        _mm256_store_pd(tile + 16, c20);
+        _mm256_store_pd(tile + 20, c21);
+        _mm256_store_pd(tile + 24, c30);
+        _mm256_store_pd(tile + 28, c31);
+        accumulateTile<double, 8>(tile, C, ldc, mr, nr);
+    }
+
+    // A full row of the block fits in one register, so even and odd k are accumulated separately to hide FMA latency
+    MATRIX_LIBRARY_TARGET("avx512f")
+    inline void microKernelAvx512(const size_t kc, const double *a, const double *b, double *C, const size_t ldc, const size_t mr, const size_t nr)
+    {
+        __m512d c0 = _mm512_setzero_pd(), c1 = _mm512_setzero_pd(), c2 = _mm512_setzero_pd(), c3 = _mm512_setzero_pd();
+        __m512d d0 = _mm512_setzero_pd(), d1 = _mm512_setzero_pd(), d2 = _mm512_setzero_pd(), d3 = _mm512_setzero_pd();
+        size_t p = 0;
+        for (; p + 1 < kc; p += 2)
+        {
+            const __m512d b0 = _mm512_loadu_pd(b);
+            const __m512d b1 = _mm512_loadu_pd(b + 8);
+            c0 = _mm512_fmadd_pd(_mm512_set1_pd(a[0]), b0, c0);
+            c1 = _mm512_fmadd_pd(_mm512_set1_pd(a[1]), b0, c1);
+            c2 = _mm512_fmadd_pd(_mm512_set1_pd(a[2]), b0, c2);
+            c3 = _mm512_fmadd_pd(_mm512_set1_pd(a[3]), b0, c3);
+            d0 = _mm512_fmadd_pd(_mm512_set1_pd(a[4]), b1, d0);
+            d1 = _mm512_fmadd_pd(_mm512_set1_pd(a[5]), b1, d1);
+            d2 = _mm512_fmadd_pd(_mm512_set1_pd(a[6]), b1, d2);
+            d3 = _mm512_fmadd_pd(_mm512_set1_pd(a[7]), b1, d3);
+            a += 8;
+            b += 16;
+        }
+        if (p < kc)
+        {
+            const __m512d b0 = _mm512_loadu_pd(b);
+            c0 = _mm512_fmadd_pd(_mm512_set1_pd(a[0]), b0, c0);
+            c1 = _mm512_fmadd_pd(_mm512_set1_pd(a[1]), b0, c1);
+            c2 = _mm512_fmadd_pd(_mm512_set1_pd(a[2]), b0, c2);
+            c3 = _mm512_fmadd_pd(_mm512_set1_pd(a[3]), b0, c3);
+        }
+        alignas(64) double tile[4 * 8];
+        _mm512_store_pd(tile, _mm512_add_pd(c0, d0));
+        _mm512_store_pd(tile + 8, _mm512_add_pd(c1, d1));
+        _mm512_store_pd(tile + 16, _mm512_add_pd(c2, d2));
+        _mm512_store_pd(tile + 24, _mm512_add_pd(c3, d3));
+        accumulateTile<double, 8>(tile, C, ldc, mr, nr);
+    }
+
+    MATRIX_LIBRARY_TARGET("sse2")
+    inline void microKernelSse2Half(const size_t kc, const float *a, const float *b, float *tile)
+    {
+        __m128 c00 = _mm_setzero_ps(), c01 = _mm_setzero_ps(), c10 = _mm_setzero_ps(), c11 = _mm_setzero_ps();
+        __m128 c20 = _mm_setzero_ps(), c21 = _mm_setzero_ps(), c30 = _mm_setzero_ps(), c31 = _mm_setzero_ps();
+        for (size_t p = 0; p < kc; ++p)
+        {
+            const __m128 b0 = _mm_loadu_ps(b);
+            const __m128 b1 = _mm_loadu_ps(b + 4);
+            __m128 a_i = _mm_set1_ps(a[0]);
+            c00 = _mm_add_ps(c00, _mm_mul_ps(a_i, b0));
+            c01 = _mm_add_ps(c01, _mm_mul_ps(a_i, b1));
+            a_i = _mm_set1_ps(a[1]);
+            c10 = _mm_add_ps(c10, _mm_mul_ps(a_i, b0));
+            c11 = _mm_add_ps(c11, _mm_mul_ps(a_i, b1));
+            a_i = _mm_set1_ps(a[2]);
+            c20 = _mm_add_ps(c20, _mm_mul_ps(a_i, b0));
+            c21 = _mm_add_ps(c21, _mm_mul_ps(a_i, b1));
+            a_i = _mm_set1_ps(a[3]);
+            c30 = _mm_add_ps(c30, _mm_mul_ps(a_i, b0));
+            c31 = _mm_add_ps(c31, _mm_mul_ps(a_i, b1));
+            a += 4;
+            b += 16;
+        }
+        _mm_storeu_ps(tile, c00);
+        _mm_storeu_ps(tile + 4, c01);
+        _mm_storeu_ps(tile + 16, c10);
+        _mm_storeu_ps(tile + 20, c11);
+        _mm_storeu_ps(tile + 32, c20);
+        _mm_storeu_ps(tile + 36, c21);
+        _mm_storeu_ps(tile + 48, c30);
+        _mm_storeu_ps(tile + 52, c31);
+    }
+
+    MATRIX_LIBRARY_TARGET("sse2")
+    inline void microKernelSse2(const size_t kc, const float *a, const float *b, float *C, const size_t ldc, const size_t mr, const size_t nr)
+    {
+        alignas(64) float tile[4 * 16];
+        microKernelSse2Half(kc, a, b, tile);
+        microKernelSse2Half(kc, a, b + 8, tile + 8);
+        accumulateTile<float, 16>(tile, C, ldc, mr, nr);
+    }
+
+    MATRIX_LIBRARY_TARGET("avx2,fma")
+    inline void microKernelAvx2(const size_t kc, const float *a, const float *b, float *C, const size_t ldc, const size_t mr, const size_t nr)
+    {
+        __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps(), c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+        __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps(), c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+        for (size_t p = 0; p < kc; ++p)
+        {
+            const __m256 b0 = _mm256_loadu_ps(b);
+            const __m256 b1 = _mm256_loadu_ps(b + 8);
+            __m256 a_i = _mm256_broadcast_ss(a);
+            c00 = _mm256_fmadd_ps(a_i, b0, c00);
+            c01 = _mm256_fmadd_ps(a_i, b1, c01);
+            a_i = _mm256_broadcast_ss(a + 1);
+            c10 = _mm256_fmadd_ps(a_i, b0, c10);
+            c11 = _mm256_fmadd_ps(a_i, b1, c11);
+            a_i = _mm256_broadcast_ss(a + 2);
+            c20 = _mm256_fmadd_ps(a_i, b0, c20);
+            c21 = _mm256_fmadd_ps(a_i, b1, c21);
+            a_i = _mm256_broadcast_ss(a + 3);
+            c30 = _mm256_fmadd_ps(a_i, b0, c30);
+            c31 = _mm256_fmadd_ps(a_i, b1, c31);
+            a += 4;
+            b += 16;
+        }
+        alignas(64) float tile[4 * 16];
+        _mm256_store_ps(tile, c00);
+        _mm256_store_ps(tile + 8, c01);
+        _mm256_store_ps(tile + 16, c10);
+        _mm256_store_ps(tile + 24, c11);
+        _mm256_store_ps(tile + 32, c20);
+        _mm256_store_ps(tile + 40, c21);
+        _mm256_store_ps(tile + 48, c30);
+        _mm256_store_ps(tile + 56, c31);
+        accumulateTile<float, 16>(tile, C, ldc, mr, nr);
+    }
+
+    MATRIX_LIBRARY_TARGET("avx512f")
+    inline void microKernelAvx512(const size_t kc, const float *a, const float *b, float *C, const size_t ldc, const size_t mr, const size_t nr)
+    {
+        __m512 c0 = _mm512_setzero_ps(), c1 = _mm512_setzero_ps(), c2 = _mm512_setzero_ps(), c3 = _mm512_setzero_ps();
+        __m512 d0 = _mm512_setzero_ps(), d1 = _mm512_setzero_ps(), d2 = _mm512_setzero_ps(), d3 = _mm512_setzero_ps();
+        size_t p = 0;
+        for (; p + 1 < kc; p += 2)
+        {
+            const __m512 b0 = _mm512_loadu_ps(b);
+            const __m512 b1 = _mm512_loadu_ps(b + 16);
+            c0 = _mm512_fmadd_ps(_mm512_set1_ps(a[0]), b0, c0);
+            c1 = _mm512_fmadd_ps(_mm512_set1_ps(a[1]), b0, c1);
+            c2 = _mm512_fmadd_ps(_mm512_set1_ps(a[2]), b0, c2);
+            c3 = _mm512_fmadd_ps(_mm512_set1_ps(a[3]), b0, c3);
+            d0 = _mm512_fmadd_ps(_mm512_set1_ps(a[4]), b1, d0);
+            d1 = _mm512_fmadd_ps(_mm512_set1_ps(a[5]), b1, d1);
+            d2 = _mm512_fmadd_ps(_mm512_set1_ps(a[6]), b1, d2);
+            d3 = _mm512_fmadd_ps(_mm512_set1_ps(a[7]), b1, d3);
+            a += 8;
+            b += 32;
+        }
+        if (p < kc)
+        {
+            const __m512 b0 = _mm512_loadu_ps(b);
+            c0 = _mm512_fmadd_ps(_mm512_set1_ps(a[0]), b0, c0);
+            c1 = _mm512_fmadd_ps(_mm512_set1_ps(a[1]), b0, c1);
+            c2 = _mm512_fmadd_ps(_mm512_set1_ps(a[2]), b0, c2);
+            c3 = _mm512_fmadd_ps(_mm512_set1_ps(a[3]), b0, c3);
+        }
+        alignas(64) float tile[4 * 16];
+        _mm512_store_ps(tile, _mm512_add_ps(c0, d0));
+        _mm512_store_ps(tile + 16, _mm512_add_ps(c1, d1));
+        _mm512_store_ps(tile + 32, _mm512_add_ps(c2, d2));
+        _mm512_store_ps(tile + 48, _mm512_add_ps(c3, d3));
+        accumulateTile<float, 16>(tile, C, ldc, mr, nr);
+    }
+
+    // 32-bit integer multiply needs SSE4.1, so int has no SSE2 kernel and falls back to the scalar one
+    MATRIX_LIBRARY_TARGET("avx2")
+    inline void microKernelAvx2(const size_t kc, const int *a, const int *b, int *C, const size_t ldc, const size_t mr, const size_t nr)
+    {
+        __m256i c00 = _mm256_setzero_si256(), c01 = _mm256_setzero_si256(), c10 = _mm256_setzero_si256(), c11 = _mm256_setzero_si256();
+        __m256i c20 = _mm256_setzero_si256(), c21 = _mm256_setzero_si256(), c30 = _mm256_setzero_si256(), c31 = _mm256_setzero_si256();
+        for (size_t p = 0; p < kc; ++p)
+        {
+            const __m256i b0 = _mm256_loadu_si256((const __m256i *)b);
+            const __m256i b1 = _mm256_loadu_si256((const __m256i *)(b + 8));
+            __m256i a_i = _mm256_set1_epi32(a[0]);
+            c00 = _mm256_add_epi32(c00, _mm256_mullo_epi32(a_i, b0));
+            c01 = _mm256_add_epi32(c01, _mm256_mullo_epi32(a_i, b1));
+            a_i = _mm256_set1_epi32(a[1]);
+            c10 = _mm256_add_epi32(c10, _mm256_mullo_epi32(a_i, b0));
+            c11 = _mm256_add_epi32(c11, _mm256_mullo_epi32(a_i, b1));
+            a_i = _mm256_set1_epi32(a[2]);
+            c20 = _mm256_add_epi32(c20, _mm256_mullo_epi32(a_i, b0));
+            c21 = _mm256_add_epi32(c21, _mm256_mullo_epi32(a_i, b1));
+            a_i = _mm256_set1_epi32(a[3]);
+            c30 = _mm256_add_epi32(c30, _mm256_mullo_epi32(a_i, b0));
+            c31 = _mm256_add_epi32(c31, _mm256_mullo_epi32(a_i, b1));
+            a += 4;
+            b += 16;
+        }
+        alignas(64) int tile[4 * 16];
+        _mm256_store_si256((__m256i *)tile, c00);
+        _mm256_store_si256((__m256i *)(tile + 8), c01);
+        _mm256_store_si256((__m256i *)(tile + 16), c10);
+        _mm256_store_si256((__m256i *)(tile + 24), c11);
+        _mm256_store_si256((__m256i *)(tile + 32), c20);
+        _mm256_store_si256((__m256i *)(tile + 40), c21);
+        _mm256_store_si256((__m256i *)(tile + 48), c30);
+        _mm256_store_si256((__m256i *)(tile + 56), c31);
+        accumulateTile<int, 16>(tile, C, ldc, mr, nr);
+    }
+
+    MATRIX_LIBRARY_TARGET("avx512f")
+    inline void microKernelAvx512(const size_t kc, const int *a, const int *b, int *C, const size_t ldc, const size_t mr, const size_t nr)
+    {
+        __m512i c0 = _mm512_setzero_si512(), c1 = _mm512_setzero_si512(), c2 = _mm512_setzero_si512(), c3 = _mm512_setzero_si512();
+        for (size_t p = 0; p < kc; ++p)
+        {
+            const __m512i b0 = _mm512_loadu_si512(b);
+            c0 = _mm512_add_epi32(c0, _mm512_mullo_epi32(_mm512_set1_epi32(a[0]), b0));
+            c1 = _mm512_add_epi32(c1, _mm512_mullo_epi32(_mm512_set1_epi32(a[1]), b0));
+            c2 = _mm512_add_epi32(c2, _mm512_mullo_epi32(_mm512_set1_epi32(a[2]), b0));
+            c3 = _mm512_add_epi32(c3, _mm512_mullo_epi32(_mm512_set1_epi32(a[3]), b0));
+            a += 4;
+            b += 16;
+        }
+        alignas(64) int tile[4 * 16];
+        _mm512_store_si512(tile, c0);
+        _mm512_store_si512(tile + 16, c1);
+        _mm512_store_si512(tile + 32, c2);
+        _mm512_store_si512(tile + 48, c3);
+        accumulateTile<int, 16>(tile, C, ldc, mr, nr);
+    }
+
+    /*
+     * Element-wise wrappers, the shared loop is vectorized with the instruction set of each wrapper.
+     */
+
+    template <typename TData, typename TOp>
+    MATRIX_LIBRARY_TARGET("avx2")
+    void elementwiseAvx2(const size_t n, const TData *a, const TData *b, TData *out, TOp op)
+    {
+        elementwiseLoop(n, a, b, out, op);
+    }
+
+    template <typename TData, typename TOp>
+    MATRIX_LIBRARY_TARGET("avx512f")
+    void elementwiseAvx512(const size_t n, const TData *a, const TData *b, TData *out, TOp op)
+    {
+        elementwiseLoop(n, a, b, out, op);
+    }
+
+    /*
+     * 4 x 4 block transposes, element (i, j) of the source block is written to element (j, i) of the destination block.
+     */
+
+    MATRIX_LIBRARY_TARGET("sse2")
+    inline void transposeBlock4x4Sse2(const float *src, const size_t lds, float *dst, const size_t ldd)
+    {
+        __m128 r0 = _mm_loadu_ps(src);
+        __m128 r1 = _mm_loadu_ps(src + lds);
+        __m128 r2 = _mm_loadu_ps(src + 2 * lds);
+        __m128 r3 = _mm_loadu_ps(src + 3 * lds);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _mm_storeu_ps(dst, r0);
+        _mm_storeu_ps(dst + ldd, r1);
+        _mm_storeu_ps(dst + 2 * ldd, r2);
+        _mm_storeu_ps(dst + 3 * ldd, r3);
+    }
+
+    MATRIX_LIBRARY_TARGET("avx2")
+    inline void transposeBlock4x4Avx2(const double *src, const size_t lds, double *dst, const size_t ldd)
+    {
+        const __m256d r0 = _mm256_loadu_pd(src);
+        const __m256d r1 = _mm256_loadu_pd(src + lds);
+        const __m256d r2 = _mm256_loadu_pd(src + 2 * lds);
+        const __m256d r3 = _mm256_loadu_pd(src + 3 * lds);
+        const __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+        const __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+        const __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+        const __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+        _mm256_storeu_pd(dst, _mm256_permute2f128_pd(t0, t2, 0x20));
+        _mm256_storeu_pd(dst + ldd, _mm256_permute2f128_pd(t1, t3, 0x20));
+        _mm256_storeu_pd(dst + 2 * ldd, _mm256_permute2f128_pd(t0, t2, 0x31));
+        _mm256_storeu_pd(dst + 3 * ldd, _mm256_permute2f128_pd(t1, t3, 0x31));
+    }
+
+    inline void transposeBlock4x4(const float *src, const size_t lds, float *dst, const size_t ldd)
+    {
+        transposeBlock4x4Sse2(src, lds, dst, ldd);
+    }
+
+    inline void transposeBlock4x4(const double *src, const size_t lds, double *dst, const size_t ldd)
+    {
+        transposeBlock4x4Avx2(src, lds, dst, ldd);
+    }
+#endif // #if MATRIX_LIBRARY_X86_SIMD
+
+    /**
+     * Element-wise binary operation out[i] = op(a[i], b[i]), dispatched on the instruction set level of the host.
+     * out may alias a or b.
+     *
+     * @tparam TData
+     * @tparam TOp
+     * @param n Number of elements
+     * @param a
+     * @param b
+     * @param out
+     * @param op
+     */
+    template <typename TData, typename TOp>
+    void elementwiseBinary(const size_t n, const TData *a, const TData *b, TData *out, TOp op)
+    {
+#if MATRIX_LIBRARY_X86_SIMD
+        switch (simd_level)
+        {
+        case SimdLevel::AVX512:
+            elementwiseAvx512(n, a, b, out, op);
+            return;
+        case SimdLevel::AVX2:
+            elementwiseAvx2(n, a, b, out, op);
+            return;
+        default:
+            break;
+        }
+#endif
+        // SSE2 is part of the x86-64 baseline, so the default loop is already vectorized with it
+        elementwiseLoop(n, a, b, out, op);
+    }
+
+    /**
+     * Transposes a rows x cols block, dst(j, i) = src(i, j). Uses 4 x 4 SIMD block transposes for float
+     * and double where available and scalar code for the edges and for the remaining types.
+     *
+     * @tparam TData
+     * @param rows Number of rows of src
+     * @param cols Number of columns of src
+     * @param src
+     * @param lds Row stride of src
+     * @param dst
+     * @param ldd Row stride of dst
+     */
+    template <typename TData>
+    void transposeKernel(const size_t rows, const size_t cols, const TData *src, const size_t lds, TData *dst, const size_t ldd)
+    {
+        size_t i_vec = 0, j_vec = 0;
+#if MATRIX_LIBRARY_X86_SIMD
+        if ((std::is_same<TData, float>::value && simd_level >= SimdLevel::SSE2) ||
+            (std::is_same<TData, double>::value && simd_level >= SimdLevel::AVX2))
+        {
+            i_vec = rows - rows % 4;
+            j_vec = cols - cols % 4;
+            for (size_t i = 0; i < i_vec; i += 4)
+            {
+                for (size_t j = 0; j < j_vec; j += 4)
+                {
+                    transposeBlock4x4(src + i * lds + j, lds, dst + j * ldd + i, ldd);
+                }
+            }
+        }
+#endif
+        // Scalar remainder: the columns to the right of the vectorized area, then the rows below it
+        for (size_t i = 0; i < i_vec; ++i)
+        {
+            for (size_t j = j_vec; j < cols; ++j)
+            {
+                dst[j * ldd + i] = src[i * lds + j];
+            }
+        }
+        for (size_t i = i_vec; i < rows; ++i)
+        {
+            for (size_t j = 0; j < cols; ++j)
+            {
+                dst[j * ldd + i] = src[i * lds + j];
+            }
+        }
+    }
+} // end namespace MatrixLibrary
+
+#endif // #ifndef SIMD_KERNELS_HPP
@@ -0,0 +1,510 @@
+/**
+ * @file sparse_matrix.hpp
+ * @author Alex Liu (alex.liuyining@outlook.com)
+ * @brief Sparse matrix in compressed row (CSR) or compressed column (CSC) format with multithreaded products
+ * @date 2021-12
+ */
+
+#ifndef SPARSE_MATRIX_HPP
+#define SPARSE_MATRIX_HPP
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cassert>
+#include <stdexcept>
+#include <type_traits>
+#include "matrix_library.hpp"
+#include "concurrency_utils.hpp"
+
+namespace MatrixLibrary
+{
+    enum class SparseFormat
+    {
+        // Compressed sparse row, the non-zeros of each row are stored together
+        CSR,
+        // Compressed sparse column, the non-zeros of each column are stored together
+        CSC
+    };
+
+    /**
+     * Element (row, col) = value, used to build a SparseMatrix from coordinates.
+     */
+    template <typename TData>
+    struct Triplet
+    {
+        size_t row;
+        size_t col;
+        TData value;
+    };
+
+    /**
+     * Splits the outer indices [0, n_outer) into at most n_parts contiguous ranges holding roughly the same number
+     * of non-zeros, so that rows or columns of uneven density are balanced across threads.
+     *
+     * @param offsets Compressed offsets, of size n_outer + 1
+     * @param n_outer
+     * @param n_parts
+     * @return Range boundaries, part p covers [bounds[p], bounds[p + 1])
+     */
+    inline std::vector<size_t> partitionByNonZeros(const std::vector<size_t> &offsets, const size_t n_outer, size_t n_parts)
+    {
+        n_parts = std::max<size_t>(std::min(n_parts, n_outer), 1);
+        const size_t nnz = offsets[n_outer];
+        std::vector<size_t> bounds(n_parts + 1, n_outer);
+        bounds[0] = 0;
+        for (size_t p = 1; p < n_parts; ++p)
+        {
+            const size_t target = nnz * p / n_parts;
+            const size_t outer = std::lower_bound(offsets.begin(), offsets.begin() + n_outer + 1, target) - offsets.begin();
+            bounds[p] = std::max(bounds[p - 1], std::min(outer, n_outer));
+        }
+        return bounds;
+    }
+
+    /**
+     * Sparse matrix storing only its non-zero elements in compressed form. In CSR format, the column indices and values
+     * of row i are indices()[offsets()[i] .. offsets()[i + 1]) and values()[...], sorted by column. CSC is the same with
+     * the roles of rows and columns swapped.
+     *
+     * Products and sums are multithreaded depending on the n_threads setting, with work split by non-zero count.
+     *
+     * @tparam TData
+     */
+    template <typename TData>
+    class SparseMatrix
+    {
+        static_assert(std::is_arithmetic<TData>::value, "TData must be numeric");
+
+    public:
+        using value_type = TData;
+
+        /**
+         * Constructor for an empty (all zero) rows x cols sparse matrix.
+         */
+        SparseMatrix(const size_t rows, const size_t cols, const SparseFormat format = SparseFormat::CSR):
+            m_format(format), m_rows(rows), m_cols(cols), m_offsets(outerSize() + 1, 0)
+        {
+        }
+
+        /**
+         * Constructor from a list of (row, col, value) triplets in any order. Values given for the same element are summed.
+         *  @throw std::out_of_range if a triplet lies outside of the rows x cols matrix
+         */
+        SparseMatrix(const size_t rows, const size_t cols, const std::vector<Triplet<TData>> &triplets, const SparseFormat format = SparseFormat::CSR):
+            SparseMatrix(rows, cols, format)
+        {
+            const size_t n_outer = outerSize();
+
+            // Bucket the triplets by outer index
+            std::vector<size_t> counts(n_outer + 1, 0);
+            for (const Triplet<TData> &t : triplets)
+            {
+                if (t.row >= m_rows || t.col >= m_cols)
+                {
+                    throw std::out_of_range("Triplet exceeds the dimensions of the matrix");
+                }
+                ++counts[outerIndex(t.row, t.col) + 1];
+            }
+            for (size_t o = 0; o < n_outer; ++o)
+            {
+                counts[o + 1] += counts[o];
+            }
+            std::vector<std::pair<size_t, TData>> entries(triplets.size());
+            std::vector<size_t> next(counts.begin(), counts.end() - 1);
+            for (const Triplet<TData> &t : triplets)
+            {
+                entries[next[outerIndex(t.row, t.col)]++] = std::make_pair(innerIndex(t.row, t.col), t.value);
+            }
+
+            // Sort each bucket by inner index and merge duplicates
+            m_indices.reserve(entries.size());
+            m_values.reserve(entries.size());
+            for (size_t o = 0; o < n_outer; ++o)
+            {
+                std::sort(entries.begin() + counts[o], entries.begin() + counts[o + 1],
+                    [](const std::pair<size_t, TData> &a, const std::pair<size_t, TData> &b) { return a.first < b.first; });
+                for (size_t e = counts[o]; e < counts[o + 1]; ++e)
+                {
+                    if (m_indices.size() > m_offsets[o] && m_indices.back() == entries[e].first)
+                    {
+                        m_values.back() += entries[e].second;
+                    }
+                    else
+                    {
+                        m_indices.push_back(entries[e].first);
+                        m_values.push_back(entries[e].second);
+                    }
+                }
+                m_offsets[o + 1] = m_indices.size();
+            }
+        }
+
+        /**
+         * Constructor from a dense Matrix, keeping its non-zero elements.
+         */
+        explicit SparseMatrix(const Matrix<TData> &mat, const SparseFormat format = SparseFormat::CSR):
+            SparseMatrix(mat.rows(), mat.cols(), format)
+        {
+            const size_t n_outer = outerSize();
+            const size_t n_inner = innerSize();
+            for (size_t o = 0; o < n_outer; ++o)
+            {
+                for (size_t in = 0; in < n_inner; ++in)
+                {
+                    const TData value = (m_format == SparseFormat::CSR) ? mat(o, in) : mat(in, o);
+                    if (value != TData(0))
+                    {
+                        m_indices.push_back(in);
+                        m_values.push_back(value);
+                    }
+                }
+                m_offsets[o + 1] = m_indices.size();
+            }
+        }
+
+        size_t rows() const { return m_rows; }
+        size_t cols() const { return m_cols; }
+        SparseFormat format() const { return m_format; }
+
+        /**
+         * Getter for the number of stored elements
+         *
+         * @return size_t
+         */
+        size_t nonZeros() const
+        {
+            return m_values.size();
+        }
+
+        /**
+         * Getter for the dimensions of the matrix, returned as a pair in the form of rows, cols
+         *
+         * @return std::pair <size_t, size_t>
+         */
+        std::pair<size_t, size_t> getDimensions() const
+        {
+            return std::make_pair(m_rows, m_cols);
+        }
+
+        const std::vector<size_t> &offsets() const { return m_offsets; }
+        const std::vector<size_t> &indices() const { return m_indices; }
+        const std::vector<TData> &values() const { return m_values; }
+
+        /**
+         * Value of element (i, j), zero if it is not stored. Uses a binary search within the row or column.
+         */
+        TData coeff(const size_t i, const size_t j) const
+        {
+            const size_t o = outerIndex(i, j);
+            const auto begin = m_indices.begin() + m_offsets[o];
+            const auto end = m_indices.begin() + m_offsets[o + 1];
+            const auto it = std::lower_bound(begin, end, innerIndex(i, j));
+            return (it != end && *it == innerIndex(i, j)) ? m_values[it - m_indices.begin()] : TData(0);
+        }
+
+        /**
+         * Copy of the matrix in the given format, converting between CSR and CSC takes O(nnz + rows + cols).
+         */
+        SparseMatrix toFormat(const SparseFormat format) const
+        {
+            if (format == m_format)
+            {
+                return *this;
+            }
+
+            SparseMatrix r(m_rows, m_cols, format);
+            const size_t n_inner = innerSize();
+            for (const size_t in : m_indices)
+            {
+                ++r.m_offsets[in + 1];
+            }
+            for (size_t in = 0; in < n_inner; ++in)
+            {
+                r.m_offsets[in + 1] += r.m_offsets[in];
+            }
+
+            // Scattering in outer order keeps the new inner indices sorted
+            r.m_indices.resize(nonZeros());
+            r.m_values.resize(nonZeros());
+            std::vector<size_t> next(r.m_offsets.begin(), r.m_offsets.end() - 1);
+            for (size_t o = 0; o < outerSize(); ++o)
+            {
+                for (size_t e = m_offsets[o]; e < m_offsets[o + 1]; ++e)
+                {
+                    const size_t dst = next[m_indices[e]]++;
+                    r.m_indices[dst] = o;
+                    r.m_values[dst] = m_values[e];
+                }
+            }
+            return r;
+        }
+
+        /**
+         * Converts into a dense Matrix.
+         */
+        Matrix<TData> toDense() const
+        {
+            Matrix<TData> r(m_rows, m_cols);
+            for (size_t o = 0; o < outerSize(); ++o)
+            {
+                for (size_t e = m_offsets[o]; e < m_offsets[o + 1]; ++e)
+                {
+                    if (m_format == SparseFormat::CSR)
+                    {
+                        r(o, m_indices[e]) = m_values[e];
+                    }
+                    else
+                    {
+                        r(m_indices[e], o) = m_values[e];
+                    }
+                }
+            }
+            return r;
+        }
+
+        /**
+         * Prints the data of the matrix in dense form.
+         *
+         * @param p the number of decimals to display in case the data is floating point, default p = 2
+         */
+        void printData(int p = 2) const
+        {
+            toDense().printData(p);
+        }
+
+        /**
+         * Sparse matrix-vector product y = A * x.
+         *
+         * @param x Vector of size cols
+         * @return Vector of size rows
+         */
+        std::vector<TData> operator*(const std::vector<TData> &x) const
+        {
+            assert(x.size() == m_cols && "Vector size must match the matrix's cols");
+            std::vector<TData> y(m_rows, TData(0));
+
+            if (m_format == SparseFormat::CSR)
+            {
+                const std::vector<size_t> bounds = partitionByNonZeros(m_offsets, m_rows, parallelParts());
+                parallelFor(bounds.size() - 1, n_threads, [&](const size_t p)
+                {
+                    for (size_t i = bounds[p]; i < bounds[p + 1]; ++i)
+                    {
+                        TData sum = TData(0);
+                        for (size_t e = m_offsets[i]; e < m_offsets[i + 1]; ++e)
+                        {
+                            sum += m_values[e] * x[m_indices[e]];
+                        }
+                        y[i] = sum;
+                    }
+                });
+                return y;
+            }
+
+            // Columns scatter into all of y, so each part accumulates into its own buffer which are summed afterwards
+            const std::vector<size_t> bounds = partitionByNonZeros(m_offsets, m_cols, std::max<size_t>(n_threads, 1));
+            const size_t n_parts = bounds.size() - 1;
+            std::vector<std::vector<TData>> partials(n_parts - 1, std::vector<TData>(m_rows, TData(0)));
+            parallelFor(n_parts, n_threads, [&](const size_t p)
+            {
+                TData *out = (p == 0) ? y.data() : partials[p - 1].data();
+                for (size_t j = bounds[p]; j < bounds[p + 1]; ++j)
+                {
+                    const TData x_j = x[j];
+                    for (size_t e = m_offsets[j]; e < m_offsets[j + 1]; ++e)
+                    {
+                        out[m_indices[e]] += m_values[e] * x_j;
+                    }
+                }
+            });
+            for (const std::vector<TData> &partial : partials)
+            {
+                elementwiseBinary(m_rows, y.data(), partial.data(), y.data(), std::plus<TData>());
+            }
+            return y;
+        }
+
+        /**
+         * Sparse times dense product. Each row of the result is a combination of the rows of mat selected by the
+         * non-zeros of the corresponding row of this matrix, a CSC matrix is converted to CSR first.
+         *
+         * @param mat Dense matrix with as many rows as this matrix has cols
+         * @return Dense rows x mat.cols() Matrix
+         */
+        Matrix<TData> operator*(const Matrix<TData> &mat) const
+        {
+            assert(m_cols == mat.rows() && "First matrix's cols must match second matrix's rows");
+            if (m_format == SparseFormat::CSC)
+            {
+                return toFormat(SparseFormat::CSR) * mat;
+            }
+
+            const size_t n = mat.cols();
+            Matrix<TData> r(m_rows, n);
+            const std::vector<size_t> bounds = partitionByNonZeros(m_offsets, m_rows, parallelParts());
+            parallelFor(bounds.size() - 1, n_threads, [&](const size_t p)
+            {
+                for (size_t i = bounds[p]; i < bounds[p + 1]; ++i)
+                {
+                    TData *r_row = r.data() + i * r.stride();
+                    for (size_t e = m_offsets[i]; e < m_offsets[i + 1]; ++e)
+                    {
+                        const TData value = m_values[e];
+                        const TData *mat_row = mat.data() + m_indices[e] * mat.stride();
+                        for (size_t j = 0; j < n; ++j)
+                        {
+                            r_row[j] += value * mat_row[j];
+                        }
+                    }
+                }
+            });
+            return r;
+        }
+
+        /**
+         * Sum of two sparse matrices of the same dimensions, in the format of this matrix. The rows or columns
+         * are merged in parallel, after a first pass counting the size of each merged row or column.
+         */
+        SparseMatrix operator+(const SparseMatrix &rhs) const
+        {
+            assert(m_rows == rhs.m_rows && m_cols == rhs.m_cols && "Two matrices must have the same dimensions");
+            if (rhs.m_format != m_format)
+            {
+                return *this + rhs.toFormat(m_format);
+            }
+
+            const size_t n_outer = outerSize();
+            SparseMatrix r(m_rows, m_cols, m_format);
+            const size_t n_parts = std::max<size_t>(std::min(parallelParts(), n_outer), 1);
+            const size_t outer_per_part = (n_outer + n_parts - 1) / n_parts;
+
+            // Merges outer index o of both operands, only counting when out is null
+            auto merge = [&](const size_t o, size_t *out_indices, TData *out_values)
+            {
+                size_t a = m_offsets[o], b = rhs.m_offsets[o], count = 0;
+                const size_t a_end = m_offsets[o + 1], b_end = rhs.m_offsets[o + 1];
+                while (a < a_end || b < b_end)
+                {
+                    size_t index;
+                    TData value;
+                    if (b == b_end || (a < a_end && m_indices[a] < rhs.m_indices[b]))
+                    {
+                        index = m_indices[a];
+                        value = m_values[a++];
+                    }
+                    else if (a == a_end || rhs.m_indices[b] < m_indices[a])
+                    {
+                        index = rhs.m_indices[b];
+                        value = rhs.m_values[b++];
+                    }
+                    else
+                    {
+                        index = m_indices[a];
+                        value = m_values[a++] + rhs.m_values[b++];
+                    }
+                    if (out_indices)
+                    {
+                        out_indices[count] = index;
+                        out_values[count] = value;
+                    }
+                    ++count;
+                }
+                return count;
+            };
+
+            parallelFor(n_parts, n_threads, [&](const size_t p)
+            {
+                for (size_t o = p * outer_per_part; o < std::min(n_outer, (p + 1) * outer_per_part); ++o)
+                {
+                    r.m_offsets[o + 1] = merge(o, nullptr, nullptr);
+                }
+            });
+            for (size_t o = 0; o < n_outer; ++o)
+            {
+                r.m_offsets[o + 1] += r.m_offsets[o];
+            }
+            r.m_indices.resize(r.m_offsets[n_outer]);
+            r.m_values.resize(r.m_offsets[n_outer]);
+            parallelFor(n_parts, n_threads, [&](const size_t p)
+            {
+                for (size_t o = p * outer_per_part; o < std::min(n_outer, (p + 1) * outer_per_part); ++o)
+                {
+                    merge(o, r.m_indices.data() + r.m_offsets[o], r.m_values.data() + r.m_offsets[o]);
+                }
+            });
+            return r;
+        }
+
+    private:
+        size_t outerSize() const { return (m_format == SparseFormat::CSR) ? m_rows : m_cols; }
+        size_t innerSize() const { return (m_format == SparseFormat::CSR) ? m_cols : m_rows; }
+        size_t outerIndex(const size_t i, const size_t j) const { return (m_format == SparseFormat::CSR) ? i : j; }
+        size_t innerIndex(const size_t i, const size_t j) const { return (m_format == SparseFormat::CSR) ? j : i; }
+
+        // Several parts per thread so that the dynamic scheduling of parallelFor can even out the remaining imbalance
+        static size_t parallelParts()
+        {
+            return (n_threads <= 1) ? 1 : 4 * n_threads;
+        }
+
+        SparseFormat m_format;
+        size_t m_rows;
+        size_t m_cols;
+        std::vector<size_t> m_offsets;
+        std::vector<size_t> m_indices;
+        std::vector<TData> m_values;
+    };
+
+    /**
+     * Dense times sparse product. Each row of the result is a combination of the rows of the sparse matrix selected
+     * by the non-zeros of the corresponding row of mat, the rows of mat are split across threads. A CSC sparse
+     * matrix is converted to CSR first.
+     *
+     * @param mat Dense matrix with as many cols as sparse has rows
+     * @param sparse
+     * @return Dense mat.rows() x sparse.cols() Matrix
+     */
+    template <typename TData>
+    Matrix<TData> operator*(const Matrix<TData> &mat, const SparseMatrix<TData> &sparse)
+    {
+        assert(mat.cols() == sparse.rows() && "First matrix's cols must match second matrix's rows");
+        if (sparse.format() == SparseFormat::CSC)
+        {
+            return mat * sparse.toFormat(SparseFormat::CSR);
+        }
+
+        const size_t m = mat.rows();
+        Matrix<TData> r(m, sparse.cols());
+        const std::vector<size_t> &offsets = sparse.offsets();
+        const std::vector<size_t> &indices = sparse.indices();
+        const std::vector<TData> &values = sparse.values();
+
+        const size_t n_parts = (n_threads <= 1) ? 1 : std::min(m, 4 * n_threads);
+        const size_t rows_per_part = (m + n_parts - 1) / n_parts;
+        parallelFor(n_parts, n_threads, [&](const size_t p)
+        {
+            for (size_t i = p * rows_per_part; i < std::min(m, (p + 1) * rows_per_part); ++i)
+            {
+                TData *r_row = r.data() + i * r.stride();
+                for (size_t k = 0; k < mat.cols(); ++k)
+                {
+                    const TData a = mat(i, k);
+                    if (a == TData(0))
+                    {
+                        continue;
+                    }
+                    for (size_t e = offsets[k]; e < offsets[k + 1]; ++e)
+                    {
+                        r_row[indices[e]] += a * values[e];
+                    }
+                }
+            }
+        });
+        return r;
+    }
+} // end namespace MatrixLibrary
+
+#endif // #ifndef SPARSE_MATRIX_HPP
@@ -0,0 +1,216 @@
+/**
+ * @file strassen.hpp
+ * @author Alex Liu (alex.liuyining@outlook.com)
+ * @brief Strassen-Winograd fast multiplication for large square floating point matrices
+ * @date 2021-12
+ */
+
+#ifndef STRASSEN_HPP
+#define STRASSEN_HPP
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include "simd_kernels.hpp"
+#include "gemm_kernel.hpp"
+#include "concurrency_utils.hpp"
+
+namespace MatrixLibrary
+{
+    /**
+     * Algorithms available for Matrix multiplication.
+     * Strassen only applies to square float and double products larger than the crossover size, all other products
+     * use the classical algorithm regardless of this setting.
+     */
+    enum class MultiplicationAlgorithm
+    {
+        Classical,
+        Strassen
+    };
+
+    inline MultiplicationAlgorithm multiplication_algorithm = MultiplicationAlgorithm::Classical;
+
+    // Size at or below which the Strassen recursion hands off to the classical blocked kernel
+    inline size_t strassen_crossover = 512;
+
+    inline void setMultiplicationAlgorithm(const MultiplicationAlgorithm multiplication_algorithm_)
+    {
+        multiplication_algorithm = multiplication_algorithm_;
+    }
+
+    inline void setStrassenCrossover(const size_t strassen_crossover_)
+    {
+        strassen_crossover = std::max<size_t>(strassen_crossover_, 1);
+    }
+
+    /**
+     * Whether an M x K by K x N product is computed with Strassen-Winograd under the current settings.
+     */
+    template <typename TData>
+    bool useStrassen(const size_t M, const size_t K, const size_t N)
+    {
+        return multiplication_algorithm == MultiplicationAlgorithm::Strassen && std::is_floating_point<TData>::value &&
+            M == K && K == N && M > strassen_crossover;
+    }
+
+    /**
+     * Element-wise Z = X op Y over n x n blocks with arbitrary row strides.
+     */
+    template <typename TData, typename TOp>
+    void combineBlocks(const size_t n, const TData *X, const size_t ldx, const TData *Y, const size_t ldy, TData *Z, const size_t ldz, TOp op)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            elementwiseBinary(n, X + i * ldx, Y + i * ldy, Z + i * ldz, op);
+        }
+    }
+
+    /**
+     * Strassen-Winograd recursion C = A * B for n x n blocks, using 7 half-size products and 15 additions per level.
+     * n must be divisible by 2 at every level above the crossover, which strassenMultiply guarantees by padding.
+     * The seven products of a level are computed in parallel on the thread pool.
+     *
+     * @tparam TData
+     * @param n
+     * @param A
+     * @param lda Row stride of A
+     * @param B
+     * @param ldb Row stride of B
+     * @param C Overwritten with the result
+     * @param ldc Row stride of C
+     * @param crossover
+     * @param n_threads
+     */
+    template <typename TData>
+    void strassenRecursive(const size_t n, const TData *A, const size_t lda, const TData *B, const size_t ldb, TData *C, const size_t ldc,
+        const size_t crossover, const size_t n_threads)
+    {
+        if (n <= crossover || n % 2 != 0)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                std::fill(C + i * ldc, C + i * ldc + n, TData(0));
+            }
+            gemmBlocked(n, n, n, TData(1), A, lda, B, ldb, C, ldc);
+            return;
+        }
+
+        const size_t h = n / 2;
+        const size_t hh = h * h;
+        const TData *A11 = A, *A12 = A + h, *A21 = A + h * lda, *A22 = A + h * lda + h;
+        const TData *B11 = B, *B12 = B + h, *B21 = B + h * ldb, *B22 = B + h * ldb + h;
+        TData *C11 = C, *C12 = C + h, *C21 = C + h * ldc, *C22 = C + h * ldc + h;
+
+        // Sums of the operands, S1-S4 from A and T1-T4 from B, followed by the seven products
+        std::vector<TData> buffer(15 * hh);
+        TData *S1 = &buffer[0], *S2 = &buffer[hh], *S3 = &buffer[2 * hh], *S4 = &buffer[3 * hh];
+        TData *T1 = &buffer[4 * hh], *T2 = &buffer[5 * hh], *T3 = &buffer[6 * hh], *T4 = &buffer[7 * hh];
+        TData *M = &buffer[8 * hh];
+
+        const std::plus<TData> add;
+        const std::minus<TData> sub;
+        combineBlocks(h, A21, lda, A22, lda, S1, h, add);
+        combineBlocks(h, S1, h, A11, lda, S2, h, sub);
+        combineBlocks(h, A11, lda, A21, lda, S3, h, sub);
+        combineBlocks(h, A12, lda, S2, h, S4, h, sub);
+        combineBlocks(h, B12, ldb, B11, ldb, T1, h, sub);
+        combineBlocks(h, B22, ldb, T1, h, T2, h, sub);
+        combineBlocks(h, B22, ldb, B12, ldb, T3, h, sub);
+        combineBlocks(h, T2, h, B21, ldb, T4, h, sub);
+
+        struct Product
+        {
+            const TData *lhs;
+            size_t ld_lhs;
+            const TData *rhs;
+            size_t ld_rhs;
+        };
+        const Product products[7] = {
+            {A11, lda, B11, ldb},
+            {A12, lda, B21, ldb},
+            {S4, h, B22, ldb},
+            {A22, lda, T4, h},
+            {S1, h, T1, h},
+            {S2, h, T2, h},
+            {S3, h, T3, h}};
+
+        parallelFor(7, n_threads, [&](const size_t p)
+        {
+            strassenRecursive(h, products[p].lhs, products[p].ld_lhs, products[p].rhs, products[p].ld_rhs, M + p * hh, h, crossover, n_threads);
+        });
+
+        const TData *M1 = M, *M2 = M + hh, *M3 = M + 2 * hh, *M4 = M + 3 * hh, *M5 = M + 4 * hh, *M6 = M + 5 * hh, *M7 = M + 6 * hh;
+
+        // U2 = M1 + M6 and U3 = U2 + M7 are accumulated in the S buffers, which are no longer needed
+        TData *U2 = S1, *U3 = S2;
+        combineBlocks(h, M1, h, M2, h, C11, ldc, add);
+        combineBlocks(h, M1, h, M6, h, U2, h, add);
+        combineBlocks(h, U2, h, M7, h, U3, h, add);
+        combineBlocks(h, U2, h, M5, h, C12, ldc, add);
+        combineBlocks(h, C12, ldc, M3, h, C12, ldc, add);
+        combineBlocks(h, U3, h, M4, h, C21, ldc, sub);
+        combineBlocks(h, U3, h, M5, h, C22, ldc, add);
+    }
+
+    /**
+     * Computes C = A * B for n x n matrices with Strassen-Winograd. n is padded with zeros up to m * 2^d, where d is the
+     * number of recursion levels needed to bring the size down to the crossover and m <= crossover, so that every level
+     * splits evenly. The padded copies are only made when n is not already of that form.
+     *
+     * @tparam TData
+     * @param n
+     * @param A
+     * @param lda Row stride of A
+     * @param B
+     * @param ldb Row stride of B
+     * @param C Overwritten with the result
+     * @param ldc Row stride of C
+     * @param crossover
+     * @param n_threads
+     */
+    template <typename TData>
+    void strassenMultiply(const size_t n, const TData *A, const size_t lda, const TData *B, const size_t ldb, TData *C, const size_t ldc,
+        const size_t crossover, const size_t n_threads)
+    {
+        size_t base = n, levels = 0;
+        while (base > crossover)
+        {
+            base = (base + 1) / 2;
+            ++levels;
+        }
+        const size_t n_pad = base << levels;
+
+        if (n_pad == n)
+        {
+            strassenRecursive(n, A, lda, B, ldb, C, ldc, crossover, n_threads);
+            return;
+        }
+
+        std::vector<TData> A_pad(n_pad * n_pad), B_pad(n_pad * n_pad), C_pad(n_pad * n_pad);
+        for (size_t i = 0; i < n; ++i)
+        {
+            std::copy(A + i * lda, A + i * lda + n, A_pad.begin() + i * n_pad);
+            std::copy(B + i * ldb, B + i * ldb + n, B_pad.begin() + i * n_pad);
+        }
+        strassenRecursive(n_pad, A_pad.data(), n_pad, B_pad.data(), n_pad, C_pad.data(), n_pad, crossover, n_threads);
+        for (size_t i = 0; i < n; ++i)
+        {
+            std::copy(C_pad.begin() + i * n_pad, C_pad.begin() + i * n_pad + n, C + i * ldc);
+        }
+    }
+
+    /**
+     * Difference between a Strassen-Winograd product and the classical product of the same operands.
+     */
+    struct StrassenErrorReport
+    {
+        // Largest absolute difference between corresponding elements
+        double max_abs_error;
+        // Frobenius norm of the difference relative to the Frobenius norm of the classical product
+        double relative_error;
+    };
+} // end namespace MatrixLibrary
+
+#endif // #ifndef STRASSEN_HPP
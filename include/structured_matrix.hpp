@@ -0,0 +1,970 @@
+/**
+ * @file structured_matrix.hpp
+ * @author Alex Liu (alex.liuyining@outlook.com)
+ * @brief Compact diagonal, banded, triangular and symmetric matrices with products, sums and solves touching only stored elements
+ * @date 2021-12
+ */
+
+#ifndef STRUCTURED_MATRIX_HPP
+#define STRUCTURED_MATRIX_HPP
+
+#include <vector>
+#include <cmath>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <cassert>
+#include <stdexcept>
+#include <type_traits>
+#include "matrix_allocator.hpp"
+#include "concurrency_utils.hpp"
+#include "matrix_library.hpp"
+#include "dense_vector.hpp"
+
+namespace MatrixLibrary
+{
+    /**
+     * Calls func(begin, end) over contiguous ranges covering [0, n), split across the thread pool when the operation
+     * does at least min_task_work multiply-adds in total and on the calling thread otherwise.
+     *
+     * @param n
+     * @param work Total number of multiply-adds of the operation
+     * @param func
+     */
+    inline void parallelRanges(const size_t n, const size_t work, const std::function<void(size_t, size_t)> &func)
+    {
+        const size_t n_parts = (n_threads <= 1 || work < min_task_work) ? 1 : std::min(n, 4 * n_threads);
+        if (n_parts <= 1)
+        {
+            func(0, n);
+            return;
+        }
+        const size_t per_part = (n + n_parts - 1) / n_parts;
+        parallelFor(n_parts, n_threads, [&](const size_t p)
+        {
+            func(std::min(n, p * per_part), std::min(n, (p + 1) * per_part));
+        });
+    }
+
+    /**
+     * Base of the square structured matrices. The derived class stores the elements of each row which may be non-zero
+     * contiguously, and provides
+     *  - size(), the number of rows and cols
+     *  - rowBegin(i) and rowEnd(i), the range of cols stored for row i
+     *  - rowData(i), pointer to the element (i, rowBegin(i)), followed by the rest of the stored row
+     *  - coeff(i, j), the value of any element
+     *  - storedSize(), the number of stored elements
+     * from which products and sums with a dense Matrix are implemented here. A derived class whose storage does not
+     * fit this layout, such as SymmetricMatrix, hides these with its own.
+     *
+     * @tparam TDerived
+     * @tparam TData
+     */
+    template <typename TDerived, typename TData>
+    class StructuredMatrix
+    {
+        static_assert(std::is_arithmetic<TData>::value, "TData must be numeric");
+
+    public:
+        using value_type = TData;
+
+        const TDerived &derived() const
+        {
+            return static_cast<const TDerived &>(*this);
+        }
+
+        size_t rows() const
+        {
+            return derived().size();
+        }
+
+        size_t cols() const
+        {
+            return derived().size();
+        }
+
+        std::pair<size_t, size_t> getDimensions() const
+        {
+            return std::make_pair(rows(), cols());
+        }
+
+        /**
+         * Converts into a dense Matrix.
+         */
+        Matrix<TData> toDense() const
+        {
+            const TDerived &self = derived();
+            Matrix<TData> r(self.size(), self.size());
+            for (size_t i = 0; i < self.size(); ++i)
+            {
+                std::copy(self.rowData(i), self.rowData(i) + (self.rowEnd(i) - self.rowBegin(i)), &r(i, self.rowBegin(i)));
+            }
+            return r;
+        }
+
+        /**
+         * Getter for the data in dense form, as a vector of rows.
+         */
+        const std::vector<std::vector<TData>> getData() const
+        {
+            return derived().toDense().getData();
+        }
+
+        /**
+         * Prints the data of the matrix in dense form.
+         *
+         * @param p the number of decimals to display in case the data is floating point, default p = 2
+         */
+        void printData(int p = 2) const
+        {
+            derived().toDense().printData(p);
+        }
+
+        /**
+         * Product with a dense matrix on the right. Each row of the result combines the rows of mat selected by the
+         * stored elements of the corresponding row of this matrix, rows are split across threads.
+         *
+         * @param mat Dense matrix with as many rows as this matrix has cols
+         * @return Dense size() x mat.cols() Matrix
+         */
+        Matrix<TData> multiplyDense(const Matrix<TData> &mat) const
+        {
+            const TDerived &self = derived();
+            assert(self.size() == mat.rows() && "First matrix's cols must match second matrix's rows");
+            const size_t m = mat.cols();
+            Matrix<TData> r(self.size(), m);
+            parallelRanges(self.size(), self.storedSize() * m, [&](const size_t begin, const size_t end)
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    const TData *values = self.rowData(i);
+                    for (size_t k = self.rowBegin(i); k < self.rowEnd(i); ++k)
+                    {
+                        axpyKernel(m, values[k - self.rowBegin(i)], mat.data() + k * mat.stride(), r.data() + i * r.stride());
+                    }
+                }
+            });
+            return r;
+        }
+
+        /**
+         * Product with a dense matrix on the left. Each row of the result combines the stored rows of this matrix
+         * selected by the corresponding row of mat, rows of mat are split across threads.
+         *
+         * @param mat Dense matrix with as many cols as this matrix has rows
+         * @return Dense mat.rows() x size() Matrix
+         */
+        Matrix<TData> denseMultiply(const Matrix<TData> &mat) const
+        {
+            const TDerived &self = derived();
+            assert(mat.cols() == self.size() && "First matrix's cols must match second matrix's rows");
+            Matrix<TData> r(mat.rows(), self.size());
+            parallelRanges(mat.rows(), self.storedSize() * mat.rows(), [&](const size_t begin, const size_t end)
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    TData *r_row = r.data() + i * r.stride();
+                    for (size_t k = 0; k < self.size(); ++k)
+                    {
+                        const TData a = mat(i, k);
+                        if (a == TData(0))
+                        {
+                            continue;
+                        }
+                        axpyKernel(self.rowEnd(k) - self.rowBegin(k), a, self.rowData(k), r_row + self.rowBegin(k));
+                    }
+                }
+            });
+            return r;
+        }
+
+        /**
+         * Sum with a dense matrix of the same dimensions, the stored elements are added to a copy of mat.
+         */
+        Matrix<TData> addDense(const Matrix<TData> &mat) const
+        {
+            const TDerived &self = derived();
+            assert(mat.rows() == self.size() && mat.cols() == self.size() && "Two matrices must have the same dimensions");
+            Matrix<TData> r(mat);
+            for (size_t i = 0; i < self.size(); ++i)
+            {
+                const TData *values = self.rowData(i);
+                for (size_t j = self.rowBegin(i); j < self.rowEnd(i); ++j)
+                {
+                    r(i, j) += values[j - self.rowBegin(i)];
+                }
+            }
+            return r;
+        }
+
+        Matrix<TData> operator*(const Matrix<TData> &mat) const
+        {
+            return derived().multiplyDense(mat);
+        }
+
+        Matrix<TData> operator+(const Matrix<TData> &mat) const
+        {
+            return derived().addDense(mat);
+        }
+
+    protected:
+        static void checkSolvable()
+        {
+            static_assert(std::is_floating_point<TData>::value, "Solves require a floating point datatype");
+        }
+
+        // Divides the given cols of row i of x by pivot
+        static void divideRow(Matrix<TData> &x, const size_t i, const size_t col_begin, const size_t col_end, const TData pivot)
+        {
+            if (pivot == TData(0))
+            {
+                throw std::runtime_error("Matrix is singular");
+            }
+            TData *row = x.data() + i * x.stride();
+            for (size_t j = col_begin; j < col_end; ++j)
+            {
+                row[j] /= pivot;
+            }
+        }
+    };
+
+    template <typename TDerived, typename TData>
+    Matrix<TData> operator*(const Matrix<TData> &mat, const StructuredMatrix<TDerived, TData> &structured)
+    {
+        return structured.derived().denseMultiply(mat);
+    }
+
+    template <typename TDerived, typename TData>
+    Matrix<TData> operator+(const Matrix<TData> &mat, const StructuredMatrix<TDerived, TData> &structured)
+    {
+        return structured.derived().addDense(mat);
+    }
+
+    /**
+     * Diagonal matrix, only the diagonal is stored.
+     *
+     * @tparam TData
+     */
+    template <typename TData>
+    class DiagonalMatrix : public StructuredMatrix<DiagonalMatrix<TData>, TData>
+    {
+        using Base = StructuredMatrix<DiagonalMatrix<TData>, TData>;
+
+    public:
+        using Base::operator*;
+        using Base::operator+;
+
+        /**
+         * Constructor for a size x size zero matrix.
+         */
+        explicit DiagonalMatrix(const size_t size): m_diag(size, TData(0)) {}
+
+        /**
+         * Constructor from the diagonal elements.
+         */
+        explicit DiagonalMatrix(const std::vector<TData> &diag): m_diag(diag.begin(), diag.end()) {}
+
+        DiagonalMatrix(std::initializer_list<TData> diag): m_diag(diag.begin(), diag.end()) {}
+
+        size_t size() const { return m_diag.size(); }
+        size_t rowBegin(const size_t i) const { return i; }
+        size_t rowEnd(const size_t i) const { return i + 1; }
+        const TData *rowData(const size_t i) const { return m_diag.data() + i; }
+        size_t storedSize() const { return m_diag.size(); }
+
+        TData coeff(const size_t i, const size_t j) const
+        {
+            return (i == j) ? m_diag[i] : TData(0);
+        }
+
+        /**
+         * Reference to a diagonal element.
+         *  @throw std::out_of_range if i != j, the other elements are not stored
+         */
+        TData &operator()(const size_t i, const size_t j)
+        {
+            if (i != j || i >= size())
+            {
+                throw std::out_of_range("Element is not stored by a diagonal matrix");
+            }
+            return m_diag[i];
+        }
+
+        TData operator()(const size_t i, const size_t j) const
+        {
+            return coeff(i, j);
+        }
+
+        /**
+         * Scales the rows of mat by the diagonal.
+         */
+        Matrix<TData> multiplyDense(const Matrix<TData> &mat) const
+        {
+            assert(size() == mat.rows() && "First matrix's cols must match second matrix's rows");
+            Matrix<TData> r(mat.rows(), mat.cols());
+            parallelRanges(mat.rows(), mat.rows() * mat.cols(), [&](const size_t begin, const size_t end)
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    for (size_t j = 0; j < mat.cols(); ++j)
+                    {
+                        r(i, j) = m_diag[i] * mat(i, j);
+                    }
+                }
+            });
+            return r;
+        }
+
+        /**
+         * Scales the cols of mat by the diagonal.
+         */
+        Matrix<TData> denseMultiply(const Matrix<TData> &mat) const
+        {
+            assert(mat.cols() == size() && "First matrix's cols must match second matrix's rows");
+            Matrix<TData> r(mat.rows(), mat.cols());
+            parallelRanges(mat.rows(), mat.rows() * mat.cols(), [&](const size_t begin, const size_t end)
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    for (size_t j = 0; j < mat.cols(); ++j)
+                    {
+                        r(i, j) = mat(i, j) * m_diag[j];
+                    }
+                }
+            });
+            return r;
+        }
+
+        DiagonalMatrix operator*(const DiagonalMatrix &rhs) const
+        {
+            assert(size() == rhs.size() && "Two matrices must have the same dimensions");
+            DiagonalMatrix r(size());
+            for (size_t i = 0; i < size(); ++i)
+            {
+                r.m_diag[i] = m_diag[i] * rhs.m_diag[i];
+            }
+            return r;
+        }
+
+        DiagonalMatrix operator+(const DiagonalMatrix &rhs) const
+        {
+            assert(size() == rhs.size() && "Two matrices must have the same dimensions");
+            DiagonalMatrix r(size());
+            for (size_t i = 0; i < size(); ++i)
+            {
+                r.m_diag[i] = m_diag[i] + rhs.m_diag[i];
+            }
+            return r;
+        }
+
+        DiagonalMatrix transpose() const
+        {
+            return *this;
+        }
+
+        /**
+         * Solves this * x = b by dividing the rows of b by the diagonal.
+         *  @throw std::runtime_error if an element of the diagonal is zero
+         */
+        Matrix<TData> solve(const Matrix<TData> &b) const
+        {
+            Base::checkSolvable();
+            assert(b.rows() == size() && "Right-hand side must have as many rows as the matrix");
+            Matrix<TData> x(b);
+            for (size_t i = 0; i < size(); ++i)
+            {
+                Base::divideRow(x, i, 0, x.cols(), m_diag[i]);
+            }
+            return x;
+        }
+
+    private:
+        MatrixBuffer<TData> m_diag;
+    };
+
+    /**
+     * Square matrix whose non-zeros lie within kl diagonals below and ku diagonals above the main diagonal. Each row
+     * stores kl + ku + 1 elements, element (i, j) is located at index i * (kl + ku + 1) + j - i + kl. Storage of the
+     * first and last rows which falls outside of the matrix is kept at zero.
+     *
+     * @tparam TData
+     */
+    template <typename TData>
+    class BandedMatrix : public StructuredMatrix<BandedMatrix<TData>, TData>
+    {
+        using Base = StructuredMatrix<BandedMatrix<TData>, TData>;
+
+    public:
+        using Base::operator*;
+        using Base::operator+;
+
+        /**
+         * Constructor for a size x size zero matrix.
+         *  @param size
+         *  @param lower Number of diagonals below the main diagonal
+         *  @param upper Number of diagonals above the main diagonal
+         */
+        BandedMatrix(const size_t size, const size_t lower, const size_t upper):
+            m_size(size), m_lower(lower), m_upper(upper), m_data(size * (lower + upper + 1), TData(0))
+        {
+        }
+
+        /**
+         * Constructor from the band of a square dense matrix, elements outside of the band are dropped.
+         */
+        BandedMatrix(const Matrix<TData> &mat, const size_t lower, const size_t upper): BandedMatrix(mat.rows(), lower, upper)
+        {
+            assert(mat.rows() == mat.cols() && "Matrix must be square");
+            for (size_t i = 0; i < m_size; ++i)
+            {
+                std::copy(&mat(i, rowBegin(i)), &mat(i, 0) + rowEnd(i), &m_data[index(i, rowBegin(i))]);
+            }
+        }
+
+        size_t size() const { return m_size; }
+        size_t lower() const { return m_lower; }
+        size_t upper() const { return m_upper; }
+        size_t rowBegin(const size_t i) const { return (i > m_lower) ? i - m_lower : 0; }
+        size_t rowEnd(const size_t i) const { return std::min(m_size, i + m_upper + 1); }
+        const TData *rowData(const size_t i) const { return m_data.data() + index(i, rowBegin(i)); }
+        size_t storedSize() const { return m_data.size(); }
+
+        bool inBand(const size_t i, const size_t j) const
+        {
+            return i < m_size && j < m_size && j + m_lower >= i && j <= i + m_upper;
+        }
+
+        TData coeff(const size_t i, const size_t j) const
+        {
+            return inBand(i, j) ? m_data[index(i, j)] : TData(0);
+        }
+
+        /**
+         * Reference to an element of the band.
+         *  @throw std::out_of_range if (i, j) lies outside of the band
+         */
+        TData &operator()(const size_t i, const size_t j)
+        {
+            if (!inBand(i, j))
+            {
+                throw std::out_of_range("Element lies outside of the band");
+            }
+            return m_data[index(i, j)];
+        }
+
+        TData operator()(const size_t i, const size_t j) const
+        {
+            return coeff(i, j);
+        }
+
+        /**
+         * Product of two banded matrices, banded with the bandwidths summed.
+         */
+        BandedMatrix operator*(const BandedMatrix &rhs) const
+        {
+            assert(m_size == rhs.m_size && "Two matrices must have the same dimensions");
+            const size_t lower = std::min(m_lower + rhs.m_lower, std::max<size_t>(m_size, 1) - 1);
+            const size_t upper = std::min(m_upper + rhs.m_upper, std::max<size_t>(m_size, 1) - 1);
+            BandedMatrix r(m_size, lower, upper);
+            const size_t work = (m_lower + m_upper + 1) * (rhs.m_lower + rhs.m_upper + 1) * m_size;
+            parallelRanges(m_size, work, [&](const size_t begin, const size_t end)
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    for (size_t k = rowBegin(i); k < rowEnd(i); ++k)
+                    {
+                        axpyKernel(rhs.rowEnd(k) - rhs.rowBegin(k), m_data[index(i, k)], rhs.rowData(k),
+                            &r.m_data[r.index(i, rhs.rowBegin(k))]);
+                    }
+                }
+            });
+            return r;
+        }
+
+        /**
+         * Sum of two banded matrices, banded with the larger of each bandwidth.
+         */
+        BandedMatrix operator+(const BandedMatrix &rhs) const
+        {
+            assert(m_size == rhs.m_size && "Two matrices must have the same dimensions");
+            BandedMatrix r(m_size, std::max(m_lower, rhs.m_lower), std::max(m_upper, rhs.m_upper));
+            for (const BandedMatrix *operand : {this, &rhs})
+            {
+                for (size_t i = 0; i < m_size; ++i)
+                {
+                    const TData *values = operand->rowData(i);
+                    TData *r_values = &r.m_data[r.index(i, operand->rowBegin(i))];
+                    for (size_t j = 0; j < operand->rowEnd(i) - operand->rowBegin(i); ++j)
+                    {
+                        r_values[j] += values[j];
+                    }
+                }
+            }
+            return r;
+        }
+
+        BandedMatrix transpose() const
+        {
+            BandedMatrix r(m_size, m_upper, m_lower);
+            for (size_t i = 0; i < m_size; ++i)
+            {
+                for (size_t j = rowBegin(i); j < rowEnd(i); ++j)
+                {
+                    r.m_data[r.index(j, i)] = m_data[index(i, j)];
+                }
+            }
+            return r;
+        }
+
+        /**
+         * Solves this * x = b by Gaussian elimination with partial pivoting restricted to the band. Row swaps can
+         * extend the upper bandwidth of the eliminated matrix by lower, so a working copy with that much room is
+         * factored, costing O(size * lower * (lower + upper)) plus O(size * (2 * lower + upper)) per column of b.
+         *
+         * @param b Dense right-hand side with size() rows
+         * @return Dense solution x with the dimensions of b
+         * @throw std::runtime_error if the matrix is singular
+         */
+        Matrix<TData> solve(const Matrix<TData> &b) const
+        {
+            Base::checkSolvable();
+            assert(b.rows() == m_size && "Right-hand side must have as many rows as the matrix");
+            BandedMatrix lu(m_size, m_lower, m_lower + m_upper);
+            for (size_t i = 0; i < m_size; ++i)
+            {
+                std::copy(rowData(i), rowData(i) + (rowEnd(i) - rowBegin(i)), &lu.m_data[lu.index(i, rowBegin(i))]);
+            }
+            Matrix<TData> x(b);
+            const size_t m = x.cols();
+
+            for (size_t k = 0; k < m_size; ++k)
+            {
+                const size_t last_row = std::min(m_size, k + m_lower + 1);
+                size_t pivot = k;
+                for (size_t i = k + 1; i < last_row; ++i)
+                {
+                    if (std::abs(lu.m_data[lu.index(i, k)]) > std::abs(lu.m_data[lu.index(pivot, k)]))
+                    {
+                        pivot = i;
+                    }
+                }
+                if (lu.m_data[lu.index(pivot, k)] == TData(0))
+                {
+                    throw std::runtime_error("Matrix is singular");
+                }
+                const size_t length = lu.rowEnd(k) - k;
+                if (pivot != k)
+                {
+                    std::swap_ranges(&lu.m_data[lu.index(k, k)], &lu.m_data[lu.index(k, k)] + length, &lu.m_data[lu.index(pivot, k)]);
+                    std::swap_ranges(x.data() + k * x.stride(), x.data() + k * x.stride() + m, x.data() + pivot * x.stride());
+                }
+                const TData diag = lu.m_data[lu.index(k, k)];
+                for (size_t i = k + 1; i < last_row; ++i)
+                {
+                    const TData factor = lu.m_data[lu.index(i, k)] / diag;
+                    if (factor == TData(0))
+                    {
+                        continue;
+                    }
+                    lu.m_data[lu.index(i, k)] = TData(0);
+                    axpyKernel(length - 1, -factor, &lu.m_data[lu.index(k, k + 1)], &lu.m_data[lu.index(i, k + 1)]);
+                    axpyKernel(m, -factor, x.data() + k * x.stride(), x.data() + i * x.stride());
+                }
+            }
+
+            // Back substitution with the upper triangular factor
+            for (size_t i = m_size; i-- > 0;)
+            {
+                for (size_t j = i + 1; j < lu.rowEnd(i); ++j)
+                {
+                    axpyKernel(m, -lu.m_data[lu.index(i, j)], x.data() + j * x.stride(), x.data() + i * x.stride());
+                }
+                Base::divideRow(x, i, 0, m, lu.m_data[lu.index(i, i)]);
+            }
+            return x;
+        }
+
+    private:
+        size_t index(const size_t i, const size_t j) const
+        {
+            return i * (m_lower + m_upper + 1) + j + m_lower - i;
+        }
+
+        size_t m_size;
+        size_t m_lower;
+        size_t m_upper;
+        MatrixBuffer<TData> m_data;
+    };
+
+    enum class Triangle
+    {
+        // Non-zeros on and above the main diagonal
+        Upper,
+        // Non-zeros on and below the main diagonal
+        Lower
+    };
+
+    /**
+     * Upper or lower triangular matrix, stored packed row by row: row i of an upper triangular matrix holds cols
+     * [i, size) and row i of a lower triangular matrix holds cols [0, i].
+     *
+     * @tparam TData
+     * @tparam TTriangle
+     */
+    template <typename TData, Triangle TTriangle>
+    class TriangularMatrix : public StructuredMatrix<TriangularMatrix<TData, TTriangle>, TData>
+    {
+        using Base = StructuredMatrix<TriangularMatrix<TData, TTriangle>, TData>;
+
+    public:
+        using Base::operator*;
+        using Base::operator+;
+
+        /**
+         * Constructor for a size x size zero matrix.
+         */
+        explicit TriangularMatrix(const size_t size): m_size(size), m_data(size * (size + 1) / 2, TData(0)) {}
+
+        /**
+         * Constructor from the triangle of a square dense matrix, the elements of the other triangle are dropped.
+         */
+        explicit TriangularMatrix(const Matrix<TData> &mat): TriangularMatrix(mat.rows())
+        {
+            assert(mat.rows() == mat.cols() && "Matrix must be square");
+            for (size_t i = 0; i < m_size; ++i)
+            {
+                std::copy(&mat(i, rowBegin(i)), &mat(i, 0) + rowEnd(i), &m_data[rowOffset(i)]);
+            }
+        }
+
+        size_t size() const { return m_size; }
+        size_t rowBegin(const size_t i) const { return (TTriangle == Triangle::Upper) ? i : 0; }
+        size_t rowEnd(const size_t i) const { return (TTriangle == Triangle::Upper) ? m_size : i + 1; }
+        const TData *rowData(const size_t i) const { return m_data.data() + rowOffset(i); }
+        size_t storedSize() const { return m_data.size(); }
+
+        bool inTriangle(const size_t i, const size_t j) const
+        {
+            return i < m_size && j < m_size && ((TTriangle == Triangle::Upper) ? j >= i : j <= i);
+        }
+
+        TData coeff(const size_t i, const size_t j) const
+        {
+            return inTriangle(i, j) ? m_data[rowOffset(i) + j - rowBegin(i)] : TData(0);
+        }
+
+        /**
+         * Reference to an element of the triangle.
+         *  @throw std::out_of_range if (i, j) lies in the other triangle
+         */
+        TData &operator()(const size_t i, const size_t j)
+        {
+            if (!inTriangle(i, j))
+            {
+                throw std::out_of_range("Element lies outside of the triangle");
+            }
+            return m_data[rowOffset(i) + j - rowBegin(i)];
+        }
+
+        TData operator()(const size_t i, const size_t j) const
+        {
+            return coeff(i, j);
+        }
+
+        /**
+         * Product of two triangular matrices of the same kind, which is triangular as well.
+         */
+        TriangularMatrix operator*(const TriangularMatrix &rhs) const
+        {
+            assert(m_size == rhs.m_size && "Two matrices must have the same dimensions");
+            TriangularMatrix r(m_size);
+            parallelRanges(m_size, m_size * m_size * m_size / 6, [&](const size_t begin, const size_t end)
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    TData *r_row = r.m_data.data() + r.rowOffset(i) - rowBegin(i);
+                    for (size_t k = rowBegin(i); k < rowEnd(i); ++k)
+                    {
+                        axpyKernel(rhs.rowEnd(k) - rhs.rowBegin(k), coeff(i, k), rhs.rowData(k), r_row + rhs.rowBegin(k));
+                    }
+                }
+            });
+            return r;
+        }
+
+        TriangularMatrix operator+(const TriangularMatrix &rhs) const
+        {
+            assert(m_size == rhs.m_size && "Two matrices must have the same dimensions");
+            TriangularMatrix r(m_size);
+            for (size_t e = 0; e < m_data.size(); ++e)
+            {
+                r.m_data[e] = m_data[e] + rhs.m_data[e];
+            }
+            return r;
+        }
+
+        /**
+         * Transpose, a triangular matrix of the other kind.
+         */
+        TriangularMatrix<TData, (TTriangle == Triangle::Upper) ? Triangle::Lower : Triangle::Upper> transpose() const
+        {
+            TriangularMatrix<TData, (TTriangle == Triangle::Upper) ? Triangle::Lower : Triangle::Upper> r(m_size);
+            for (size_t i = 0; i < m_size; ++i)
+            {
+                for (size_t j = rowBegin(i); j < rowEnd(i); ++j)
+                {
+                    r(j, i) = m_data[rowOffset(i) + j - rowBegin(i)];
+                }
+            }
+            return r;
+        }
+
+        /**
+         * Solves this * x = b by forward substitution for a lower and back substitution for an upper triangular
+         * matrix. Whole rows of x are updated at once, and the cols of b are split across threads.
+         *
+         * @param b Dense right-hand side with size() rows
+         * @return Dense solution x with the dimensions of b
+         * @throw std::runtime_error if an element of the diagonal is zero
+         */
+        Matrix<TData> solve(const Matrix<TData> &b) const
+        {
+            Base::checkSolvable();
+            assert(b.rows() == m_size && "Right-hand side must have as many rows as the matrix");
+            Matrix<TData> x(b);
+            parallelRanges(x.cols(), m_data.size() * x.cols(), [&](const size_t begin, const size_t end)
+            {
+                for (size_t step = 0; step < m_size; ++step)
+                {
+                    const size_t i = (TTriangle == Triangle::Lower) ? step : m_size - 1 - step;
+                    TData *x_row = x.data() + i * x.stride() + begin;
+                    for (size_t j = rowBegin(i); j < rowEnd(i); ++j)
+                    {
+                        if (j != i)
+                        {
+                            axpyKernel(end - begin, -coeff(i, j), x.data() + j * x.stride() + begin, x_row);
+                        }
+                    }
+                    Base::divideRow(x, i, begin, end, coeff(i, i));
+                }
+            });
+            return x;
+        }
+
+    private:
+        size_t rowOffset(const size_t i) const
+        {
+            return (TTriangle == Triangle::Upper) ? i * (2 * m_size - i + 1) / 2 : i * (i + 1) / 2;
+        }
+
+        size_t m_size;
+        MatrixBuffer<TData> m_data;
+    };
+
+    template <typename TData>
+    using UpperTriangularMatrix = TriangularMatrix<TData, Triangle::Upper>;
+
+    template <typename TData>
+    using LowerTriangularMatrix = TriangularMatrix<TData, Triangle::Lower>;
+
+    /**
+     * Symmetric matrix, only the upper triangle is stored, packed as in UpperTriangularMatrix. Setting element (i, j)
+     * sets (j, i) as well.
+     *
+     * @tparam TData
+     */
+    template <typename TData>
+    class SymmetricMatrix : public StructuredMatrix<SymmetricMatrix<TData>, TData>
+    {
+        using Base = StructuredMatrix<SymmetricMatrix<TData>, TData>;
+
+    public:
+        using Base::operator*;
+        using Base::operator+;
+
+        /**
+         * Constructor for a size x size zero matrix.
+         */
+        explicit SymmetricMatrix(const size_t size): m_upper(size) {}
+
+        /**
+         * Constructor from the upper triangle of a square dense matrix, the lower triangle is assumed to mirror it.
+         */
+        explicit SymmetricMatrix(const Matrix<TData> &mat): m_upper(mat) {}
+
+        size_t size() const { return m_upper.size(); }
+        size_t storedSize() const { return m_upper.storedSize(); }
+
+        TData coeff(const size_t i, const size_t j) const
+        {
+            return (i <= j) ? m_upper.coeff(i, j) : m_upper.coeff(j, i);
+        }
+
+        TData &operator()(const size_t i, const size_t j)
+        {
+            return (i <= j) ? m_upper(i, j) : m_upper(j, i);
+        }
+
+        TData operator()(const size_t i, const size_t j) const
+        {
+            return coeff(i, j);
+        }
+
+        Matrix<TData> toDense() const
+        {
+            Matrix<TData> r(size(), size());
+            for (size_t i = 0; i < size(); ++i)
+            {
+                for (size_t j = i; j < size(); ++j)
+                {
+                    r(i, j) = r(j, i) = m_upper(i, j);
+                }
+            }
+            return r;
+        }
+
+        /**
+         * Product with a dense matrix on the right. Row i of the result combines the rows of mat weighted by the
+         * stored row i and, for the mirrored lower part, by col i of the stored upper triangle.
+         */
+        Matrix<TData> multiplyDense(const Matrix<TData> &mat) const
+        {
+            assert(size() == mat.rows() && "First matrix's cols must match second matrix's rows");
+            const size_t n = size(), m = mat.cols();
+            Matrix<TData> r(n, m);
+            parallelRanges(n, n * n * m, [&](const size_t begin, const size_t end)
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    TData *r_row = r.data() + i * r.stride();
+                    for (size_t k = 0; k < n; ++k)
+                    {
+                        axpyKernel(m, coeff(i, k), mat.data() + k * mat.stride(), r_row);
+                    }
+                }
+            });
+            return r;
+        }
+
+        /**
+         * Product with a dense matrix on the left. The stored part of row k contributes an axpy to cols [k, size)
+         * of the result, and its mirror a dot product to col k.
+         */
+        Matrix<TData> denseMultiply(const Matrix<TData> &mat) const
+        {
+            assert(mat.cols() == size() && "First matrix's cols must match second matrix's rows");
+            const size_t n = size();
+            Matrix<TData> r(mat.rows(), n);
+            parallelRanges(mat.rows(), n * n * mat.rows(), [&](const size_t begin, const size_t end)
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    const TData *mat_row = mat.data() + i * mat.stride();
+                    TData *r_row = r.data() + i * r.stride();
+                    for (size_t k = 0; k < n; ++k)
+                    {
+                        const TData *values = m_upper.rowData(k);
+                        axpyKernel(n - k, mat_row[k], values, r_row + k);
+                        r_row[k] += dotKernel(n - k - 1, mat_row + k + 1, values + 1);
+                    }
+                }
+            });
+            return r;
+        }
+
+        Matrix<TData> addDense(const Matrix<TData> &mat) const
+        {
+            assert(mat.rows() == size() && mat.cols() == size() && "Two matrices must have the same dimensions");
+            Matrix<TData> r(mat);
+            for (size_t i = 0; i < size(); ++i)
+            {
+                r(i, i) += m_upper(i, i);
+                for (size_t j = i + 1; j < size(); ++j)
+                {
+                    r(i, j) += m_upper(i, j);
+                    r(j, i) += m_upper(i, j);
+                }
+            }
+            return r;
+        }
+
+        SymmetricMatrix operator+(const SymmetricMatrix &rhs) const
+        {
+            SymmetricMatrix r(0);
+            r.m_upper = m_upper + rhs.m_upper;
+            return r;
+        }
+
+        SymmetricMatrix transpose() const
+        {
+            return *this;
+        }
+
+        /**
+         * Solves this * x = b with an LDL^T factorization of the packed upper triangle, without pivoting. The
+         * factorization updates whole stored rows and costs about size^3 / 3 multiply-adds, half of a dense LU.
+         *
+         * @param b Dense right-hand side with size() rows
+         * @return Dense solution x with the dimensions of b
+         * @throw std::runtime_error if a zero pivot is encountered, e.g. for a singular matrix
+         */
+        Matrix<TData> solve(const Matrix<TData> &b) const
+        {
+            Base::checkSolvable();
+            assert(b.rows() == size() && "Right-hand side must have as many rows as the matrix");
+            const size_t n = size();
+
+            // Factor into U^T * D * U with U unit upper triangular, D is kept on the diagonal of factor
+            UpperTriangularMatrix<TData> factor(m_upper);
+            for (size_t k = 0; k < n; ++k)
+            {
+                const TData d = factor(k, k);
+                if (d == TData(0))
+                {
+                    throw std::runtime_error("Matrix is singular or needs pivoting");
+                }
+                TData *row_k = &factor(k, k);
+                for (size_t i = k + 1; i < n; ++i)
+                {
+                    const TData f = row_k[i - k] / d;
+                    if (f != TData(0))
+                    {
+                        axpyKernel(n - i, -f, row_k + (i - k), &factor(i, i));
+                    }
+                }
+                for (size_t j = k + 1; j < n; ++j)
+                {
+                    row_k[j - k] /= d;
+                }
+            }
+
+            Matrix<TData> x(b);
+            const size_t m = x.cols();
+            for (size_t k = 0; k < n; ++k)
+            {
+                for (size_t j = k + 1; j < n; ++j)
+                {
+                    axpyKernel(m, -factor(k, j), x.data() + k * x.stride(), x.data() + j * x.stride());
+                }
+            }
+            for (size_t k = 0; k < n; ++k)
+            {
+                Base::divideRow(x, k, 0, m, factor(k, k));
+            }
+            for (size_t k = n; k-- > 0;)
+            {
+                for (size_t j = k + 1; j < n; ++j)
+                {
+                    axpyKernel(m, -factor(k, j), x.data() + j * x.stride(), x.data() + k * x.stride());
+                }
+            }
+            return x;
+        }
+
+    private:
+        UpperTriangularMatrix<TData> m_upper;
+    };
+} // end namespace MatrixLibrary
+
+#endif // #ifndef STRUCTURED_MATRIX_HPP
@@ -0,0 +1,333 @@
+/**
+ * @file thread_pool.hpp
+ * @author Alex Liu (alex.liuyining@outlook.com)
+ * @brief Persistent work-stealing thread pool shared by all parallel operations of the library
+ * @date 2021-12
+ */
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <thread>
+#include <future>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <exception>
+#include <algorithm>
+#include <chrono>
+
+namespace MatrixLibrary
+{
+    /**
+     * Thread pool with one task deque per worker. A worker pushes and pops tasks at the back of its own deque,
+     * and steals from the front of the other deques when its own is empty, so there is no shared queue that all
+     * threads contend on. Threads blocked waiting for tasks they submitted execute pending tasks in the meantime,
+     * which keeps nested parallel calls from deadlocking.
+     *
+     * The pool is started lazily by instance() and grows on demand up to max_workers threads.
+     */
+    class ThreadPool
+    {
+    public:
+        using Task = std::function<void()>;
+
+        // Upper bound on the number of worker threads, the deques are allocated once so that growing the pool is safe
+        static constexpr size_t max_workers = 256;
+
+        /**
+         * Get the library-wide pool, created on first use without any worker threads.
+         *
+         * @return ThreadPool&
+         */
+        static ThreadPool &instance()
+        {
+            static ThreadPool pool;
+            return pool;
+        }
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        ~ThreadPool()
+        {
+            m_stop = true;
+            {
+                std::lock_guard<std::mutex> lock(m_sleep_mtx);
+            }
+            m_sleep_cv.notify_all();
+            for (std::thread &worker : m_workers)
+            {
+                worker.join();
+            }
+        }
+
+        /**
+         * Getter for the number of worker threads currently started
+         *
+         * @return size_t
+         */
+        size_t size() const
+        {
+            return m_num_workers;
+        }
+
+        /**
+         * Starts worker threads until there are at least n_workers of them, capped at max_workers.
+         *
+         * @param n_workers
+         */
+        void ensureWorkers(size_t n_workers)
+        {
+            n_workers = std::min(n_workers, max_workers);
+            if (m_num_workers >= n_workers)
+            {
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(m_grow_mtx);
+            while (m_num_workers < n_workers)
+            {
+                const size_t index = m_num_workers;
+                m_workers.emplace_back(&ThreadPool::workerLoop, this, index);
+                ++m_num_workers;
+            }
+        }
+
+        /**
+         * Schedules a callable on the pool, starting a worker if there is none yet.
+         *
+         * @tparam TFunc
+         * @param func Callable taking no arguments
+         * @return std::future holding the result of func
+         */
+        template <typename TFunc>
+        auto submit(TFunc &&func) -> std::future<decltype(func())>
+        {
+            using TResult = decltype(func());
+            ensureWorkers(1);
+
+            auto task = std::make_shared<std::packaged_task<TResult()>>(std::forward<TFunc>(func));
+            std::future<TResult> future = task->get_future();
+            push([task]() { (*task)(); });
+            return future;
+        }
+
+        /**
+         * Calls func(i) for every i in [0, n_tasks) using at most n_threads threads, the calling thread included.
+         * Indices are handed out dynamically, so tasks of uneven cost are balanced across the threads.
+         * Returns once all calls have completed, and rethrows the first exception thrown by any of them.
+         *
+         * @param n_tasks
+         * @param n_threads
+         * @param func
+         */
+        void parallelFor(const size_t n_tasks, const size_t n_threads, const std::function<void(size_t)> &func)
+        {
+            const size_t n_runners = std::min(n_tasks, std::max<size_t>(n_threads, 1));
+            if (n_runners <= 1)
+            {
+                for (size_t i = 0; i < n_tasks; ++i)
+                {
+                    func(i);
+                }
+                return;
+            }
+            ensureWorkers(n_runners - 1);
+
+            struct Group
+            {
+                std::atomic<size_t> next_index{0};
+                std::atomic<size_t> remaining_runners{0};
+                std::mutex mtx;
+                std::condition_variable cv;
+                std::exception_ptr exception;
+            };
+            auto group = std::make_shared<Group>();
+            group->remaining_runners = n_runners;
+
+            auto runner = [group, n_tasks, &func]()
+            {
+                size_t i;
+                while ((i = group->next_index.fetch_add(1)) < n_tasks)
+                {
+                    try
+                    {
+                        func(i);
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard<std::mutex> lock(group->mtx);
+                        if (!group->exception)
+                        {
+                            group->exception = std::current_exception();
+                        }
+                        group->next_index = n_tasks;
+                    }
+                }
+                if (group->remaining_runners.fetch_sub(1) == 1)
+                {
+                    std::lock_guard<std::mutex> lock(group->mtx);
+                    group->cv.notify_all();
+                }
+            };
+
+            for (size_t r = 1; r < n_runners; ++r)
+            {
+                push(runner);
+            }
+            runner();
+
+            // Help with pending work, e.g. tasks submitted by nested calls, until the other runners are done
+            while (group->remaining_runners > 0)
+            {
+                if (tryRunPendingTask())
+                {
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(group->mtx);
+                group->cv.wait_for(lock, std::chrono::microseconds(100), [&group]() { return group->remaining_runners == 0; });
+            }
+
+            if (group->exception)
+            {
+                std::rethrow_exception(group->exception);
+            }
+        }
+
+        /**
+         * Runs a single pending task on the calling thread if one is available, used while waiting on results.
+         *
+         * @return true if a task was executed
+         */
+        bool tryRunPendingTask()
+        {
+            Task task;
+            if (pop(task, currentWorkerIndex()))
+            {
+                task();
+                return true;
+            }
+            return false;
+        }
+
+    private:
+        struct WorkerQueue
+        {
+            std::mutex mtx;
+            std::deque<Task> tasks;
+        };
+
+        ThreadPool() : m_queues(new WorkerQueue[max_workers]) {}
+
+        // Index of the worker owning the calling thread, or max_workers for threads outside the pool
+        static size_t &currentWorkerIndex()
+        {
+            thread_local size_t index = max_workers;
+            return index;
+        }
+
+        void push(Task task)
+        {
+            size_t index = currentWorkerIndex();
+            if (index >= m_num_workers)
+            {
+                index = m_next_queue.fetch_add(1) % m_num_workers;
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_queues[index].mtx);
+                m_queues[index].tasks.push_back(std::move(task));
+            }
+            m_pending.fetch_add(1);
+            if (m_sleeping > 0)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_sleep_mtx);
+                }
+                m_sleep_cv.notify_one();
+            }
+        }
+
+        // Pops from the back of the own deque first, then steals from the front of the others
+        bool pop(Task &task, const size_t own_index)
+        {
+            if (m_pending == 0)
+            {
+                return false;
+            }
+            const size_t n_queues = m_num_workers;
+            if (own_index < n_queues)
+            {
+                WorkerQueue &queue = m_queues[own_index];
+                std::lock_guard<std::mutex> lock(queue.mtx);
+                if (!queue.tasks.empty())
+                {
+                    task = std::move(queue.tasks.back());
+                    queue.tasks.pop_back();
+                    m_pending.fetch_sub(1);
+                    return true;
+                }
+            }
+
+            const size_t start = (own_index < n_queues) ? own_index + 1 : m_next_queue.load();
+            for (size_t offset = 0; offset < n_queues; ++offset)
+            {
+                const size_t victim = (start + offset) % n_queues;
+                if (victim == own_index)
+                {
+                    continue;
+                }
+                WorkerQueue &queue = m_queues[victim];
+                std::unique_lock<std::mutex> lock(queue.mtx, std::try_to_lock);
+                if (lock.owns_lock() && !queue.tasks.empty())
+                {
+                    task = std::move(queue.tasks.front());
+                    queue.tasks.pop_front();
+                    m_pending.fetch_sub(1);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void workerLoop(const size_t index)
+        {
+            currentWorkerIndex() = index;
+            Task task;
+            while (!m_stop)
+            {
+                if (pop(task, index))
+                {
+                    task();
+                    task = nullptr;
+                    continue;
+                }
+
+                // Sleep only when there is no pending work anywhere, pushers check m_sleeping before notifying
+                m_sleeping.fetch_add(1);
+                {
+                    std::unique_lock<std::mutex> lock(m_sleep_mtx);
+                    m_sleep_cv.wait(lock, [this]() { return m_stop || m_pending > 0; });
+                }
+                m_sleeping.fetch_sub(1);
+            }
+        }
+
+        std::unique_ptr<WorkerQueue[]> m_queues;
+        std::vector<std::thread> m_workers;
+        std::atomic<size_t> m_num_workers{0};
+        std::atomic<size_t> m_next_queue{0};
+        std::atomic<size_t> m_pending{0};
+        std::atomic<size_t> m_sleeping{0};
+        std::atomic<bool> m_stop{false};
+        std::mutex m_grow_mtx;
+        std::mutex m_sleep_mtx;
+        std::condition_variable m_sleep_cv;
+    };
+} // end namespace MatrixLibrary
+
+#endif // #ifndef THREAD_POOL_HPP
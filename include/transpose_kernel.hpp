@@ -0,0 +1,151 @@
+/**
+ * @file transpose_kernel.hpp
+ * @author Alex Liu (alex.liuyining@outlook.com)
+ * @brief Cache-oblivious out-of-place transpose and tiled in-place transpose of square matrices
+ * @date 2021-12
+ */
+
+#ifndef TRANSPOSE_KERNEL_HPP
+#define TRANSPOSE_KERNEL_HPP
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstring>
+#include "simd_kernels.hpp"
+#include "concurrency_utils.hpp"
+
+namespace MatrixLibrary
+{
+    // Blocks with both sides at most this long are transposed directly, small enough for source and destination to stay in L1
+    static constexpr size_t transpose_leaf_size = 16;
+
+    // Side of the tiles handed to each thread, and of the tiles swapped by the in-place transpose
+    static constexpr size_t transpose_tile_size = 256;
+
+    // Matrices with fewer elements than this are transposed on the calling thread only
+    static constexpr size_t transpose_parallel_threshold = 1 << 16;
+
+    /**
+     * Cache-oblivious transpose dst(j, i) = src(i, j): the longer side of the block is halved recursively until
+     * the block fits in cache at any level, then the SIMD block kernel is used. Split points are kept at multiples
+     * of 4 so that the 4 x 4 SIMD blocks are not cut.
+     *
+     * @tparam TData
+     * @param rows Number of rows of src
+     * @param cols Number of columns of src
+     * @param src
+     * @param lds Row stride of src
+     * @param dst
+     * @param ldd Row stride of dst
+     */
+    template <typename TData>
+    void transposeRecursive(const size_t rows, const size_t cols, const TData *src, const size_t lds, TData *dst, const size_t ldd)
+    {
+        if (rows <= transpose_leaf_size && cols <= transpose_leaf_size)
+        {
+            transposeKernel(rows, cols, src, lds, dst, ldd);
+        }
+        else if (rows >= cols)
+        {
+            const size_t half = ((rows / 2 + 3) / 4) * 4;
+            transposeRecursive(half, cols, src, lds, dst, ldd);
+            transposeRecursive(rows - half, cols, src + half * lds, lds, dst + half, ldd);
+        }
+        else
+        {
+            const size_t half = ((cols / 2 + 3) / 4) * 4;
+            transposeRecursive(rows, half, src, lds, dst, ldd);
+            transposeRecursive(rows, cols - half, src + half, lds, dst + half * ldd, ldd);
+        }
+    }
+
+    /**
+     * Out-of-place transpose dst(j, i) = src(i, j), split into tiles that are transposed in parallel on the thread pool
+     * when the matrix is large enough.
+     *
+     * @tparam TData
+     * @param rows Number of rows of src
+     * @param cols Number of columns of src
+     * @param src
+     * @param lds Row stride of src
+     * @param dst
+     * @param ldd Row stride of dst
+     * @param n_threads
+     */
+    template <typename TData>
+    void transposeMatrix(const size_t rows, const size_t cols, const TData *src, const size_t lds, TData *dst, const size_t ldd, const size_t n_threads)
+    {
+        if (n_threads <= 1 || rows * cols < transpose_parallel_threshold)
+        {
+            transposeRecursive(rows, cols, src, lds, dst, ldd);
+            return;
+        }
+
+        const size_t tiles_m = (rows + transpose_tile_size - 1) / transpose_tile_size;
+        const size_t tiles_n = (cols + transpose_tile_size - 1) / transpose_tile_size;
+        parallelFor(tiles_m * tiles_n, n_threads, [&](const size_t tile)
+        {
+            const size_t i = (tile / tiles_n) * transpose_tile_size;
+            const size_t j = (tile % tiles_n) * transpose_tile_size;
+            transposeRecursive(std::min(transpose_tile_size, rows - i), std::min(transpose_tile_size, cols - j),
+                src + i * lds + j, lds, dst + j * ldd + i, ldd);
+        });
+    }
+
+    /**
+     * Transposes an n x n matrix in place. The matrix is divided into tiles, each tile above the diagonal is swapped
+     * with its mirror tile below the diagonal while both are transposed, and diagonal tiles are transposed on their own.
+     * Tiles are staged through a small per-thread buffer so that all copies use the SIMD block kernel.
+     *
+     * @tparam TData
+     * @param n
+     * @param data
+     * @param ld Row stride of data
+     * @param n_threads
+     */
+    template <typename TData>
+    void transposeInPlaceSquare(const size_t n, TData *data, const size_t ld, const size_t n_threads)
+    {
+        const size_t n_tiles = (n + transpose_tile_size - 1) / transpose_tile_size;
+
+        // Tile pairs (bi, bj) with bi <= bj, listed once so that the triangular workload is balanced across threads
+        std::vector<std::pair<size_t, size_t>> pairs;
+        pairs.reserve(n_tiles * (n_tiles + 1) / 2);
+        for (size_t bi = 0; bi < n_tiles; ++bi)
+        {
+            for (size_t bj = bi; bj < n_tiles; ++bj)
+            {
+                pairs.emplace_back(bi, bj);
+            }
+        }
+
+        const size_t threads = (n * n < transpose_parallel_threshold) ? 1 : n_threads;
+        parallelFor(pairs.size(), threads, [&](const size_t p)
+        {
+            thread_local std::vector<TData> buffer;
+            buffer.resize(transpose_tile_size * transpose_tile_size);
+
+            const size_t r = pairs[p].first * transpose_tile_size;
+            const size_t c = pairs[p].second * transpose_tile_size;
+            const size_t h = std::min(transpose_tile_size, n - r);
+            const size_t w = std::min(transpose_tile_size, n - c);
+            TData *upper = data + r * ld + c;
+            TData *lower = data + c * ld + r;
+
+            // buffer = upper^T, a w x h block
+            transposeRecursive(h, w, upper, ld, buffer.data(), h);
+            if (r != c)
+            {
+                // upper = lower^T, lower is w x h
+                transposeRecursive(w, h, lower, ld, upper, ld);
+            }
+            for (size_t i = 0; i < w; ++i)
+            {
+                std::memcpy(lower + i * ld, buffer.data() + i * h, h * sizeof(TData));
+            }
+        });
+    }
+} // end namespace MatrixLibrary
+
+#endif // #ifndef TRANSPOSE_KERNEL_HPP
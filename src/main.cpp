@@ -3,7 +3,7 @@
 #include <iostream>
 #include <stdexcept>
 #include <random>
-#include <chrono>
+#include <cmath>
 #include <algorithm>
 #include <unordered_map>
 #include <functional>
@@ -113,46 +113,38 @@ void testLargeDimensionMultiplication(const size_t rows, const size_t cols)
 
     std::vector<std::vector<TData>> data(rows, std::vector<TData>(cols));
 
-    std::chrono::time_point<std::chrono::high_resolution_clock> startTime;
-    double timeElapsed;
-
     // Populate data with randomly generated values
     for (size_t i = 0; i < rows; ++i)
     {
         std::generate(data[i].begin(), data[i].end(), [&distribution, &dre]{ return (TData)distribution(dre); });
     }
 
-    // Create Matrix instances, both with identical values
+    // The second operand is the matrix itself, or its transpose which gemm reads directly without forming it
     Matrix<TData> mat1(std::move(data));
-    Matrix<TData> mat2;
+    const Transpose trans = (rows == cols) ? Transpose::NoTrans : Transpose::Trans;
 
-    if (rows == cols)
-    {
-        mat2 = mat1;
-    }
-    else
+    // Timings are measured by the MatrixBenchmarks target, here the multi-threaded result is checked against a single thread
+    Matrix<TData> mat3(rows, rows);
+    Matrix<TData> mat4(rows, rows);
+    gemm(TData(1), mat1, Transpose::NoTrans, mat1, trans, TData(0), mat3);
+    setNumThreads(1);
+    gemm(TData(1), mat1, Transpose::NoTrans, mat1, trans, TData(0), mat4);
+    double max_difference = 0.0;
+    for (size_t i = 0; i < mat3.rows(); ++i)
     {
-        mat2 = mat1.transpose();
+        for (size_t j = 0; j < mat3.cols(); ++j)
+        {
+            max_difference = std::max(max_difference, std::abs((double)mat3(i, j) - (double)mat4(i, j)));
+        }
     }
-
-    startTime = std::chrono::high_resolution_clock::now();
-    auto mat3 = std::move(mat1 * mat2);
-    timeElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - startTime).count();
-    std::cout << "Computation time with user-defined number of threads: " << timeElapsed << " ms" << std::endl;
-
-    // Get baseline time result without multithreading
-    setNumThreads(1);
-    startTime = std::chrono::high_resolution_clock::now();
-    auto mat4 = std::move(mat1 * mat2);
-    timeElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - startTime).count();
-    std::cout << "Computation time without multithreading: " << timeElapsed << " ms" << std::endl;
+    std::cout << "Largest difference between the results with and without multithreading: " << max_difference << std::endl;
 
     if (rows <= 20 && cols <= 20)
     {
         std::cout << "Matrix 1:" << std::endl;
         mat1.printData();
         std::cout << "Matrix 2:" << std::endl;
-        mat2.printData();
+        ((rows == cols) ? mat1 : mat1.transpose()).printData();
         std::cout << "Result:" << std::endl;
         mat3.printData();
     }
@@ -169,9 +161,6 @@ int main(int argc, char *argv[])
     size_t cols = 3, rows = 3;
     char testDataType = 'a';
 
-    // Whether or not to print messages for Matrix instantiation
-    setPrintMemoryInfo(false);
-
     if (argc == 5)
     {
         try
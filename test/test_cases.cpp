@@ -1,8 +1,32 @@
 #include <gtest/gtest.h>
 #include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <cstdio>
+#include <string>
+#include <limits>
+#include <sstream>
+#include <fstream>
 #include "matrix_library.hpp"
 #include "identity_matrix.hpp"
+#include "fixed_matrix.hpp"
+#include "sparse_matrix.hpp"
+#include "matrix_io.hpp"
+#include "out_of_core.hpp"
+#include "batched_gemm.hpp"
+#include "matrix_allocator.hpp"
+#include "dense_vector.hpp"
+#include "quantized_gemm.hpp"
+#include "structured_matrix.hpp"
+#include "matrix_decompositions.hpp"
+#include "async_matrix.hpp"
+#include "matrix_chain.hpp"
+#include "instrumentation.hpp"
 #include "concurrency_utils.hpp"
+#include "thread_pool.hpp"
 
 using namespace MatrixLibrary;
 
@@ -11,7 +35,6 @@ class MatrixTest : public ::testing::Test
     protected:
     void SetUp() override 
     {
-        setPrintMemoryInfo(false);
         setNumThreads(2);
     }    
 };
@@ -141,4 +164,1251 @@ TEST_F(MatrixTest, TestTranspose)
                                                      {0, 2, 1}};
 
     EXPECT_EQ(mat1.transpose().getData(), expected_result);
-}
\ No newline at end of file
+}
+
+TEST_F(MatrixTest, TestContiguousStorage)
+{
+    Matrix<int> mat({{1, 2, 3},
+                     {4, 5, 6}});
+
+    EXPECT_EQ(mat.stride(), 3u);
+    EXPECT_EQ(std::vector<int>(mat.data(), mat.data() + 6), std::vector<int>({1, 2, 3, 4, 5, 6}));
+    EXPECT_EQ(mat(1, 2), 6);
+
+    mat(0, 1) = 7;
+    std::vector<std::vector<int>> expected_result {{1, 7, 3},
+                                                   {4, 5, 6}};
+    EXPECT_EQ(mat.getData(), expected_result);
+
+    Matrix<int> mat_flat(2, 3, std::vector<int> {1, 7, 3, 4, 5, 6});
+    EXPECT_EQ(mat_flat.getData(), expected_result);
+}
+
+TEST_F(MatrixTest, TestBlockedMultiplication)
+{
+    // Dimensions chosen to not be multiples of any blocking parameter, so that all edge cases are exercised
+    const size_t rows = 131, inner = 301, cols = 77;
+    std::vector<std::vector<double>> data1(rows, std::vector<double>(inner));
+    std::vector<std::vector<double>> data2(inner, std::vector<double>(cols));
+    for (size_t i = 0; i < rows; ++i)
+    {
+        for (size_t k = 0; k < inner; ++k)
+        {
+            data1[i][k] = (double)((i * 7 + k * 3) % 11) - 5.0;
+        }
+    }
+    for (size_t k = 0; k < inner; ++k)
+    {
+        for (size_t j = 0; j < cols; ++j)
+        {
+            data2[k][j] = (double)((k * 5 + j) % 13) - 6.0;
+        }
+    }
+
+    std::vector<std::vector<double>> expected_result(rows, std::vector<double>(cols));
+    for (size_t i = 0; i < rows; ++i)
+    {
+        for (size_t j = 0; j < cols; ++j)
+        {
+            for (size_t k = 0; k < inner; ++k)
+            {
+                expected_result[i][j] += data1[i][k] * data2[k][j];
+            }
+        }
+    }
+
+    Matrix<double> mat1(data1), mat2(data2);
+    EXPECT_EQ((mat1 * mat2).getData(), expected_result);
+
+    setNumThreads(1);
+    EXPECT_EQ((mat1 * mat2).getData(), expected_result);
+}
+
+TEST_F(MatrixTest, TestSimdLevels)
+{
+    const SimdLevel detected = getSimdLevel();
+    const size_t rows = 67, inner = 45, cols = 39;
+    std::vector<std::vector<float>> data1(rows, std::vector<float>(inner));
+    std::vector<std::vector<float>> data2(inner, std::vector<float>(cols));
+    for (size_t i = 0; i < rows; ++i)
+    {
+        for (size_t k = 0; k < inner; ++k)
+        {
+            data1[i][k] = (float)((i + 2 * k) % 7) - 3.0f;
+        }
+    }
+    for (size_t k = 0; k < inner; ++k)
+    {
+        for (size_t j = 0; j < cols; ++j)
+        {
+            data2[k][j] = (float)((3 * k + j) % 5) - 2.0f;
+        }
+    }
+    Matrix<float> mat1(data1), mat2(data2);
+    Matrix<double> mat1_d(rows, inner), mat2_d(inner, cols);
+    Matrix<int> mat1_i(rows, inner), mat2_i(inner, cols);
+    for (size_t i = 0; i < rows; ++i)
+    {
+        for (size_t k = 0; k < inner; ++k)
+        {
+            mat1_d(i, k) = mat1(i, k);
+            mat1_i(i, k) = (int)mat1(i, k);
+        }
+    }
+    for (size_t k = 0; k < inner; ++k)
+    {
+        for (size_t j = 0; j < cols; ++j)
+        {
+            mat2_d(k, j) = mat2(k, j);
+            mat2_i(k, j) = (int)mat2(k, j);
+        }
+    }
+
+    // Results computed with the scalar kernels serve as reference for all vectorized levels
+    setSimdLevel(SimdLevel::Scalar);
+    const auto expected_prod = (mat1 * mat2).getData();
+    const auto expected_prod_d = (mat1_d * mat2_d).getData();
+    const auto expected_prod_i = (mat1_i * mat2_i).getData();
+    const auto expected_sum = (mat1 + mat1).getData();
+    const auto expected_trans = mat1.transpose().getData();
+    const auto expected_trans_d = mat1_d.transpose().getData();
+
+    for (const SimdLevel level : {SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512})
+    {
+        setSimdLevel(level);
+        EXPECT_EQ((mat1 * mat2).getData(), expected_prod);
+        EXPECT_EQ((mat1_d * mat2_d).getData(), expected_prod_d);
+        EXPECT_EQ((mat1_i * mat2_i).getData(), expected_prod_i);
+        EXPECT_EQ((mat1 + mat1).getData(), expected_sum);
+        EXPECT_EQ(mat1.transpose().getData(), expected_trans);
+        EXPECT_EQ(mat1_d.transpose().getData(), expected_trans_d);
+    }
+    setSimdLevel(detected);
+}
+
+TEST_F(MatrixTest, TestThreadPool)
+{
+    ThreadPool &pool = ThreadPool::instance();
+    EXPECT_EQ(pool.submit([]() { return 42; }).get(), 42);
+
+    // Nested calls must not deadlock, since waiting threads execute pending tasks
+    std::vector<std::atomic<int>> counts(64);
+    parallelFor(8, 4, [&counts](const size_t i)
+    {
+        parallelFor(8, 4, [&counts, i](const size_t j)
+        {
+            ++counts[i * 8 + j];
+        });
+    });
+    for (const std::atomic<int> &count : counts)
+    {
+        EXPECT_EQ(count.load(), 1);
+    }
+    EXPECT_LE(pool.size(), ThreadPool::max_workers);
+
+    EXPECT_THROW(parallelFor(16, 4, [](const size_t i)
+    {
+        if (i == 5)
+        {
+            throw std::runtime_error("task failed");
+        }
+    }), std::runtime_error);
+}
+
+TEST_F(MatrixTest, TestTilePartition)
+{
+    // Short-wide times tall-skinny: the 8 x 8 result cannot be split, so the inner dimension is
+    const TilePartition skinny = partitionMultiplication<int>(8, 8, 100000, 8);
+    EXPECT_GT(skinny.parts_k, 1u);
+    EXPECT_GE(skinny.tile_depth * skinny.parts_k, 100000u);
+
+    // Large square products are split in both dimensions of the result only
+    const TilePartition square = partitionMultiplication<double>(1024, 1024, 1024, 4);
+    EXPECT_GT(square.parts_m, 1u);
+    EXPECT_GT(square.parts_n, 1u);
+    EXPECT_EQ(square.parts_k, 1u);
+    EXPECT_GE(square.parts_m * square.parts_n, 4u);
+
+    const size_t rows = 6, inner = 20000, cols = 5;
+    Matrix<int> mat1(rows, inner), mat2(inner, cols);
+    std::vector<std::vector<int>> expected_result(rows, std::vector<int>(cols));
+    for (size_t k = 0; k < inner; ++k)
+    {
+        for (size_t i = 0; i < rows; ++i)
+        {
+            mat1(i, k) = (int)((i + k) % 3) - 1;
+        }
+        for (size_t j = 0; j < cols; ++j)
+        {
+            mat2(k, j) = (int)((k * j) % 5) - 2;
+        }
+        for (size_t i = 0; i < rows; ++i)
+        {
+            for (size_t j = 0; j < cols; ++j)
+            {
+                expected_result[i][j] += mat1(i, k) * mat2(k, j);
+            }
+        }
+    }
+
+    setNumThreads(4);
+    EXPECT_EQ((mat1 * mat2).getData(), expected_result);
+
+    // Products with an empty inner dimension leave the result zero rather than partitioning zero-sized tiles
+    std::vector<int> result(9, 7);
+    multiplyMatricesAsync(result.data(), 3, mat1.data(), mat1.stride(), mat2.data(), mat2.stride(), 3, 0, 3, 4);
+    EXPECT_EQ(result, std::vector<int>(9, 7));
+    EXPECT_EQ((mat1.block(0, 0, 3, 0) * mat2.block(0, 0, 0, 3)).getData(), std::vector<std::vector<int>>(3, std::vector<int>(3, 0)));
+}
+
+TEST_F(MatrixTest, TestExpressions)
+{
+    Matrix<double> mat1({{1.0, 2.0},
+                         {3.0, 4.0}});
+    Matrix<double> mat2({{0.5, 0.5},
+                         {1.0, -1.0}});
+    Matrix<double> mat3({{2.0, 0.0},
+                         {0.0, 2.0}});
+
+    Matrix<double> result = mat1 + mat2 - mat3;
+    std::vector<std::vector<double>> expected_result {{-0.5, 2.5},
+                                                      {4.0, 1.0}};
+    EXPECT_EQ(result.getData(), expected_result);
+
+    result = 2.0 * mat1 - mat2 / 0.5 + (-mat3);
+    expected_result = {{-1.0, 3.0},
+                       {4.0, 8.0}};
+    EXPECT_EQ(result.getData(), expected_result);
+
+    // Reading the destination in transposed order is evaluated through a temporary
+    result = mat1;
+    result += result.transposed();
+    expected_result = {{2.0, 5.0},
+                       {5.0, 8.0}};
+    EXPECT_EQ(result.getData(), expected_result);
+
+    result = result.transposed() - mat1;
+    expected_result = {{1.0, 3.0},
+                       {2.0, 4.0}};
+    EXPECT_EQ(result.getData(), expected_result);
+
+    result *= 0.5;
+    expected_result = {{0.5, 1.5},
+                       {1.0, 2.0}};
+    EXPECT_EQ(result.getData(), expected_result);
+
+    // Products with expression operands evaluate them first
+    expected_result = {{-3.5, 8.5},
+                       {-2.0, 8.0}};
+    EXPECT_EQ(((mat1 + mat2) * (mat3 - mat2 * 2.0)).getData(), expected_result);
+    expected_result = {{2.0, 5.0},
+                       {5.0, 8.0}};
+    EXPECT_EQ((mat3 * (mat1 + mat1.transposed()) / 2.0).getData(), expected_result);
+
+    // Temporary Matrix operands are moved into the expression, which stays valid after the statement creating it
+    auto sum = (mat1 * mat3) + mat2;
+    auto scaled = -((mat1 * mat3).transposed() * 2.0);
+    auto both = (mat1 * mat3) - mat1.transpose();
+    const Matrix<double> product = mat1 * mat3;
+    EXPECT_EQ(Matrix<double>(sum).getData(), Matrix<double>(product + mat2).getData());
+    EXPECT_EQ(Matrix<double>(scaled).getData(), Matrix<double>(product.transposed() * -2.0).getData());
+    EXPECT_EQ(Matrix<double>(both).getData(), Matrix<double>(product - mat1.transposed()).getData());
+}
+
+TEST_F(MatrixTest, TestViews)
+{
+    Matrix<int> mat({{1, 2, 3, 4},
+                     {5, 6, 7, 8},
+                     {9, 10, 11, 12}});
+
+    std::vector<std::vector<int>> expected_block {{6, 7},
+                                                  {10, 11}};
+    EXPECT_EQ(mat.block(1, 1, 2, 2).getData(), expected_block);
+    EXPECT_EQ(mat.row(2).getData(), std::vector<std::vector<int>>({{9, 10, 11, 12}}));
+    EXPECT_EQ(mat.col(3).getData(), std::vector<std::vector<int>>({{4}, {8}, {12}}));
+    EXPECT_EQ(mat.block(1, 1, 2, 2).stride(), 4u);
+    EXPECT_THROW(mat.block(2, 2, 2, 2), std::out_of_range);
+
+    // Views take part in products and expressions without copying their data
+    Matrix<int> mat2({{1, 0},
+                      {0, 2}});
+    std::vector<std::vector<int>> expected_prod {{6, 14},
+                                                 {10, 22}};
+    EXPECT_EQ((mat.block(1, 1, 2, 2) * mat2).getData(), expected_prod);
+    EXPECT_EQ((mat2 * mat.block(1, 1, 2, 2).transposed()).getData(), std::vector<std::vector<int>>({{6, 10}, {14, 22}}));
+    EXPECT_EQ((mat.row(0).block(0, 0, 1, 3) * mat.col(0)).getData(), std::vector<std::vector<int>>({{1 + 10 + 27}}));
+
+    // Writing through views updates the viewed Matrix in place
+    mat.block(0, 0, 2, 2) = mat.block(1, 2, 2, 2) + mat2;
+    mat.col(3) *= 2;
+    mat.row(2) -= mat.row(2);
+    std::vector<std::vector<int>> expected_result {{8, 8, 3, 8},
+                                                   {11, 14, 7, 16},
+                                                   {0, 0, 0, 0}};
+    EXPECT_EQ(mat.getData(), expected_result);
+
+    // Overlapping source and destination are evaluated through a temporary
+    Matrix<int> shifted({{1, 2, 3}});
+    shifted.block(0, 1, 1, 2) = shifted.block(0, 0, 1, 2);
+    EXPECT_EQ(shifted.getData(), std::vector<std::vector<int>>({{1, 1, 2}}));
+}
+
+TEST_F(MatrixTest, TestLargeTranspose)
+{
+    // Sizes straddle the leaf, SIMD block and tile sizes so that every edge case of the recursion is exercised
+    for (const std::pair<size_t, size_t> &dims : {std::make_pair<size_t, size_t>(1, 7), std::make_pair<size_t, size_t>(37, 70),
+                                                  std::make_pair<size_t, size_t>(300, 517), std::make_pair<size_t, size_t>(515, 515)})
+    {
+        Matrix<double> mat(dims.first, dims.second);
+        for (size_t i = 0; i < dims.first; ++i)
+        {
+            for (size_t j = 0; j < dims.second; ++j)
+            {
+                mat(i, j) = (double)(i * dims.second + j);
+            }
+        }
+
+        std::vector<std::vector<double>> expected_result(dims.second, std::vector<double>(dims.first));
+        for (size_t i = 0; i < dims.first; ++i)
+        {
+            for (size_t j = 0; j < dims.second; ++j)
+            {
+                expected_result[j][i] = mat(i, j);
+            }
+        }
+
+        EXPECT_EQ(mat.transpose().getData(), expected_result);
+        setNumThreads(1);
+        EXPECT_EQ(mat.transpose().getData(), expected_result);
+        setNumThreads(2);
+
+        const double *data_before = mat.data();
+        mat.transposeInPlace();
+        EXPECT_EQ(mat.getData(), expected_result);
+        if (dims.first == dims.second)
+        {
+            EXPECT_EQ(mat.data(), data_before);
+        }
+    }
+}
+
+TEST_F(MatrixTest, TestStrassen)
+{
+    // Small integer values keep every intermediate exact in double, so both algorithms must agree exactly.
+    // 100 is padded to 104 = 13 * 2^3 with a crossover of 16
+    const size_t n = 100;
+    Matrix<double> A(n, n), B(n, n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        for (size_t j = 0; j < n; ++j)
+        {
+            A(i, j) = (double)((int)((i * 7 + j * 3) % 11) - 5);
+            B(i, j) = (double)((int)((i * 5 + j * 13) % 9) - 4);
+        }
+    }
+    const auto expected_result = (A * B).getData();
+
+    setStrassenCrossover(16);
+    setMultiplicationAlgorithm(MultiplicationAlgorithm::Strassen);
+    EXPECT_EQ((A * B).getData(), expected_result);
+    setNumThreads(1);
+    EXPECT_EQ((A * B).getData(), expected_result);
+    setNumThreads(2);
+
+    // Non-square products fall back to the classical algorithm
+    EXPECT_EQ((A.block(0, 0, n, n - 1) * B.block(0, 0, n - 1, n)).getDimensions(), std::make_pair(n, n));
+
+    Matrix<float> C(67, 67), D(67, 67);
+    for (size_t i = 0; i < 67; ++i)
+    {
+        for (size_t j = 0; j < 67; ++j)
+        {
+            C(i, j) = 1.0f / (float)(i + j + 1);
+            D(i, j) = (float)std::sin((double)(i * 67 + j));
+        }
+    }
+    const StrassenErrorReport report = measureStrassenError(C, D, 8);
+    EXPECT_LT(report.relative_error, 1e-5);
+    EXPECT_LT(report.max_abs_error, 1e-4);
+
+    setMultiplicationAlgorithm(MultiplicationAlgorithm::Classical);
+    setStrassenCrossover(512);
+}
+
+TEST_F(MatrixTest, TestFixedMatrix)
+{
+    // Evaluated at compile time
+    constexpr Matrix3<int> rotation(0, -1, 0,
+                                    1, 0, 0,
+                                    0, 0, 1);
+    constexpr Matrix3<int> full_turn = rotation * rotation * rotation * rotation;
+    static_assert(full_turn == Matrix3<int>::identity(), "Four quarter turns must give the identity");
+    static_assert(rotation.transpose() * rotation == Matrix3<int>::identity(), "A rotation must be orthogonal");
+
+    FixedMatrix<double, 2, 3> mat(1.0, 2.0, 3.0,
+                                  4.0, 5.0, 6.0);
+    FixedMatrix<double, 3, 2> mat_mult(7.0, 8.0,
+                                       9.0, 10.0,
+                                       11.0, 12.0);
+    std::vector<std::vector<double>> expected_result {{58.0, 64.0},
+                                                      {139.0, 154.0}};
+    EXPECT_EQ((mat * mat_mult).getData(), expected_result);
+    EXPECT_EQ(mat.transpose().getData(), mat.toMatrix().transpose().getData());
+    EXPECT_EQ((2 * mat - mat + mat / 2.0).getData(), (mat * 1.5).getData());
+
+    // Scalars promote as they do with Matrix
+    constexpr Matrix2<int> ints(1, 2, 3, 4);
+    static_assert(std::is_same<decltype(2.5 * ints), Matrix2<double>>::value, "A fractional scalar must promote an integer FixedMatrix");
+    static_assert(2.5 * ints == Matrix2<double>(2.5, 5.0, 7.5, 10.0), "A fractional scalar must not be truncated");
+    static_assert(ints / 2.0 == Matrix2<double>(0.5, 1.0, 1.5, 2.0), "Division by a fractional scalar must not be truncated");
+    static_assert(ints / 2 == Matrix2<int>(0, 1, 1, 2), "Integer division stays integral");
+
+    // Conversions to and from Matrix
+    Matrix<double> dense = mat * mat_mult;
+    EXPECT_EQ((Matrix<double>(mat) * Matrix<double>(mat_mult)).getData(), dense.getData());
+    EXPECT_TRUE((FixedMatrix<double, 2, 2>(dense) == mat * mat_mult));
+    EXPECT_THROW((FixedMatrix<double, 3, 3>(dense)), std::invalid_argument);
+}
+
+TEST_F(MatrixTest, TestSparseMatrix)
+{
+    auto dense = Matrix<double>(std::vector<std::vector<double>> {{0.0, 2.0, 0.0, 0.0},
+                                                                  {1.0, 0.0, 0.0, 3.0},
+                                                                  {0.0, 0.0, 0.0, 0.0},
+                                                                  {0.0, 4.0, 5.0, 0.0},
+                                                                  {6.0, 0.0, 0.0, 7.0}});
+    // Unordered triplets with a duplicate, (1, 3) = 1 + 2
+    std::vector<Triplet<double>> triplets {{4, 3, 7.0}, {0, 1, 2.0}, {1, 3, 1.0}, {3, 2, 5.0}, {1, 0, 1.0},
+                                           {3, 1, 4.0}, {4, 0, 6.0}, {1, 3, 2.0}};
+    Matrix<double> other(4, 3);
+    Matrix<double> left(3, 5);
+    for (size_t i = 0; i < 4; ++i)
+    {
+        for (size_t j = 0; j < 3; ++j)
+        {
+            other(i, j) = (double)(i * 3 + j) - 4.0;
+            left(j, i) = (double)(i + 2 * j);
+        }
+    }
+    std::vector<double> x {1.0, -2.0, 3.0, 0.5};
+    std::vector<double> expected_y {-4.0, 2.5, 0.0, 7.0, 9.5};
+
+    for (const size_t threads : {1, 3})
+    {
+        setNumThreads(threads);
+        for (const SparseFormat format : {SparseFormat::CSR, SparseFormat::CSC})
+        {
+            SparseMatrix<double> sparse(5, 4, triplets, format);
+            EXPECT_EQ(sparse.nonZeros(), 7u);
+            EXPECT_EQ(sparse.toDense().getData(), dense.getData());
+            EXPECT_EQ(SparseMatrix<double>(dense, format).toDense().getData(), dense.getData());
+            EXPECT_EQ(sparse.coeff(3, 2), 5.0);
+            EXPECT_EQ(sparse.coeff(2, 2), 0.0);
+
+            EXPECT_EQ(sparse * x, expected_y);
+            EXPECT_EQ((sparse * other).getData(), (dense * other).getData());
+            EXPECT_EQ((left * sparse).getData(), (left * dense).getData());
+            EXPECT_EQ((sparse + sparse.toFormat(SparseFormat::CSR)).toDense().getData(), (dense + dense).eval().getData());
+        }
+    }
+    EXPECT_THROW((SparseMatrix<double>(2, 2, {{2, 0, 1.0}})), std::out_of_range);
+}
+
+TEST_F(MatrixTest, TestMatrixFile)
+{
+    Matrix<float> mat(37, 19);
+    for (size_t i = 0; i < mat.rows(); ++i)
+    {
+        for (size_t j = 0; j < mat.cols(); ++j)
+        {
+            mat(i, j) = (float)i - 0.25f * (float)j;
+        }
+    }
+    const std::string path = ::testing::TempDir() + "matrix_library_test.mtx";
+    const std::string block_path = ::testing::TempDir() + "matrix_library_test_block.mtx";
+    saveMatrix(path, mat);
+    saveMatrix(block_path, mat.block(3, 2, 10, 5));
+
+    const MatrixFileHeader header = readMatrixHeader(path);
+    EXPECT_EQ(header.dtype, DataType::Float32);
+    EXPECT_EQ(header.rows, 37u);
+    EXPECT_EQ(header.cols, 19u);
+    EXPECT_EQ(header.endianness, hostEndianness());
+
+    EXPECT_EQ(loadMatrix<float>(path).getData(), mat.getData());
+    EXPECT_EQ(loadMatrix<float>(block_path).getData(), mat.block(3, 2, 10, 5).getData());
+    {
+        MappedMatrix<float> mapped(path);
+        EXPECT_EQ(mapped.getDimensions(), mat.getDimensions());
+        EXPECT_EQ(mapped.view().getData(), mat.getData());
+        EXPECT_EQ((mapped.view() * mat.transpose()).getData(), (mat * mat.transpose()).getData());
+
+        MappedMatrix<float> moved(std::move(mapped));
+        EXPECT_EQ(moved(36, 18), mat(36, 18));
+    }
+    EXPECT_THROW(loadMatrix<double>(path), std::runtime_error);
+    EXPECT_THROW(MappedMatrix<int>{path}, std::runtime_error);
+    EXPECT_THROW(readMatrixHeader(path + ".missing"), std::runtime_error);
+
+    // Headers whose data size overflows, or whose data is misaligned, are rejected before anything is read or mapped
+    auto writeHeader = [&path](const MatrixFileHeader &crafted)
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(&crafted), sizeof(crafted));
+        file.write(std::string(256, '\0').data(), 256);
+    };
+    MatrixFileHeader crafted = makeMatrixHeader<float>(2, 2);
+    crafted.rows = (uint64_t)1 << 62;
+    writeHeader(crafted);
+    EXPECT_THROW(loadMatrix<float>(path), std::runtime_error);
+    EXPECT_THROW(MappedMatrix<float>{path}, std::runtime_error);
+    crafted = makeMatrixHeader<float>(2, 2);
+    crafted.data_offset += 1;
+    writeHeader(crafted);
+    EXPECT_THROW(loadMatrix<float>(path), std::runtime_error);
+    EXPECT_THROW(MappedMatrix<float>{path}, std::runtime_error);
+    crafted.data_offset += alignof(float) - 1;
+    writeHeader(crafted);
+    EXPECT_EQ(MappedMatrix<float>(path).view().getData(), Matrix<float>(2, 2).getData());
+
+    // A header claiming more data than the file holds is rejected before the Matrix is allocated
+    crafted = makeMatrixHeader<float>((uint64_t)1 << 30, 2);
+    writeHeader(crafted);
+    EXPECT_THROW(loadMatrix<float>(path), std::runtime_error);
+    EXPECT_THROW(MappedMatrix<float>{path}, std::runtime_error);
+
+    // Unknown byte orders are not taken for the host's
+    crafted = makeMatrixHeader<float>(2, 2);
+    crafted.endianness = static_cast<Endianness>(7);
+    writeHeader(crafted);
+    EXPECT_THROW(readMatrixHeader(path), std::runtime_error);
+    EXPECT_THROW(loadMatrix<float>(path), std::runtime_error);
+
+    std::remove(path.c_str());
+    std::remove(block_path.c_str());
+}
+
+TEST_F(MatrixTest, TestOutOfCoreMultiplication)
+{
+    Matrix<double> A(70, 45), B(45, 33);
+    for (size_t i = 0; i < 70; ++i)
+    {
+        for (size_t j = 0; j < 45; ++j)
+        {
+            A(i, j) = (double)((i * 7 + j) % 13) - 6.0;
+        }
+    }
+    for (size_t i = 0; i < 45; ++i)
+    {
+        for (size_t j = 0; j < 33; ++j)
+        {
+            B(i, j) = (double)((i + j * 5) % 11) - 5.0;
+        }
+    }
+    const std::string lhs_path = ::testing::TempDir() + "matrix_library_lhs.mtx";
+    const std::string rhs_path = ::testing::TempDir() + "matrix_library_rhs.mtx";
+    const std::string result_path = ::testing::TempDir() + "matrix_library_result.mtx";
+    saveMatrix(lhs_path, A);
+    saveMatrix(rhs_path, B);
+    const auto expected_result = (A * B).getData();
+
+    // A budget of 6 * 16 * 16 doubles gives 16 x 16 result tiles, so every dimension is split with partial edge tiles
+    const size_t budget = 6 * 16 * 16 * sizeof(double);
+    const OutOfCorePlan plan = planOutOfCore<double>(70, 33, 45, budget);
+    EXPECT_EQ(plan.tile_rows, 16u);
+    EXPECT_EQ(plan.tile_cols, 16u);
+    EXPECT_LE(2 * (plan.tile_rows * plan.tile_depth + plan.tile_depth * plan.tile_cols + plan.tile_rows * plan.tile_cols) * sizeof(double), budget);
+
+    for (const size_t threads : {1, 2})
+    {
+        setNumThreads(threads);
+        multiplyOutOfCore<double>(lhs_path, rhs_path, result_path, budget);
+        EXPECT_EQ(loadMatrix<double>(result_path).getData(), expected_result);
+    }
+    multiplyOutOfCore<double>(lhs_path, rhs_path, result_path);
+    EXPECT_EQ(loadMatrix<double>(result_path).getData(), expected_result);
+
+    EXPECT_THROW(multiplyOutOfCore<double>(lhs_path, lhs_path, result_path, budget), std::invalid_argument);
+    EXPECT_THROW(multiplyOutOfCore<float>(lhs_path, rhs_path, result_path, budget), std::runtime_error);
+
+    // Empty operands give an empty result, or a zero one when only the inner dimension is empty
+    saveMatrix(lhs_path, A.block(0, 0, 70, 0));
+    saveMatrix(rhs_path, B.block(0, 0, 0, 33));
+    multiplyOutOfCore<double>(lhs_path, rhs_path, result_path, budget);
+    EXPECT_EQ(loadMatrix<double>(result_path).getData(), Matrix<double>(70, 33).getData());
+    saveMatrix(lhs_path, A.block(0, 0, 0, 45));
+    saveMatrix(rhs_path, B);
+    multiplyOutOfCore<double>(lhs_path, rhs_path, result_path, budget);
+    EXPECT_EQ(readMatrixHeader(result_path).rows, 0u);
+    EXPECT_EQ(readMatrixHeader(result_path).cols, 33u);
+
+    std::remove(lhs_path.c_str());
+    std::remove(rhs_path.c_str());
+    std::remove(result_path.c_str());
+}
+
+TEST_F(MatrixTest, TestBatchedMultiplication)
+{
+    // Widths cover the specialized kernels (16), the generic small kernel (5) and the blocked kernel (40)
+    const size_t batch = 50;
+    for (const size_t n : {16, 5, 40})
+    {
+        std::vector<double> A(batch * n * n), B(batch * n * n), C(batch * n * n, -1.0), C_ptr(batch * n * n, -1.0);
+        for (size_t e = 0; e < A.size(); ++e)
+        {
+            A[e] = (double)(e % 7) - 3.0;
+            B[e] = (double)(e % 5) - 2.0;
+        }
+        multiplyBatched(batch, n, n, n, A.data(), n, n * n, B.data(), n, n * n, C.data(), n, n * n);
+
+        std::vector<const double *> A_ptrs, B_ptrs;
+        std::vector<double *> C_ptrs;
+        for (size_t i = 0; i < batch; ++i)
+        {
+            A_ptrs.push_back(A.data() + i * n * n);
+            B_ptrs.push_back(B.data() + i * n * n);
+            C_ptrs.push_back(C_ptr.data() + i * n * n);
+        }
+        multiplyBatched(batch, n, n, n, A_ptrs.data(), n, B_ptrs.data(), n, C_ptrs.data(), n);
+
+        for (const size_t i : {(size_t)0, batch / 2, batch - 1})
+        {
+            const Matrix<double> lhs(n, n, std::vector<double>(A.begin() + i * n * n, A.begin() + (i + 1) * n * n));
+            const Matrix<double> rhs(n, n, std::vector<double>(B.begin() + i * n * n, B.begin() + (i + 1) * n * n));
+            const auto expected_result = (lhs * rhs).getData();
+            EXPECT_EQ(ConstMatrixView<double>(C.data() + i * n * n, n, n, n).getData(), expected_result);
+            EXPECT_EQ(ConstMatrixView<double>(C_ptr.data() + i * n * n, n, n, n).getData(), expected_result);
+        }
+    }
+
+    using Data = std::vector<std::vector<int>>;
+    std::vector<Matrix<int>> lhs {Matrix<int>(Data {{1, 2}, {3, 4}}), Matrix<int>(Data {{1, 0, 2}})};
+    std::vector<Matrix<int>> rhs {Matrix<int>(Data {{5}, {6}}), Matrix<int>(Data {{1, 1}, {2, 2}, {3, 3}})};
+    std::vector<Matrix<int>> result {Matrix<int>(2, 1), Matrix<int>(1, 2)};
+    multiplyBatched(lhs, rhs, result);
+    EXPECT_EQ(result[0].getData(), (Data {{17}, {39}}));
+    EXPECT_EQ(result[1].getData(), (Data {{7, 7}}));
+}
+
+TEST_F(MatrixTest, TestMatrixAllocator)
+{
+    // Resource counting the allocations it forwards to the heap
+    struct CountingResource : std::pmr::memory_resource
+    {
+        size_t allocations = 0;
+        void *do_allocate(size_t bytes, size_t alignment) override
+        {
+            ++allocations;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+        void do_deallocate(void *p, size_t bytes, size_t alignment) override
+        {
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+        {
+            return this == &other;
+        }
+    };
+
+    Matrix<float> A(3, 5, std::vector<float>(15, 1.5f));
+    Matrix<float> B(3, 5, {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15});
+    EXPECT_EQ((size_t)A.data() % matrix_alignment, 0u);
+    EXPECT_EQ(Matrix<short>(7, 3).getData(), std::vector<std::vector<short>>(7, std::vector<short>(3, 0)));
+
+    CountingResource counting;
+    MatrixArena arena(1 << 12, &counting);
+    std::vector<std::vector<float>> expected_result;
+    for (int iteration = 0; iteration < 3; ++iteration)
+    {
+        {
+            ScopedMatrixResource scope(arena);
+            Matrix<float> C = A + B * 2.0f;
+            Matrix<float> D = C - A;
+            EXPECT_EQ(getMatrixResource(), arena.resource());
+            EXPECT_EQ((size_t)D.data() % matrix_alignment, 0u);
+            expected_result = D.getData();
+        }
+        EXPECT_EQ(getMatrixResource(), std::pmr::new_delete_resource());
+        arena.reset();
+    }
+    // Every iteration fits in one block of the arena
+    EXPECT_EQ(counting.allocations, 3u);
+    EXPECT_EQ(expected_result, (B * 2.0f).eval().getData());
+
+    // Copies allocate from the resource current at the time of the copy
+    Matrix<float> copy;
+    {
+        ScopedMatrixResource scope(&counting);
+        copy = Matrix<float>(A);
+    }
+    EXPECT_EQ(counting.allocations, 4u);
+    EXPECT_EQ(copy.getData(), A.getData());
+}
+
+TEST_F(MatrixTest, TestVector)
+{
+    auto mat = Matrix<double>(std::vector<std::vector<double>> {{1.0, 2.0, 3.0},
+                                                                {4.0, 5.0, 6.0}});
+    Vector<double> x {1.0, 0.0, -1.0};
+    Vector<double> y {2.0, -3.0};
+
+    EXPECT_EQ((mat * x).getData(), (std::vector<double> {-2.0, -2.0}));
+    EXPECT_EQ((y * mat).getData(), (std::vector<double> {-10.0, -11.0, -12.0}));
+    EXPECT_EQ((mat.block(0, 1, 2, 2) * Vector<double> {1.0, 1.0}).getData(), (std::vector<double> {5.0, 11.0}));
+    EXPECT_EQ(dot(x, x), 2.0);
+    EXPECT_EQ(outer(y, x).getData(), (std::vector<std::vector<double>> {{2.0, 0.0, -2.0}, {-3.0, 0.0, 3.0}}));
+    EXPECT_EQ(Vector<double>(mat.col(1)).getData(), (std::vector<double> {2.0, 5.0}));
+
+    Vector<double> z = y;
+    gemv(2.0, mat, x, -1.0, z);
+    EXPECT_EQ(z.getData(), (std::vector<double> {-6.0, -1.0}));
+    axpy(0.5, y, z);
+    EXPECT_EQ(z.getData(), (std::vector<double> {-5.0, -2.5}));
+    EXPECT_EQ((2.0 * y - y + y * 0.5).getData(), (std::vector<double> {3.0, -4.5}));
+
+    // Scalars promote as they do with Matrix
+    const Vector<int> ints {1, 2, 3};
+    EXPECT_EQ((0.5 * ints).getData(), (std::vector<double> {0.5, 1.0, 1.5}));
+    EXPECT_EQ((ints * 2.5).getData(), (std::vector<double> {2.5, 5.0, 7.5}));
+    EXPECT_EQ((ints * 2).getData(), (std::vector<int> {2, 4, 6}));
+
+    // Sizes above the parallel threshold with lengths that are not multiples of the SIMD or unrolling widths
+    const size_t rows = 301, cols = 517;
+    Matrix<float> big(rows, cols);
+    Vector<float> u(cols), v(rows);
+    for (size_t i = 0; i < rows; ++i)
+    {
+        v[i] = (float)(i % 5) - 2.0f;
+        for (size_t j = 0; j < cols; ++j)
+        {
+            big(i, j) = (float)((i * 3 + j) % 7) - 3.0f;
+        }
+    }
+    for (size_t j = 0; j < cols; ++j)
+    {
+        u[j] = (float)(j % 3) - 1.0f;
+    }
+    for (const size_t threads : {1, 3})
+    {
+        setNumThreads(threads);
+        EXPECT_EQ((big * u).getData(), Vector<float>((big * u.asColumn()).col(0)).getData());
+        EXPECT_EQ((v * big).getData(), Vector<float>((v.asRow() * big).row(0)).getData());
+        // u repeats -1, 0, 1, so 172 full periods contribute 2 each and the last element -1 adds 1
+        EXPECT_EQ(dot(u, u), 345.0f);
+    }
+}
+
+TEST_F(MatrixTest, TestMixedAndQuantized)
+{
+    const Matrix<int> ints(2, 2, {1, 2, 3, 4});
+    const Matrix<double> doubles(2, 2, {0.5, 1.0, 1.5, 2.0});
+    const Matrix<double> sum = ints + doubles;
+    EXPECT_EQ(sum.getData(), (std::vector<std::vector<double>> {{1.5, 3.0}, {4.5, 6.0}}));
+    EXPECT_EQ((ints * doubles).getData(), (std::vector<std::vector<double>> {{3.5, 5.0}, {7.5, 11.0}}));
+    EXPECT_EQ((doubles * ints.block(0, 0, 2, 1)).getData(), (std::vector<std::vector<double>> {{3.5}, {7.5}}));
+    EXPECT_EQ(Matrix<int>((doubles * 2.0).cast<int>()).getData(), (std::vector<std::vector<int>> {{1, 2}, {3, 4}}));
+
+    // Scalars promote like matrices, a fractional scalar is not truncated to the integer datatype
+    const Matrix<double> scaled = ints * 2.5;
+    EXPECT_EQ(scaled.getData(), (std::vector<std::vector<double>> {{2.5, 5.0}, {7.5, 10.0}}));
+    EXPECT_EQ(Matrix<double>(0.5 * ints).getData(), (std::vector<std::vector<double>> {{0.5, 1.0}, {1.5, 2.0}}));
+    EXPECT_EQ(Matrix<double>(ints / 2.0).getData(), (std::vector<std::vector<double>> {{0.5, 1.0}, {1.5, 2.0}}));
+    EXPECT_EQ(Matrix<int>(ints / 2).getData(), (std::vector<std::vector<int>> {{0, 1}, {1, 2}}));
+    EXPECT_TRUE((std::is_same<decltype(ints * 2.5)::value_type, double>::value));
+    Matrix<double> acc = doubles;
+    acc += ints;
+    EXPECT_EQ(acc.getData(), sum.getData());
+
+    // 300 * 300 * 1 overflows short but not the int accumulator of multiplyWidened
+    const Matrix<short> narrow(1, 1, {300});
+    EXPECT_EQ(multiplyWidened(narrow, narrow)(0, 0), 90000);
+
+    // Quantized products are checked against the exact integer sums at every kernel level, with shapes that are not
+    // multiples of the register tile or of the int8 quads
+    const size_t M = 37, N = 45, K = 70;
+    std::vector<int8_t> a(M * K), b(K * N);
+    std::vector<int16_t> a16(M * K), b16(K * N);
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        a[i] = (int8_t)((int)(i * 37 % 256) - 128);
+        a16[i] = (int16_t)(a[i] * 100);
+    }
+    for (size_t i = 0; i < b.size(); ++i)
+    {
+        b[i] = (int8_t)((int)(i * 91 % 255) - 127);
+        b16[i] = (int16_t)(b[i] * 3);
+    }
+    const QuantizedMatrix<int8_t> qa(M, K, a, {0.5f, 3}), qb(K, N, b, {0.25f, -7});
+    const QuantizedMatrix<int16_t> qa16(M, K, a16, {0.5f, 11}), qb16(K, N, b16, {0.25f, -2});
+    Matrix<int> expected(M, N), expected16(M, N);
+    for (size_t i = 0; i < M; ++i)
+    {
+        for (size_t j = 0; j < N; ++j)
+        {
+            for (size_t k = 0; k < K; ++k)
+            {
+                expected(i, j) += (a[i * K + k] - 3) * (b[k * N + j] + 7);
+                expected16(i, j) += (a16[i * K + k] - 11) * (b16[k * N + j] + 2);
+            }
+        }
+    }
+    for (const SimdLevel level : {SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512})
+    {
+        setSimdLevel(level);
+        for (const size_t threads : {1, 3})
+        {
+            setNumThreads(threads);
+            EXPECT_EQ(multiplyQuantizedAccumulate(qa, qb).getData(), expected.getData());
+            EXPECT_EQ(multiplyQuantizedAccumulate(qa16, qb16).getData(), expected16.getData());
+        }
+    }
+    setSimdLevel(detectSimdLevel());
+
+    // Quantizing real matrices and multiplying them stays close to the float product
+    Matrix<float> x(8, 16), y(16, 4);
+    for (size_t i = 0; i < 8 * 16; ++i)
+    {
+        x.data()[i] = (float)((int)(i % 11) - 5) * 0.1f;
+    }
+    for (size_t i = 0; i < 16 * 4; ++i)
+    {
+        y.data()[i] = (float)((int)(i % 7) - 2) * 0.3f;
+    }
+    const QuantizedMatrix<int8_t> qx = quantize<int8_t>(x), qy = quantize<int8_t>(y);
+    EXPECT_EQ(qx.params().zero_point, quantizeValue<int8_t>(0.0f, qx.params()));
+    const Matrix<float> exact = x * y;
+    const Matrix<float> approx = multiplyQuantized(qx, qy);
+    const Matrix<float> roundtrip = dequantize(qx);
+    for (size_t i = 0; i < exact.rows(); ++i)
+    {
+        for (size_t j = 0; j < exact.cols(); ++j)
+        {
+            EXPECT_NEAR(approx(i, j), exact(i, j), 0.1f);
+        }
+    }
+    EXPECT_NEAR(roundtrip(3, 5), x(3, 5), qx.params().scale);
+}
+
+TEST_F(MatrixTest, TestInstrumentation)
+{
+    ASSERT_TRUE(statsEnabled());
+    resetStats();
+    {
+        Matrix<double> mat(64, 32);
+        Matrix<double> copy(mat);
+        Matrix<double> moved(std::move(copy));
+        copy = mat;
+        moved = std::move(copy);
+    }
+    MatrixStats stats = getStats();
+    EXPECT_EQ(stats.allocations, 3u);
+    EXPECT_EQ(stats.deallocations, 3u);
+    EXPECT_EQ(stats.bytes_allocated, 3u * 64 * 32 * sizeof(double));
+    EXPECT_EQ(stats.copies, 2u);
+    EXPECT_EQ(stats.moves, 2u);
+
+    // A product large enough to be split into several tiles, whose times are tracked per thread
+    const Matrix<float> lhs(300, 200), rhs(200, 250);
+    setNumThreads(3);
+    resetStats();
+    startTrace();
+    const Matrix<float> product = lhs * rhs;
+    stopTrace();
+    stats = getStats();
+    EXPECT_EQ(stats.multiplications, 1u);
+    EXPECT_EQ(stats.flops, 2u * 300 * 200 * 250);
+    EXPECT_EQ(stats.parallel_multiplications, 1u);
+    EXPECT_GE(stats.max_load_imbalance, 1.0);
+    EXPECT_FALSE(stats.thread_compute_seconds.empty());
+
+    std::ostringstream trace;
+    writeTrace(trace);
+    EXPECT_EQ(trace.str().rfind("{\"traceEvents\":[", 0), 0u);
+    EXPECT_NE(trace.str().find("\"name\":\"multiply\""), std::string::npos);
+    EXPECT_NE(trace.str().find("\"name\":\"multiply tile\""), std::string::npos);
+    EXPECT_NE(trace.str().find("\"flops\":30000000"), std::string::npos);
+}
+
+TEST_F(MatrixTest, TestStructuredMatrices)
+{
+    const size_t n = 120;
+    auto expectNear = [](const Matrix<double> &actual, const Matrix<double> &expected)
+    {
+        ASSERT_EQ(actual.getDimensions(), expected.getDimensions());
+        for (size_t i = 0; i < actual.rows(); ++i)
+        {
+            for (size_t j = 0; j < actual.cols(); ++j)
+            {
+                EXPECT_NEAR(actual(i, j), expected(i, j), 1e-8);
+            }
+        }
+    };
+    Matrix<double> dense(n, n), rhs(n, 7);
+    for (size_t i = 0; i < n; ++i)
+    {
+        for (size_t j = 0; j < n; ++j)
+        {
+            dense(i, j) = (i == j) ? 50.0 : (double)((i * 7 + j * 3) % 11) - 5.0;
+        }
+        for (size_t j = 0; j < rhs.cols(); ++j)
+        {
+            rhs(i, j) = (double)((i + 2 * j) % 5) - 2.0;
+        }
+    }
+    const Matrix<double> rhs_t = rhs.transpose();
+
+    DiagonalMatrix<double> diag(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        diag(i, i) = 1.0 + (double)i;
+    }
+    EXPECT_THROW(diag(0, 1), std::out_of_range);
+    expectNear(diag * rhs, diag.toDense() * rhs);
+    expectNear(rhs_t * diag, rhs_t * diag.toDense());
+    expectNear(diag + dense, diag.toDense() + dense);
+    expectNear((diag * diag).toDense(), diag.toDense() * diag.toDense());
+    expectNear(diag * diag.solve(rhs), rhs);
+
+    const IdentityMatrix<double> identity(n);
+    expectNear(identity.toDense(), DiagonalMatrix<double>(std::vector<double>(n, 1.0)).toDense());
+    expectNear(identity * dense, dense);
+    expectNear(dense * identity, dense);
+    expectNear(dense + identity, dense + identity.toDense());
+    expectNear((identity + identity).toDense(), 2.0 * identity.toDense());
+    expectNear(identity.solve(rhs), rhs);
+    EXPECT_THROW(IdentityMatrix<double>(0), std::invalid_argument);
+
+    // Banded products and sums only keep the band, the solve pivots within it
+    const BandedMatrix<double> band(dense, 2, 3), other(dense.transpose(), 1, 0);
+    EXPECT_EQ(band.coeff(0, 4), 0.0);
+    EXPECT_EQ(band.coeff(5, 2), 0.0);
+    EXPECT_EQ(band.coeff(5, 3), dense(5, 3));
+    EXPECT_THROW(BandedMatrix<double>(dense, 2, 3)(0, 4), std::out_of_range);
+    expectNear(band * rhs, band.toDense() * rhs);
+    expectNear(rhs_t * band, rhs_t * band.toDense());
+    expectNear(band + dense, band.toDense() + dense);
+    expectNear((band * other).toDense(), band.toDense() * other.toDense());
+    expectNear((band + other).toDense(), band.toDense() + other.toDense());
+    expectNear(band.transpose().toDense(), band.toDense().transpose());
+    expectNear(band * band.solve(rhs), rhs);
+    BandedMatrix<double> pivoting(4, 1, 1);
+    pivoting(0, 1) = 2.0;
+    pivoting(1, 0) = 1.0;
+    pivoting(1, 2) = 3.0;
+    pivoting(2, 3) = 1.0;
+    pivoting(3, 2) = 4.0;
+    pivoting(3, 3) = 1.0;
+    const Matrix<double> small_rhs(4, 1, {1.0, 2.0, 3.0, 4.0});
+    expectNear(pivoting * pivoting.solve(small_rhs), small_rhs);
+    EXPECT_THROW(BandedMatrix<double>(4, 1, 1).solve(small_rhs), std::runtime_error);
+
+    const UpperTriangularMatrix<double> upper(dense);
+    const LowerTriangularMatrix<double> lower(dense);
+    EXPECT_EQ(upper.coeff(3, 1), 0.0);
+    EXPECT_EQ(lower.coeff(3, 1), dense(3, 1));
+    expectNear(upper * rhs, upper.toDense() * rhs);
+    expectNear(rhs_t * lower, rhs_t * lower.toDense());
+    expectNear(lower + dense, lower.toDense() + dense);
+    expectNear((upper * upper).toDense(), upper.toDense() * upper.toDense());
+    expectNear((lower + lower).toDense(), lower.toDense() + lower.toDense());
+    expectNear(upper.transpose().toDense(), upper.toDense().transpose());
+    expectNear(upper * upper.solve(rhs), rhs);
+    expectNear(lower * lower.solve(rhs), rhs);
+
+    const SymmetricMatrix<double> symmetric(dense);
+    EXPECT_EQ(symmetric.coeff(4, 1), dense(1, 4));
+    const Matrix<double> symmetric_dense = symmetric.toDense();
+    expectNear(symmetric_dense, symmetric_dense.transpose());
+    expectNear(symmetric * rhs, symmetric_dense * rhs);
+    expectNear(rhs_t * symmetric, rhs_t * symmetric_dense);
+    expectNear(symmetric + dense, symmetric_dense + dense);
+    expectNear((symmetric + symmetric).toDense(), symmetric_dense + symmetric_dense);
+    expectNear(symmetric * symmetric.solve(rhs), rhs);
+    EXPECT_THROW(SymmetricMatrix<double>(3).solve(Matrix<double>(3, 1)), std::runtime_error);
+}
+
+TEST_F(MatrixTest, TestDecompositions)
+{
+    // Sizes spanning several panels, diagonally dominant so that the symmetric part is positive definite
+    const size_t n = 150;
+    auto expectNear = [](const Matrix<double> &actual, const Matrix<double> &expected, const double tolerance)
+    {
+        ASSERT_EQ(actual.getDimensions(), expected.getDimensions());
+        for (size_t i = 0; i < actual.rows(); ++i)
+        {
+            for (size_t j = 0; j < actual.cols(); ++j)
+            {
+                EXPECT_NEAR(actual(i, j), expected(i, j), tolerance);
+            }
+        }
+    };
+    Matrix<double> A(n, n), b(n, 3);
+    for (size_t i = 0; i < n; ++i)
+    {
+        for (size_t j = 0; j < n; ++j)
+        {
+            A(i, j) = (double)((i * 13 + j * 7) % 17) - 8.0 + ((i == j) ? 4.0 * n : 0.0);
+        }
+        for (size_t j = 0; j < b.cols(); ++j)
+        {
+            b(i, j) = (double)((i + 5 * j) % 9) - 4.0;
+        }
+    }
+    const Matrix<double> spd = A + A.transpose();
+
+    const LUDecomposition<double> lu(A);
+    expectNear(A * lu.solve(b), b, 1e-9);
+    expectNear(A * inverse(A), identityDense<double>(n), 1e-9);
+    expectNear(A * solve(A, b), b, 1e-9);
+
+    // Pivoting is needed when the leading element is zero
+    const Matrix<double> permuted({{0.0, 2.0, 1.0},
+                                   {1.0, 1.0, 0.0},
+                                   {3.0, 0.0, 1.0}});
+    EXPECT_NEAR(determinant(permuted), -5.0, 1e-12);
+    EXPECT_NEAR(determinant(Matrix<double>(identityDense<double>(4) * 2.0)), 16.0, 1e-12);
+    EXPECT_EQ(determinant(Matrix<double>({{1.0, 2.0}, {2.0, 4.0}})), 0.0);
+    EXPECT_THROW(inverse(Matrix<double>({{1.0, 2.0}, {2.0, 4.0}})), std::runtime_error);
+
+    const CholeskyDecomposition<double> cholesky(spd);
+    const Matrix<double> &L = cholesky.matrixL();
+    EXPECT_EQ(L(0, 1), 0.0);
+    expectNear(L * L.transpose(), spd, 1e-9);
+    expectNear(spd * cholesky.solve(b), b, 1e-9);
+    EXPECT_NEAR(CholeskyDecomposition<double>(Matrix<double>({{4.0, 2.0}, {2.0, 3.0}})).determinant(), 8.0, 1e-12);
+    EXPECT_THROW(CholeskyDecomposition<double>(Matrix<double>({{1.0, 2.0}, {2.0, 1.0}})), std::runtime_error);
+
+    // Overdetermined system, the least squares residual is orthogonal to the cols of the matrix
+    Matrix<double> tall(2 * n, n - 20), tall_b(2 * n, 2);
+    for (size_t i = 0; i < tall.rows(); ++i)
+    {
+        for (size_t j = 0; j < tall.cols(); ++j)
+        {
+            tall(i, j) = (double)((i * 11 + j * 5) % 23) - 11.0 + ((i == j) ? 30.0 : 0.0);
+        }
+        tall_b(i, 0) = (double)(i % 7);
+        tall_b(i, 1) = (double)(i % 4) - 1.5;
+    }
+    const QRDecomposition<double> qr(tall);
+    const Matrix<double> Q = qr.matrixQ();
+    expectNear(Q * qr.matrixR(), tall, 1e-9);
+    expectNear(Q.transpose() * Q, identityDense<double>(tall.cols()), 1e-12);
+    const Matrix<double> x = leastSquares(tall, tall_b);
+    const Matrix<double> residual = tall * x - tall_b;
+    expectNear(tall.transpose() * residual, Matrix<double>(tall.cols(), 2), 1e-8);
+    expectNear(QRDecomposition<double>(A).solve(b), lu.solve(b), 1e-9);
+}
+
+TEST_F(MatrixTest, TestAsyncMatrix)
+{
+    Matrix<double> A(90, 70), B(70, 80), C(90, 60), D(60, 80);
+    for (Matrix<double> *mat : {&A, &B, &C, &D})
+    {
+        for (size_t i = 0; i < mat->rows(); ++i)
+        {
+            for (size_t j = 0; j < mat->cols(); ++j)
+            {
+                (*mat)(i, j) = (double)((i * 5 + j * 3 + mat->cols()) % 13) - 6.0;
+            }
+        }
+    }
+    const Matrix<double> expected = A * B + C * D;
+
+    // The two products are independent nodes of the graph, the sum depends on both
+    auto f = async(A) * async(B);
+    auto g = async(C) * async(D);
+    auto h = f + g;
+    auto h_t = h.transpose() * 2.0;
+    EXPECT_EQ(h.get().getData(), expected.getData());
+    EXPECT_TRUE(f.ready() && g.ready());
+    EXPECT_EQ(h_t.get().getData(), Matrix<double>(expected.transpose() * 2.0).getData());
+
+    auto sum = async(A + A);
+    EXPECT_EQ(sum.get().getData(), Matrix<double>(A * 2.0).getData());
+    auto owned = async(Matrix<double>(A)) - async(A);
+    EXPECT_EQ(owned.get().getData(), Matrix<double>(A.rows(), A.cols()).getData());
+    auto mixed = f.then([](const Matrix<double> &m) { return m.cast<float>(); });
+    EXPECT_EQ(mixed.get().getData(), f.get().cast<float>().getData());
+
+    // Exceptions propagate to dependent nodes and are rethrown by get
+    auto failing = async([]() -> Matrix<double> { throw std::runtime_error("failed"); });
+    auto dependent = failing + f;
+    EXPECT_THROW(dependent.get(), std::runtime_error);
+    EXPECT_TRUE(f.then([](const Matrix<double> &m) { return m; }).get().getData() == f.get().getData());
+
+    // Products of handles are deferred nodes: gated waits for an input completed by hand, and the independent product
+    // runs to completion on the pool meanwhile instead of being computed by the calling thread in sequence
+    auto gate_state = std::make_shared<AsyncState<double>>();
+    auto gated = AsyncMatrix<double>(gate_state) * async(B);
+    auto independent = async(C) * async(D);
+    EXPECT_EQ(independent.get().getData(), Matrix<double>(C * D).getData());
+    EXPECT_FALSE(gated.ready());
+    gate_state->complete(std::make_shared<const Matrix<double>>(A), nullptr);
+    EXPECT_EQ(gated.get().getData(), Matrix<double>(A * B).getData());
+
+    // Independent nodes run at the same time, each of these two only returns once both have started
+    std::atomic<size_t> started(0), overlapped(0);
+    auto rendezvous = [&started, &overlapped](const Matrix<double> &m)
+    {
+        ++started;
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (started < 2 && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::yield();
+        }
+        overlapped += (started == 2) ? 1 : 0;
+        return m;
+    };
+    auto first = (async(A) * async(B)).then(rendezvous);
+    auto second = (async(C) * async(D)).then(rendezvous);
+    EXPECT_EQ((first + second).get().getData(), expected.getData());
+    EXPECT_EQ(overlapped, 2u);
+}
+
+TEST_F(MatrixTest, TestMultiplyChain)
+{
+    // Textbook chain whose optimal cost is 15125 multiply-adds
+    const MatrixChainPlan plan({{30, 35}, {35, 15}, {15, 5}, {5, 10}, {10, 20}, {20, 25}});
+    EXPECT_EQ(plan.cost(), 15125.0);
+    EXPECT_EQ(plan.parenthesization(), "((A0 (A1 A2)) ((A3 A4) A5))");
+    EXPECT_THROW(MatrixChainPlan({{2, 3}, {4, 5}}), std::invalid_argument);
+
+    std::vector<Matrix<double>> chain;
+    const std::vector<std::pair<size_t, size_t>> dims {{40, 300}, {300, 6}, {6, 250}, {250, 8}, {8, 120}, {120, 30}};
+    for (const std::pair<size_t, size_t> &dim : dims)
+    {
+        Matrix<double> mat(dim.first, dim.second);
+        for (size_t i = 0; i < dim.first; ++i)
+        {
+            for (size_t j = 0; j < dim.second; ++j)
+            {
+                mat(i, j) = (double)((i * 3 + j * 7 + dim.second) % 5) - 2.0;
+            }
+        }
+        chain.push_back(std::move(mat));
+    }
+    const Matrix<double> expected = chain[0] * chain[1] * chain[2] * chain[3] * chain[4] * chain[5];
+    EXPECT_EQ(multiplyChain(chain[0], chain[1], chain[2], chain[3], chain[4], chain[5]).getData(), expected.getData());
+    setNumThreads(1);
+    EXPECT_EQ(multiplyChain(std::vector<const Matrix<double> *> {&chain[0], &chain[1], &chain[2]}).getData(),
+        Matrix<double>(chain[0] * chain[1] * chain[2]).getData());
+    EXPECT_EQ(multiplyChain(chain[3]).getData(), chain[3].getData());
+
+    // The planner avoids the 40 x 250 and 40 x 120 intermediates of the left to right order
+    EXPECT_LT(MatrixChainPlan(dims).cost(), 40.0 * 300 * 6 + 40.0 * 6 * 250 + 40.0 * 250 * 8 + 40.0 * 8 * 120 + 40.0 * 120 * 30);
+}
+
+TEST_F(MatrixTest, TestParallelElementwise)
+{
+    // Large enough to be split across threads, with an odd number of rows per part
+    const size_t rows = 601, cols = 300;
+    std::vector<double> values(rows * cols);
+    for (size_t k = 0; k < values.size(); ++k)
+    {
+        values[k] = (double)(k % 97) - 48.0;
+    }
+
+    auto compute = [&]()
+    {
+        const Matrix<double> a(rows, cols, values);
+        Matrix<double> b(a);
+        b *= 2.0;
+        b += a;
+        Matrix<double> c(rows, cols);
+        c = a - b * 0.5;
+        c.transposeInPlace();
+        Matrix<double> d(cols, rows);
+        d = c;
+        d -= a.transpose();
+        return std::vector<Matrix<double>> {a, b, c, d};
+    };
+
+    setNumThreads(1);
+    const std::vector<Matrix<double>> serial = compute();
+    setNumThreads(4);
+    const std::vector<Matrix<double>> parallel = compute();
+    for (size_t k = 0; k < serial.size(); ++k)
+    {
+        EXPECT_EQ(parallel[k].getData(), serial[k].getData());
+    }
+    EXPECT_EQ(serial[1](600, 299), 3.0 * values[600 * cols + 299]);
+    EXPECT_EQ(Matrix<double>(rows, cols).getData(), std::vector<std::vector<double>>(rows, std::vector<double>(cols, 0.0)));
+    EXPECT_EQ(Matrix<double>(serial[3].transpose().transpose()).getData(), serial[3].getData());
+}
+
+TEST_F(MatrixTest, TestGemm)
+{
+    auto makeOperand = [](const size_t rows, const size_t cols)
+    {
+        Matrix<double> mat(rows, cols);
+        for (size_t i = 0; i < rows; ++i)
+        {
+            for (size_t j = 0; j < cols; ++j)
+            {
+                mat(i, j) = (double)((i * 5 + j * 3) % 7) - 3.0;
+            }
+        }
+        return mat;
+    };
+
+    // Small shapes use the direct loops, larger ones the packed kernel, the largest are split across threads
+    for (const size_t threads : {1, 4})
+    {
+        setNumThreads(threads);
+        for (const std::vector<size_t> &shape : {std::vector<size_t> {3, 4, 5}, std::vector<size_t> {70, 90, 50},
+            std::vector<size_t> {150, 130, 120}})
+        {
+            const size_t M = shape[0], K = shape[1], N = shape[2];
+            const Matrix<double> A = makeOperand(M, K), B = makeOperand(K, N);
+            const Matrix<double> A_t = A.transpose(), B_t = B.transpose();
+            const Matrix<double> C0 = makeOperand(M, N);
+            const Matrix<double> expected = A * B * 3.0 + C0 * 2.0;
+
+            Matrix<double> C = C0;
+            gemm(3.0, A, Transpose::NoTrans, B, Transpose::NoTrans, 2.0, C);
+            EXPECT_EQ(C.getData(), expected.getData());
+            C = C0;
+            gemm(3.0, A_t, Transpose::Trans, B, Transpose::NoTrans, 2.0, C);
+            EXPECT_EQ(C.getData(), expected.getData());
+            C = C0;
+            gemm(3.0, A, Transpose::NoTrans, B_t, Transpose::Trans, 2.0, C);
+            EXPECT_EQ(C.getData(), expected.getData());
+            C = C0;
+            gemm(3.0, A_t, Transpose::Trans, B_t, Transpose::Trans, 2.0, C);
+            EXPECT_EQ(C.getData(), expected.getData());
+        }
+    }
+
+    // A * A^T without forming the transpose, C is not read when beta is 0
+    const Matrix<double> A = makeOperand(100, 80);
+    Matrix<double> C(100, 100);
+    C(0, 0) = std::numeric_limits<double>::quiet_NaN();
+    const double *c_data = C.data();
+    gemm(1.0, A, Transpose::NoTrans, A, Transpose::Trans, 0.0, C);
+    EXPECT_EQ(C.data(), c_data);
+    EXPECT_EQ(C.getData(), (A * A.transpose()).getData());
+
+    // Output into a block of a larger Matrix
+    Matrix<double> big(102, 104);
+    gemm<double>(1.0, A.view(), Transpose::NoTrans, A.view(), Transpose::Trans, 1.0, big.block(1, 2, 100, 100));
+    EXPECT_EQ(Matrix<double>(big.block(1, 2, 100, 100)).getData(), C.getData());
+    EXPECT_EQ(big(0, 0), 0.0);
+    EXPECT_EQ(big(101, 103), 0.0);
+
+    // *= by a square Matrix is computed in place
+    setNumThreads(1);
+    Matrix<double> D = makeOperand(300, 90);
+    const Matrix<double> S = makeOperand(90, 90);
+    const Matrix<double> product = D * S;
+    const double *d_data = D.data();
+    D *= S;
+    EXPECT_EQ(D.data(), d_data);
+    EXPECT_EQ(D.getData(), product.getData());
+    setNumThreads(4);
+    D = makeOperand(300, 90);
+    D *= S;
+    EXPECT_EQ(D.getData(), product.getData());
+    D *= makeOperand(90, 40);
+    EXPECT_EQ(D.getDimensions(), (std::pair<size_t, size_t>(300, 40)));
+}